@@ -42,6 +42,16 @@
 #include "pcm3060.h"
 #include "bits8.h"
 #include "mcp4728.h"
+#include "channel_kernel.h"
+#include "dynamics.h"
+#include "dsp_platform.h"
+#include "fastmath.h"
+#include "dsp_bench.h"
+#include "irq_profile.h"
+#include "input_monitor.h"
+#include "proto.h"
+#include "uart_dma.h"
+#include "sram_banks.h"
 
 /* Defines for the specific hardware configuration
  * When DSP_PCB is set, the config is for the manufactured DSP PCB
@@ -106,9 +116,6 @@ typedef void (*callback)();
 
 #define MAX_AMPLITUDE 2147483647
 
-// the common denominator used in sending levels from the dsp to the controller
-#define COMMON_RANGE 8192
-
 
 // command buffer for storing received commands
 
@@ -118,9 +125,6 @@ uint64_t pause_count = 100000;
 // text buffer for display of text
 char *text_buffer = 0;
 
-// send buffer for sending status to controller
-char *send_buffer;
-
 // structure for representing the state of the system
 struct machine_state_structure {
     bool compressor_on;   // if true, the compression is on, otherwise the compression (cgain and mgain) is bypassed
@@ -162,10 +166,17 @@ struct machine_state_structure {
     float makeup_dB;       // the signal amplitude gain make up in the compressor
     float makeup;          // the ratio for the compression makeup gain (mgain)
     float ratio;           // how strong the compression is to be applied (compression dB reduction/input dB level) post thrshold
+    float knee_dB;         // width of the soft knee centered on the threshold (0 is a hard knee)
     float balance;         // how strong the left and right channels are (-1.0 left unity gain, right mute, 0=both unity, 1=left mute, right unity)
     float output_mix;      // the level of original input signal to compressed signal on output (0 - only input signal, 0.5 - 50% mix, 1 - only compressed signal)
     mcp4728_t* vca_dac;    // the quad dac driver chip for the VCAs
-    uint32_t cycle_time_us;
+    float lowpass_ratio;   // low pass filter (0 - no filter, 1 - fully filtered)
+    float highpass_ratio;  // high pass filter (0 - no filter, 1 - fully filtered)
+    float limiter_lookahead_ms; // output limiter delay (0.5 - 2ms)
+    float limiter_ceiling_dB;   // output limiter ceiling
+    uint32_t clip_events;       // times the output limiter has engaged
+    uint32_t cycle_time_us;  // control time covered by the last pass of the dsp loop
+    float control_busy_us;   // average time the dsp loop is awake per pass
 };
 
 struct machine_state_structure machine_state = { .compressor_on = true,\
@@ -191,6 +202,7 @@ struct machine_state_structure machine_state = { .compressor_on = true,\
 						 .release_rate_ms = 225,\
 						 .compression_gain = 1.0,\
 						 .ratio = 30.0,\
+						 .knee_dB = 6.0,\
 						 .balance = 1.0,\
 						 .min_steps = 20,\
 						 .peak_amp_l = 0,\
@@ -206,16 +218,25 @@ struct machine_state_structure machine_state = { .compressor_on = true,\
 						 .makeup_dB = 0,
 						 .output_mix = 1.0,\
 						  .vca_dac = 0,\
-						 .cycle_time_us = 0 };
+						 .lowpass_ratio = 0.0,\
+						 .highpass_ratio = 0.0,\
+						 .limiter_lookahead_ms = 1.0,\
+						 .limiter_ceiling_dB = -0.3,\
+						 .clip_events = 0,\
+						 .cycle_time_us = 0,\
+						 .control_busy_us = 0 };
 
 
 
-static __attribute__((aligned(8))) pio_i2s i2s;
+static __attribute__((aligned(32))) pio_i2s i2s;
 
 
 // gain average
 average *gain_avg;
 
+// average time the dsp loop is awake per control tick
+average *control_busy_avg;
+
 
 float __not_in_flash_func(map_range)(float n, float from_low, float from_high, float to_low, float to_high) {
     return (to_low + (((n- from_low)/ (from_high- from_low))* (to_high- to_low)));
@@ -230,7 +251,7 @@ float __not_in_flash_func(map_range)(float n, float from_low, float from_high, f
 // return the signal strength in negative gain from 0dB (pressure)
 
 float signal_dB(int32_t amp) {
-    return 0-(20*log10f(MAX_AMPLITUDE/amp));
+    return fm_amp_to_dB(amp);
 }
 
 // return the sample value for a provided dB in pressure
@@ -241,24 +262,20 @@ int32_t dB_to_sample(float dB) {
     if (dB < 0) {
 	abs_dB = abs_dB * -1;
     }
-    return (int32_t) (MAX_AMPLITUDE / powf(10.0, (float) (abs_dB / 20.0)));
+    return fm_dB_to_amp(0 - abs_dB);
 }
 
 // converts to a decibel relative to 1, where 1 is 0db
 
 float ratio_to_dB(float relative_amplitude) {
-    return (20*log10f(relative_amplitude));
+    return fm_ratio_to_dB(relative_amplitude);
 }
 
 // converts a ratio where 1 is 0db to a decibel value
 
 float dB_to_ratio(float dB) {
 
-    if (dB >= 0) {
-	 return powf(10,(float) (dB / 20));
-    }
-    return -1.0 * ((float) 0.0 - ( powf(10.0, (float) (dB / 20.0))));
-    
+    return fm_dB_to_ratio(dB);
 }
 
 uint64_t now_ms() {
@@ -278,131 +295,83 @@ void compute_threshold_for_dB(float dB) {
 
 int32_t neg_gain = 1;  // range from below 0 (positive gain) to 65536, 0 is unity gain, 65536 is silence, 
 int32_t divs = 0;
-int32_t peak_amp_l = 0;
-int32_t peak_amp_r = 0;
-int32_t peak_amp_output_l = 0;
-int32_t peak_amp_output_r = 0;
 int32_t neg_peak_amp = 0;
 
 uint32_t call_count = 0;
 
-uint32_t over_limit_time = 0;
 uint32_t output_limit = MAX_AMPLITUDE - 1000;
 uint32_t output_limit_neg = 0 - (MAX_AMPLITUDE - 1000);
 
-/* These global values represent the various gains to be applied
- * in the current instant within the audio processing function
- * based on the settings in the machine_state structure.
+/* The kernel holds the various gains to be applied in the current
+ * instant within the audio processing function, based on the
+ * settings in the machine_state structure, and the peak amplitudes
+ * it has measured.  See lib/channel_kernel.h.  It has SRAM bank 3 to
+ * itself and the interrupt profile (see lib/sram_banks.h).
  */
 
-float calculated_net_gain = 1.0;
-float balance_l_gain = 1.0;
-float balance_r_gain = 1.0;
-float comp_output_mix = 1.0;
-float raw_output_mix = 0.0;
+channel_kernel kernel SRAM_BANK(3);
 
+// DMA block size and ring depth (see i2s.h), changed with the z command
 
+uint16_t audio_block_frames = AUDIO_BUFFER_FRAMES;
+uint8_t audio_ring_blocks = AUDIO_RING_BLOCKS;
 
-// channel audio processing function 
+// the control rate: run_compression does one tick per DMA block.
+// set_blocks (core 1) asks for a new rate in control_rate_request and
+// control_tick takes it, so the dynamics are only touched on core 0
 
+uint32_t control_rate_hz;
+volatile uint32_t control_rate_request;
 
+static uint32_t block_rate_hz() {
+    return i2s_config_default.fs / audio_block_frames;
+}
 
-static void process_audio(const int32_t* input, int32_t* output, size_t num_frames) {
-    int32_t word;
-    float wordf;
-    float input_word;
-    float output_word;
-    int32_t abs_word;
-    int32_t abs_output_word;
-    bool mixed = (machine_state.output_mix < 1.0);
-    float trim_gain = machine_state.input_trim_gain;
-    
-    // copy the input to the output
-    for (size_t i = 0; i < num_frames * 2; i++) {
-	
-	word = input[i];  // get the current word
-	wordf = int2float(word);
+// time for mute to fade the channel fully in or out
+#define MUTE_FADE_MS 5.0
 
-	// apply any channel level input trim gain to the signal...
-	// prior to measurement and processing
+dynamics dyn;
 
-	wordf = wordf * trim_gain;
+// timing and xruns of the audio interrupt
+irq_profile irq_prof SRAM_BANK(3);
 
-	// collect the original input word for output signal mixing
-	input_word = wordf; 
-	
-	// get the absolute value and see if it greater than current peak
-	
-	if (word < 0) {
-	    abs_word = word * -1;
-	} else {
-	    abs_word = word;
-	}
-	
-	// assert(abs_word >= 0);
+// the block peaks gathered into the controller's meter reports
+meter_stream meter_reports;
 
-	// get a normalized magnitude of the current word, which can be positive or negative
-	wordf = wordf * calculated_net_gain;
+// DC offset and stuck data on the input, from the DMA sniffer
+input_monitor input_mon SRAM_BANK(3);
 
-	// mix in the original signal if set to..
+// stages that fit the cycle budget at this sample rate (see check_budget)
+bool sends_fit = true;
+bool filters_fit = true;
 
-	if (mixed) {
-	    wordf = (comp_output_mix * wordf) + (raw_output_mix * input_word);
-	}
 
-	//unfiltered_word = wordf;
-	
-	// apply channel balance
-	// convert to a signed int32 and place in the output buffer
-	
-	if (i%2 == 0) {
-	    if (abs_word > peak_amp_l) peak_amp_l = abs_word;
-	    wordf = wordf*balance_l_gain;
-	    output_word = float2int(wordf);	    
-	    output[i] = output_word;
-
-	    if (output_word < 0) {
-		abs_output_word = output_word * -1;
-	    } else {
-		abs_output_word = output_word;
-	    }
-	    if (abs_output_word > peak_amp_output_l) {
-		peak_amp_output_l = abs_output_word;
-	    } 	    
-	} else {
-	    if (abs_word > peak_amp_r) peak_amp_r = abs_word;
-	    
-	    wordf = wordf*balance_r_gain;
-	    output_word = float2int(wordf);	    	    
-	    output[i] = output_word;
-
-	    if (output_word < 0) {
-		abs_output_word = output_word * -1;
-	    } else {
-		abs_output_word = output_word;
-	    }
-	    if (abs_output_word > peak_amp_output_r) {
-		peak_amp_output_r = abs_output_word;
-	    }
-	}		
-    }
+// channel audio processing function - float, Q31 or interpolator
+// depending on DSP_FIXED_POINT and DSP_INTERP
+// sends is the send 1/send 2 block, or null if the sends aren't running
+
+void SRAM_ISR_FUNC(process_audio)(const int32_t* input, int32_t* output, int32_t* sends, size_t num_frames) {
+    channel_process(&kernel, input, output, sends, num_frames);
     call_count++;
 }
 
 
-static void dma_i2s_in_handler(void) {
-    /* We're double buffering using chained TCBs. By checking which buffer the
-     * DMA is currently reading from, we can identify which buffer it has just
-     * finished reading (the completion of which has triggered this interrupt).
+static void SRAM_ISR_FUNC(dma_i2s_in_handler)(void) {
+    /* We're buffering through a ring of chained TCBs. From where the
+     * control channel is reading we can identify which block the input
+     * has just finished (the completion of which has triggered this
+     * interrupt).  The output of that block goes out ring_blocks - 1
+     * blocks from now, and the sends with it.
      */
-    if (*(int32_t**)dma_hw->ch[i2s.dma_ch_in_ctrl].read_addr == i2s.input_buffer) {
-        // It is inputting to the second buffer so we can overwrite the first
-        process_audio(i2s.input_buffer, i2s.output_buffer, AUDIO_BUFFER_FRAMES);
-    } else {
-        // It is currently inputting the first buffer, so we write to the second
-        process_audio(&i2s.input_buffer[STEREO_BUFFER_SIZE], &i2s.output_buffer[STEREO_BUFFER_SIZE], AUDIO_BUFFER_FRAMES);
-    }
+    uint32_t start = dsp_cycles();
+    uint32_t sniff = i2s_sniff_take(input_mon.mode == INPUT_MONITOR_CRC);
+    uint8_t block = i2s_completed_block(&i2s);
+    int32_t *sends = i2s.sends ? i2s_block(i2s.send1_buffer, &i2s, block) : 0;
+    process_audio(i2s_block(i2s.input_buffer, &i2s, block), i2s_block(i2s.output_buffer, &i2s, block), sends, i2s.block_frames);
+    input_monitor_block(&input_mon, sniff, kernel.meter.block_in, i2s.block_frames);
+    irq_profile_record(&irq_prof, block, i2s_completed_block(&i2s), i2s.ring_blocks, dsp_cycles_since(start));
     dma_hw->ints0 = 1u << i2s.dma_ch_in_data;  // clear the IRQ
+    dsp_signal();  // wake the dsp loop for the control tick
 }
 
 
@@ -412,7 +381,10 @@ Compression processing logic
 -- theory of operation ----
 
 target_gain is the current instant computed gain that should be
-applied to the signal to conform with the threshold setting.
+applied to the signal to conform with the threshold setting.  It is
+read from the compressor's static curve (threshold, ratio and knee),
+a table of gains over input level in dB rebuilt when those settings
+change (see lib/dynamics.c).
 
 if it is 1, no compression should be applied
 if < 1, compression should follow
@@ -422,459 +394,491 @@ rgain follows target_gain by being pushed and pulled incrementally
 toward target_gain.  It is necessary because if we just adjusted the
 signal strength based on the instantaneous target_gain, it would result
 in clicks and pops as the signal would be adjusted too quickly and the
-transients too large. rgain essentially imposes a slew rate via a
-moving average to mitigate and soften the transient changes applied 
-to the signal.
+transients too large. rgain essentially imposes a slew rate to
+mitigate and soften the transient changes applied to the signal.
+Within each block the audio interrupt ramps linearly from the last
+net gain to the new one, so the per-tick changes don't zipper.
 
 Since the compression has an attack and release rate, we need to
-reach the target gain over a number of cycles.  Therefore, based on
-the current time required to complete a cycle of the loop (cycle_time),
-the number of steps to decrement gain (attack) or increase gain (release),
-is computed.  Then rgain is adjusted by the computed step value, and
-it either decreases the gain (compress), or increments the gain back toward
-1.0 (no compression).
+reach the target gain over a number of cycles.  The loop runs once
+per DMA block (the control tick), sleeping in between, so the tick
+period is fixed by the sample rate and block size.  The attack and
+release times are turned into per-tick exponential coefficients when
+they change, and each tick rgain moves that fraction of the way
+toward target_gain, either decreasing the gain (compress) or
+increasing it back toward 1.0 (no compression).
 
 Once rgain is computed on the signal, a makeup constant is applied,
 which should be considered the post-compression gain.  
 
 */
 
-void run_compression() {
+/* One control tick: fold in the peaks the audio interrupt published
+ * for the last block(s), step the gate, mute and compressor, and hand
+ * the new net gain to the kernel for the next block.
+ */
 
+void control_tick(meter_snapshot *meter) {
+
+    static uint64_t ctime = 0;  // current millisecond 
     
-    uint64_t ctime = 0;  // current microsecond 
-    uint64_t start_time; // cycle start time 
-    
-    int32_t local_peak_amp = 1;  // greatest of left or right
-    int32_t local_peak_amp_l = 1;
-    int32_t local_peak_amp_r = 1;
+    static int32_t local_peak_amp = 1;  // greatest of left or right
+    static int32_t local_peak_amp_l = 1;
+    static int32_t local_peak_amp_r = 1;
 
-    int32_t current_input_amp_l = 1;
-    int32_t current_input_amp_r = 1;
-    int32_t current_input_amp = 1; // greatest of left or right
+    static int32_t current_input_amp_l = 1;
+    static int32_t current_input_amp_r = 1;
+    static int32_t current_input_amp = 1; // greatest of left or right
 
-    int32_t current_output_amp_r = 1;
-    int32_t current_output_amp_l = 1;;
+    static int32_t current_output_amp_r = 1;
+    static int32_t current_output_amp_l = 1;;
     
-    int32_t local_output_peak_amp = 1;
-    int32_t local_output_peak_amp_l = 1;
-    int32_t local_output_peak_amp_r = 1;
+    static int32_t local_output_peak_amp = 1;
+    static int32_t local_output_peak_amp_l = 1;
+    static int32_t local_output_peak_amp_r = 1;
 
     // time tracking for peak indicators 
-    uint32_t last_input_peak_time = 0;
-    uint32_t last_input_peak_time_l = 0;
-    uint32_t last_input_peak_time_r = 0;
-    uint32_t last_output_peak_time = 0;
-    uint32_t last_output_peak_time_l = 0;
-    uint32_t last_output_peak_time_r = 0;
-    
+    static uint32_t last_input_peak_time = 0;
+    static uint32_t last_input_peak_time_l = 0;
+    static uint32_t last_input_peak_time_r = 0;
+    static uint32_t last_output_peak_time = 0;
+    static uint32_t last_output_peak_time_l = 0;
+    static uint32_t last_output_peak_time_r = 0;
+
+    static uint32_t last_blocks = 0;
     
-    float rgain = 1;  // relative gain applied to the signal based on the threshold
-    float mgain = 1;
-    int32_t delta;
-    int32_t threshold;
-    uint16_t attack_rate = machine_state.attack_rate_ms;
-    uint16_t release_rate = machine_state.release_rate_ms;
-    
-    float gain_ratio = 1;
-    float target_gain = 1; // where we want to be at any given moment based on the input
-    float attack_steps = 500;  
-    float release_steps = 1000;
-    float delta_per_step = 0.001;
-    float cycle_time = 0;
-    int64_t calculated_output_value;
-    float ratio_coef = 1.0;  // 0 - 1, where 1 ~= threshold:1 (aka limiter) and 0 is lighter compression post threshold
-    float mute_gain = 1.0; // 1.0 if not muted, muted = 0;
-    average *rgain_avg = initialize_average(20);
-
-    average *cycle_time_avg = initialize_average(100);
-
-    bool over_limit = false;
-    int32_t over_limit_value = MAX_AMPLITUDE-1000;
-
-
-    float gate_attack_steps = 500;
-    float gate_release_steps = 10000;
+    static float rgain = 1;  // relative gain applied to the signal based on the threshold
+    static float mgain = 1;
+    static int64_t calculated_output_value;
+    static float mute_gain = 1.0; // 1.0 if not muted, muted = 0;
 
-    float mute_gain_step = 0.01; // so it doesn't snap or click going on and off
+    static float gate_gain = 0;
     
-    float gate_gain = 0;
-    uint32_t gate_below_threshold_time = 0;
-    int32_t gate_threshold = machine_state.gate_threshold_sample;
-    bool gate_below_threshold = true;
+    uint32_t busy_start = time_us_32();
+    // a new block size changes the control rate
+    uint32_t rate = control_rate_request;
+    if (rate != control_rate_hz) {
+	control_rate_hz = rate;
+	dynamics_set_rate(&dyn, rate);
+    }
+    // control periods (DMA blocks) since the last tick
+    uint32_t ticks = clamp(meter->blocks - last_blocks, 1, control_rate_hz);
+    last_blocks = meter->blocks;
+    machine_state.cycle_time_us = (ticks * 1000000) / control_rate_hz;
+    machine_state.uptime_milliseconds = to_ms_since_boot(get_absolute_time());
     
-    printf("starting dsp loop\n");
+    // collect the peaks published by the audio interrupt since the last
+    // pass, holding them against the decay below
+    current_input_amp_l = max(current_input_amp_l, meter->in_l);
+    current_input_amp_r = max(current_input_amp_r, meter->in_r);
+    current_output_amp_l = max(current_output_amp_l, meter->out_l);
+    current_output_amp_r = max(current_output_amp_r, meter->out_r);
+
+    current_input_amp = max(current_input_amp_l,current_input_amp_r); // take the greater of left or right
+    if (current_input_amp > local_peak_amp) {
+	local_peak_amp = current_input_amp;
+	last_input_peak_time = 0;
+    }
+    if (current_input_amp_l > local_peak_amp_l) {	    
+	local_peak_amp_l = current_input_amp_l;
+	last_input_peak_time_l = 0;
+    }
+    if (current_input_amp_r > local_peak_amp_r) {
+	local_peak_amp_r = current_input_amp_r;
+	last_input_peak_time_r = 0;
+    }
+    // collect current output situation
     
-    threshold = machine_state.threshold_sample;
-
-    while(1) {
-	// time accounting for rate calculations
-	start_time = time_us_64();
-	machine_state.uptime_milliseconds = to_ms_since_boot(get_absolute_time());
-	
-	// collect the value of the input peak amplitude at the current moment
-	current_input_amp_l = peak_amp_l;
-	current_input_amp_r = peak_amp_r;
-
-	current_input_amp = max(current_input_amp_l,current_input_amp_r); // take the greater of left or right
-	if (current_input_amp > local_peak_amp) {
-	    local_peak_amp = current_input_amp;
-	    last_input_peak_time = 0;
-	}
-	if (current_input_amp_l > local_peak_amp_l) {	    
-	    local_peak_amp_l = current_input_amp_l;
-	    last_input_peak_time_l = 0;
-	}
-	if (current_input_amp_r > local_peak_amp_r) {
-	    local_peak_amp_r = current_input_amp_r;
-	    last_input_peak_time_r = 0;
-	}
-	// collect current output situation
-        
-	if (peak_amp_output_l > local_output_peak_amp_l) {
-	    local_output_peak_amp_l=peak_amp_output_l;
-	    last_output_peak_time_l = 0;
-	}
-	if (peak_amp_output_r > local_output_peak_amp_r) {
-	    local_output_peak_amp_r=peak_amp_output_r;
-	    last_output_peak_time_r = 0;
-	}
+    if (current_output_amp_l > local_output_peak_amp_l) {
+	local_output_peak_amp_l=current_output_amp_l;
+	last_output_peak_time_l = 0;
+    }
+    if (current_output_amp_r > local_output_peak_amp_r) {
+	local_output_peak_amp_r=current_output_amp_r;
+	last_output_peak_time_r = 0;
+    }
 
-	// record for the machine state
-	machine_state.peak_amp_l = local_peak_amp_l;
-	machine_state.peak_amp_r = local_peak_amp_r;
-	machine_state.output_peak_amp_l = local_output_peak_amp_l;
-	machine_state.output_peak_amp_r = local_output_peak_amp_r;
-	machine_state.current_input_amp_l = current_input_amp_l;
-	machine_state.current_input_amp_r = current_input_amp_r;
-	
-	// is the gate active
-	if (machine_state.gate_active) {
-	    if ((current_input_amp_l >= gate_threshold)||(current_input_amp_r >= gate_threshold)) {
-		gate_below_threshold_time = 0; // reset our timer for when we fall below
-		gate_gain = max(0, min(1.0, gate_gain + (1 / gate_attack_steps)));
-		gate_below_threshold = false;
-		machine_state.gate_open = 1;
-	    } else if ((current_input_amp_l < gate_threshold)&&(current_input_amp_r < gate_threshold)) {
-		gate_below_threshold = true;
-		// only decrement once we are passed the hold time		
-		if ((gate_below_threshold_time > machine_state.gate_hold_ms) && (gate_gain > 0)) {
-		    machine_state.gate_open = 0;
-		    gate_gain = max(0, min(1.0, gate_gain - (1 / gate_release_steps)));		    
-		}
-	    }
-	    // and apply the current gain..experiment: allow compressor to still be active
-	    // while the gate is closed, so when it opens it may already be where it needs
-	    // to be...
-	    // current_input_amp = (int32_t) floorf((float) current_input_amp * gate_gain);
-	} else {
-	    gate_gain = 1;
-	}
+    // record for the machine state
+    machine_state.peak_amp_l = local_peak_amp_l;
+    machine_state.peak_amp_r = local_peak_amp_r;
+    machine_state.output_peak_amp_l = local_output_peak_amp_l;
+    machine_state.output_peak_amp_r = local_output_peak_amp_r;
+    machine_state.current_input_amp_l = current_input_amp_l;
+    machine_state.current_input_amp_r = current_input_amp_r;
+    machine_state.output_amp_l = current_output_amp_l;
+    machine_state.output_amp_r = current_output_amp_r;
+    
+    // the gate, if active.  Experiment: the compressor stays active
+    // while the gate is closed, so when it opens it may already be
+    // where it needs to be...
+    gate_gain = dynamics_gate(&dyn, current_input_amp_l, current_input_amp_r, machine_state.gate_active, ticks);
+    machine_state.gate_open = dyn.gate_open;
+
+    // mute fades over MUTE_FADE_MS so it doesn't snap or click going
+    // on and off, the audio interrupt interpolates within the block
+    if (machine_state.muted > 0) {
+	mute_gain = max(0.0, mute_gain - (ticks * dyn.tick_ms / MUTE_FADE_MS));
+    } else {
+	mute_gain = min(1.0, mute_gain + (ticks * dyn.tick_ms / MUTE_FADE_MS));
+    }
       
-	if (machine_state.compressor_on) {
+    if (machine_state.compressor_on) {
 
-	    // calculate the current steps nee
-	
-	    // determine if the current amplitude is greater than our threshold
-	    delta = current_input_amp - threshold;
-
-	    // do the compression gain calculations...
-	    // if gain_ratio is positive, the signal amplitude is past the threshold
-	    // otherwise if it is negative, the amplitude is below the threshold	    
-	    
-	    gain_ratio = (float) ((float) current_input_amp / (float) threshold);
-	    
-	    // ratio will be handled by adding a coefficient to the log addition
-	    if (gain_ratio > 1.0) gain_ratio = gain_ratio + (ratio_coef * log10f(gain_ratio));
-	    // if gain ratio is below 1, then rgain is below 1
-	    if (gain_ratio < 1.0) gain_ratio = 1;
-
-	    // target gain is the reciprocal of the current gain multiple
-	    // target is the instantaneous target value to adjust gain to
-	    target_gain = 1.0 / gain_ratio;
-
-	    target_gain = clamp(target_gain,0.0,1.0);
-
-	    // apply a slew rate using a stepped approach and a moving average
-	    // to smooth the transient changes applied to the final compression
-	    // gain...
-	    
-	    if (delta > 0) {
-		//  it's past our current threshold, adjust gain accordingly...
-		// depending on our attack rate	    
-		delta_per_step = (rgain - target_gain) / attack_steps;
-		/*if (delta_per_step <= 0.0001) {
-		    delta_per_step = 0.0001;
-		    }*/
-	    } else {	    
-		// we're below so implement the release steps..
-		// rgain should be below target_gain, so we have a negative step delta..
-		delta_per_step = (rgain - target_gain) / release_steps;
-		if (delta_per_step >= -0.0001) {
-		    delta_per_step = -0.0001;
-		} 
-	    } 
-	    //if (rgain < 1.0) {
-	    // adjust rgain based on the timing and the difference to target_gain
-	    rgain = rgain - delta_per_step;
-	    //}
-	    // this is the compressor gain portion, which we don't want higher than 1
-	    if (rgain > 1.0) {
-		rgain = 1.0;
-	    } else if (rgain < 0.0) {
-		rgain = 0;
-	    }
-
-	    // smooth rgain out so it is not sharply adjusted...
-	    
-	    rgain = (float) moving_average(rgain_avg, rgain, false);
-	    machine_state.compression_gain = rgain;
-
-	    // makeup applies a gain for the compressed value 
-	    // channel_gain provides the final output gain applied to the channel
-	    
-	    // mgain = rgain * machine_state.makeup * machine_state.channel_gain * gate_gain;
-	    
-	    // do final gain with message to VCA DACS so don't include channel_gain here
-	    // this is because there are 3 different output gain settings, channel, send 1 and
-	    // send 2.
-	    mgain = rgain * machine_state.makeup * gate_gain;
-	    	
-	  
-	    // register our computed output amplitude
-	    calculated_output_value = (int32_t) floorf(mgain * (float) current_input_amp);
-	    if (calculated_output_value > over_limit_value) {
-		over_limit_time = 0;
-		calculated_output_value = over_limit_value;
-		mgain = 0.9;
-	    } else if (calculated_output_value < -over_limit_value) {
-		over_limit_time = 0;
-		calculated_output_value = -over_limit_value;
-		mgain = 0.9;
-	    }
-	    // is mute on?  If so apply and send to the processing loop  
-	    // set the overall negative gain for the processing loop by setting calculated_net_gain
-	    calculated_net_gain = mgain * mute_gain;  //
-	    machine_state.output_amp = (int32_t) calculated_output_value;
-	    if (machine_state.output_amp > local_output_peak_amp) {	       
-		local_output_peak_amp = machine_state.output_amp;
-		last_output_peak_time = 0;	       
-		//		if (machine_state.output_peak_amp > 2000000) printf("\n%ld %f %ld %ld\n",machine_state.output_peak_amp, mgain, delta, neg_gain);
-	    }	    	    
-	    
-	} else {
-	    
-	    // compressor off so just pass on the value as received
-	    // only modulated by the current channel_gain value
-	    machine_state.compression_gain = 1.0;
-	    calculated_net_gain = mute_gain * machine_state.channel_gain * gate_gain;  // TODO: BUG - are we calculating channel gain twice due to VCA
-	    mgain = 1.0;
-	    rgain = 1.0;
-	    machine_state.output_amp = (int32_t) (machine_state.channel_gain * (float) current_input_amp);
-	    if (machine_state.output_amp > local_output_peak_amp) {
-		local_output_peak_amp = machine_state.output_amp;
-		last_output_peak_time = 0;  // reset our counter...
-	    }
-	}
-	// check if it is a new millisecond 
-	if (ctime < machine_state.uptime_milliseconds) {
-
-	    // Do the db calculations 
-	    machine_state.signal_amp_dB = signal_dB(current_input_amp); 
-	    machine_state.peak_amp_dB = signal_dB(local_peak_amp);
-	    	  
-	    // update any settings
-	    threshold = machine_state.threshold_sample; // update threshold_sample if needed	    
-	    attack_rate = machine_state.attack_rate_ms;		
-	    
-	    if (attack_rate == 0) attack_steps = machine_state.min_steps;  // avoid divide by 0 and enough to avoid chop
-	    else attack_steps = round((attack_rate*1000)/cycle_time);
-	    
-	    release_rate = machine_state.release_rate_ms;	    
-	    if (release_rate == 0) release_steps = machine_state.min_steps;	    
-	    else release_steps = round((release_rate*1000)/cycle_time);
-
-	    gate_threshold = machine_state.gate_threshold_sample;
-	    gate_attack_steps = round((machine_state.gate_attack_ms*1000)/cycle_time);
-	    gate_release_steps = round((machine_state.gate_release_ms*1000)/cycle_time);
-	    machine_state.gate_gain = gate_gain;
-	    if (gate_below_threshold) {
-		gate_below_threshold_time++;  // increment our milisecond counter;
-	    }
+	// step the compressor envelope toward the target gain for the
+	// current input level (see lib/dynamics.c)
+	rgain = dynamics_compress(&dyn, current_input_amp, ticks);
+	machine_state.compression_gain = rgain;
 
-	    if (machine_state.muted > 0) {
-		mute_gain = max(0.0, mute_gain-mute_gain_step);		
-	    } else {
-	        mute_gain = min(1.0, mute_gain+mute_gain_step);	      
-	    }
-	    
-	    if (machine_state.log_activity && machine_state.uptime_milliseconds % 200 == 0) {
-		printf("M%d C%d G%d%d  %5.2fdB  IN[L %5.2fdB/%5.2fdB] [R %5.2fdB/%5.2fdB]   OUT[L %5.2fdB/%4.2fdB] [R %5.2fdB/%4.2fdB]      \r",
-		       machine_state.muted,
-		       machine_state.compressor_on,
-		       machine_state.gate_active,
-		       machine_state.gate_open,
-		       signal_dB((int32_t) roundf(machine_state.compression_gain*(float)MAX_AMPLITUDE)),
-		       signal_dB((int32_t) machine_state.current_input_amp_l),
-		       signal_dB((int32_t) machine_state.peak_amp_l),
-		       signal_dB((int32_t) machine_state.current_input_amp_r),
-		       signal_dB((int32_t) machine_state.peak_amp_r),
-		       signal_dB((int32_t) machine_state.output_amp_l),
-		       signal_dB((int32_t) machine_state.output_peak_amp_l),
-		       signal_dB((int32_t) machine_state.output_amp_r),
-		       signal_dB((int32_t) machine_state.output_peak_amp_r)); 
-		
-		       
- 		/*printf("%d  %4.2fdB/%4.2fdB   %3ldus  %.3f/%4.2fdB  [%.0f %.0f] NGG=%1.3f  %6.0f GR=%2.3f TG=%2.3f RG=%2.3f MG=%2.3f DPS=%1.5f     \r", \
-			   machine_state.compressor_on,\
-			   machine_state.peak_amp_dB,\
-			   machine_state.signal_amp_dB,\
-			   machine_state.cycle_time_us,\
-			   machine_state.compression_gain,\
-			   signal_dB((int32_t) roundf(machine_state.compression_gain*(float)MAX_AMPLITUDE)),\
-			   attack_steps,\
-			   release_steps,\
-		           gate_gain,\
-			   floor(machine_state.uptime_milliseconds/1000),\
-			   gain_ratio,\
-			   target_gain,\
-			   rgain,\
-		           mgain,\
-		           delta_per_step); */
-	    }
-	    last_input_peak_time++;
-	    last_output_peak_time++;
-	    last_input_peak_time_l++;
-	    last_input_peak_time_r++;
-	    last_output_peak_time_l++;
-	    last_output_peak_time_r++;
-	    over_limit_time++;
-	    if (machine_state.muted == 0) {
-		if (over_limit && over_limit_time > 750) {
-		    gpio_put(MUTE_GPIO,0);
-		    over_limit = false;
-		}
-		if (over_limit_time < 750) {
-		    gpio_put(MUTE_GPIO,1);
-		    over_limit = true;
-		}
-	    }
+	// makeup applies a gain for the compressed value 
+	// channel_gain provides the final output gain applied to the channel
+        
+	// mgain = rgain * machine_state.makeup * machine_state.channel_gain * gate_gain;
+        
+	// do final gain with message to VCA DACS so don't include channel_gain here
+	// this is because there are 3 different output gain settings, channel, send 1 and
+	// send 2.
+	mgain = rgain * machine_state.makeup * gate_gain;
+        	
+      
+	// register our computed output amplitude, overloads are
+	// caught by the output limiter in the audio path
+	calculated_output_value = (int32_t) floorf(mgain * (float) current_input_amp);
+	// is mute on?  If so apply and send to the processing loop  
+	// set the overall negative gain for the processing loop through the kernel net gain
+	channel_kernel_set_net_gain(&kernel, mgain * mute_gain);
+	machine_state.output_amp = (int32_t) calculated_output_value;
+	if (machine_state.output_amp > local_output_peak_amp) {	       
+	local_output_peak_amp = machine_state.output_amp;
+	last_output_peak_time = 0;	       
+	}	    	    
+        
+    } else {
+        
+	// compressor off so just pass on the value as received
+	// only modulated by the current channel_gain value
+	machine_state.compression_gain = 1.0;
+	channel_kernel_set_net_gain(&kernel, mute_gain * machine_state.channel_gain * gate_gain);  // TODO: BUG - are we calculating channel gain twice due to VCA
+	mgain = 1.0;
+	rgain = 1.0;
+	machine_state.output_amp = (int32_t) (machine_state.channel_gain * (float) current_input_amp);
+	if (machine_state.output_amp > local_output_peak_amp) {
+	local_output_peak_amp = machine_state.output_amp;
+	last_output_peak_time = 0;  // reset our counter...
 	}
-	// handle the fall back of the peak amplitude, normalized to cycle time
-	// only fall back after the delay period...
-	if (last_input_peak_time > 750) {
-	    local_peak_amp-=(1000 * machine_state.cycle_time_us);
-	    if (local_peak_amp < 0) {
-		local_peak_amp = 0;	    
-	    }
+    }
+    // check if it is a new millisecond 
+    if (ctime < machine_state.uptime_milliseconds) {
+
+	// Do the db calculations 
+	machine_state.signal_amp_dB = signal_dB(current_input_amp); 
+	machine_state.peak_amp_dB = signal_dB(local_peak_amp);
+        	  
+	// update any settings - the coefficients are only recomputed on a change
+	dynamics_set_curve(&dyn, machine_state.threshold_dB, machine_state.ratio, machine_state.knee_dB);
+	dynamics_set_times(&dyn, machine_state.attack_rate_ms, machine_state.release_rate_ms, machine_state.min_steps);
+	dynamics_set_gate(&dyn, machine_state.gate_threshold_sample, machine_state.gate_attack_ms, machine_state.gate_hold_ms, machine_state.gate_release_ms);
+	machine_state.gate_gain = gate_gain;
+        
+	if (machine_state.log_activity && machine_state.uptime_milliseconds % 200 == 0) {
+	printf("M%d C%d G%d%d  %5.2fdB  IN[L %5.2fdB/%5.2fdB] [R %5.2fdB/%5.2fdB]   OUT[L %5.2fdB/%4.2fdB] [R %5.2fdB/%4.2fdB]  CLIP %lu     \r",
+	       machine_state.muted,
+	       machine_state.compressor_on,
+	       machine_state.gate_active,
+	       machine_state.gate_open,
+	       signal_dB((int32_t) roundf(machine_state.compression_gain*(float)MAX_AMPLITUDE)),
+	       signal_dB((int32_t) machine_state.current_input_amp_l),
+	       signal_dB((int32_t) machine_state.peak_amp_l),
+	       signal_dB((int32_t) machine_state.current_input_amp_r),
+	       signal_dB((int32_t) machine_state.peak_amp_r),
+	       signal_dB((int32_t) machine_state.output_amp_l),
+	       signal_dB((int32_t) machine_state.output_peak_amp_l),
+	       signal_dB((int32_t) machine_state.output_amp_r),
+	       signal_dB((int32_t) machine_state.output_peak_amp_r),
+	       machine_state.clip_events);
+    	
+    	       
+		/*printf("%d  %4.2fdB/%4.2fdB   %3ldus  %.3f/%4.2fdB  [%.0f %.0f] NGG=%1.3f  %6.0f GR=%2.3f TG=%2.3f RG=%2.3f MG=%2.3f DPS=%1.5f     \r", \
+		   machine_state.compressor_on,\
+		   machine_state.peak_amp_dB,\
+		   machine_state.signal_amp_dB,\
+		   machine_state.cycle_time_us,\
+		   machine_state.compression_gain,\
+		   signal_dB((int32_t) roundf(machine_state.compression_gain*(float)MAX_AMPLITUDE)),\
+		   attack_steps,\
+		   release_steps,\
+		   gate_gain,\
+		   floor(machine_state.uptime_milliseconds/1000),\
+		   gain_ratio,\
+		   target_gain,\
+		   rgain,\
+		   mgain,\
+		   delta_per_step); */
 	}
-	if (last_input_peak_time_l > 750) {
-	    local_peak_amp_l-=(1000 * machine_state.cycle_time_us);	    
-	    if (local_peak_amp_l < 0) {
-		local_peak_amp_l = 0;
-	    }
-	    
+	last_input_peak_time++;
+	last_output_peak_time++;
+	last_input_peak_time_l++;
+	last_input_peak_time_r++;
+	last_output_peak_time_l++;
+	last_output_peak_time_r++;
+	machine_state.clip_events = kernel.limiter.clip_events;
+    }
+    // handle the fall back of the peak amplitude, normalized to cycle time
+    // only fall back after the delay period...
+    if (last_input_peak_time > 750) {
+	local_peak_amp-=(1000 * machine_state.cycle_time_us);
+	if (local_peak_amp < 0) {
+	local_peak_amp = 0;	    
 	}
-	if (last_input_peak_time_r > 750) {
-	    local_peak_amp_r-=(1000 * machine_state.cycle_time_us);
-	    if (local_peak_amp_r < 0) {
-		local_peak_amp_r = 0;
-	    }	    
+    }
+    if (last_input_peak_time_l > 750) {
+	local_peak_amp_l-=(1000 * machine_state.cycle_time_us);	    
+	if (local_peak_amp_l < 0) {
+	local_peak_amp_l = 0;
 	}
-	
-	if (last_output_peak_time > 750) {	    
-	    local_output_peak_amp-=(1000 * machine_state.cycle_time_us);
-	    if (local_output_peak_amp < 0) {
-		local_output_peak_amp = 0;	   
-		
-	    }
+        
+    }
+    if (last_input_peak_time_r > 750) {
+	local_peak_amp_r-=(1000 * machine_state.cycle_time_us);
+	if (local_peak_amp_r < 0) {
+	local_peak_amp_r = 0;
+	}	    
+    }
+    
+    if (last_output_peak_time > 750) {	    
+	local_output_peak_amp-=(1000 * machine_state.cycle_time_us);
+	if (local_output_peak_amp < 0) {
+	local_output_peak_amp = 0;	   
+    	
 	}
-	if (last_output_peak_time_l > 750) {	    
-	    local_output_peak_amp_l-=(1000 * machine_state.cycle_time_us);
-	    if (local_output_peak_amp_l < 0) {
-		local_output_peak_amp_r = 0;	   		
-	    }
+    }
+    if (last_output_peak_time_l > 750) {	    
+	local_output_peak_amp_l-=(1000 * machine_state.cycle_time_us);
+	if (local_output_peak_amp_l < 0) {
+	local_output_peak_amp_r = 0;	   		
 	}
-	if (last_output_peak_time_r > 750) {	    
-	    local_output_peak_amp_r-=(1000 * machine_state.cycle_time_us);
-	    if (local_output_peak_amp_r < 0) {
-		local_output_peak_amp_r = 0;	   		
-	    }
+    }
+    if (last_output_peak_time_r > 750) {	    
+	local_output_peak_amp_r-=(1000 * machine_state.cycle_time_us);
+	if (local_output_peak_amp_r < 0) {
+	local_output_peak_amp_r = 0;	   		
 	}
-	
-	// let the global machine structure know the current peak once it has been validated
+    }
+    
+    // let the global machine structure know the current peak once it has been validated
 
-	machine_state.output_peak_amp_l = local_peak_amp_l;
-	machine_state.output_peak_amp_r = local_peak_amp_r;
-	
-	// rapidly diminish the current input amplitude
-	current_input_amp-=(15000*machine_state.cycle_time_us);
-	if (current_input_amp < 0) {
-	    current_input_amp = 0;
-	}
-	current_input_amp_l-=(15000*machine_state.cycle_time_us);
-	if (current_input_amp_l < 0) {
-	    current_input_amp_l = 0;
-	}
-	current_input_amp_r-=(15000*machine_state.cycle_time_us);
-	if (current_input_amp_r < 0) {
-	    current_input_amp_r = 0;
-	}
-	current_output_amp_l-=(15000*machine_state.cycle_time_us);
-	if (current_output_amp_l < 0) {
-	    current_output_amp_l = 0;
+    machine_state.output_peak_amp_l = local_peak_amp_l;
+    machine_state.output_peak_amp_r = local_peak_amp_r;
+    
+    // rapidly diminish the current input amplitude
+    current_input_amp-=(15000*machine_state.cycle_time_us);
+    if (current_input_amp < 0) {
+	current_input_amp = 0;
+    }
+    current_input_amp_l-=(15000*machine_state.cycle_time_us);
+    if (current_input_amp_l < 0) {
+	current_input_amp_l = 0;
+    }
+    current_input_amp_r-=(15000*machine_state.cycle_time_us);
+    if (current_input_amp_r < 0) {
+	current_input_amp_r = 0;
+    }
+    current_output_amp_l-=(15000*machine_state.cycle_time_us);
+    if (current_output_amp_l < 0) {
+	current_output_amp_l = 0;
+    }
+    current_output_amp_r-=(15000*machine_state.cycle_time_us);
+    if (current_output_amp_r < 0) {
+	current_output_amp_r = 0;
+    }
+    
+    // the peaks as read, for the controller's meters (not the decayed
+    // values above, the controller does its own ballistics)
+    meter_stream_add(&meter_reports, meter, machine_state.compression_gain, machine_state.cycle_time_us);
+
+    // time accounting
+    ctime = machine_state.uptime_milliseconds;
+    machine_state.control_busy_us = moving_average(control_busy_avg, (float) (time_us_32() - busy_start), false);
+}
+
+void run_compression() {
+    meter_snapshot meter;  // block peaks from the audio interrupt
+
+    printf("starting dsp loop\n");
+    while(1) {
+	// sleep until the audio interrupt publishes the next block: one
+	// block is one control tick, so the envelope timing doesn't
+	// depend on how long this loop takes
+	while (!meter_read(&kernel.meter, &meter)) {
+	    dsp_wait();
 	}
-	current_output_amp_r-=(15000*machine_state.cycle_time_us);
-	if (current_output_amp_r < 0) {
-	    current_output_amp_r = 0;
+	control_tick(&meter);
+    }
+}
+
+// the controller link: uart1 run by DMA (lib/uart_dma.h), carrying
+// the framed messages of lib/proto.h
+
+uart_dma controller_link;
+proto_rx controller_rx;
+
+// frame a message and queue it for the controller; dropped (and
+// counted) if the link's transmit ring is full
+
+void send_message(uint8_t type, const void *payload) {
+    uint8_t frame[PROTO_MAX_FRAME];
+    size_t len = proto_encode(type, payload, frame);
+    uart_dma_send(&controller_link, frame, len);
+}
+
+/* Parameter sync (lib/proto.h): the settings the controller mirrors,
+ * by command letter, and the version each was last published at.  A
+ * change made at the console is marked by set_param() and published
+ * as a PROTO_PARAM on the next pass of handle_command_io(); one made
+ * by the controller is published in its ack.
+ */
+
+static const char sync_params[] = "artcbRkSmg12GAEHNOMxXTLh";
+#define SYNC_PARAMS (sizeof(sync_params) - 1)
+
+uint16_t param_version = 0;               // the last version published
+uint16_t param_versions[SYNC_PARAMS];
+bool param_changed[SYNC_PARAMS];
+
+float get_param(char param);
+
+static int param_index(char param) {
+    char *p = strchr(sync_params, param);
+    return (p && param) ? p - sync_params : -1;
+}
+
+// give param the next version, and clear its mark
+
+static uint16_t publish_param(int i) {
+    param_changed[i] = false;
+    param_versions[i] = ++param_version;
+    return param_version;
+}
+
+// send the marked parameters
+
+void flush_params() {
+    proto_param p;
+
+    for (size_t i = 0; i < SYNC_PARAMS; i++) {
+	if (param_changed[i]) {
+	    p.param = sync_params[i];
+	    p.flags = 0;
+	    p.version = publish_param(i);
+	    p.value = get_param(sync_params[i]);
+	    send_message(PROTO_PARAM, &p);
 	}
-	
-	// let the audio processing loop know the current setting for peak_amp
-	peak_amp_l = current_input_amp_l;
-	peak_amp_r = current_input_amp_r;
+    }
+}
 
-	peak_amp_output_l = current_output_amp_l;
-	peak_amp_output_r = current_output_amp_r;
-	
-	// time accounting
-	ctime = machine_state.uptime_milliseconds;
-	cycle_time = moving_average(cycle_time_avg, (float) (time_us_64() - start_time),false);
-	machine_state.cycle_time_us = cycle_time;
-	
+// a peak magnitude as a meter code (lib/proto.h)
+
+static uint8_t level(int32_t amp) {
+    return proto_level_code((float) amp / MAX_AMPLITUDE);
+}
+
+// send the next PROTO_METER_REPORTS meter reports, with the state of
+// the audio channel
+void send_meter() {
+    proto_meter m;
+    meter_report r;
+    int32_t out_l = 0;
+    int32_t out_r = 0;
+    float gain = 1;
+
+    for (int i = 0; i < PROTO_METER_REPORTS; i++) {
+	meter_stream_take(&meter_reports, &r);
+	m.input_l[i] = level(r.in_l);
+	m.input_r[i] = level(r.in_r);
+	out_l = max(out_l, r.out_l);
+	out_r = max(out_r, r.out_r);
+	gain = min(gain, r.gain);
     }
+    m.output_l = level(out_l);
+    m.output_r = level(out_r);
+    m.reduction = proto_reduction_code(gain);
+    m.flags = (machine_state.muted ? PROTO_MUTED : 0) | (machine_state.gate_open ? PROTO_GATE_OPEN : 0);
+    m.version = param_version;
+    send_message(PROTO_METER, &m);
 }
 
-// send the current activity state of the audio channel
-void send_activity() {
-        
-    if (uart_is_writable(uart1)) {
-	int input_amp_l = round(map_range((float) machine_state.current_input_amp_l,0,MAX_AMPLITUDE,0,COMMON_RANGE));
-	int input_amp_r = round(map_range((float) machine_state.current_input_amp_r,0,MAX_AMPLITUDE,0,COMMON_RANGE));
-		
-	int peak_amp_l = round(map_range((float) machine_state.peak_amp_l,0,MAX_AMPLITUDE,0,COMMON_RANGE));
-	int peak_amp_r = round(map_range((float) machine_state.peak_amp_r,0,MAX_AMPLITUDE,0,COMMON_RANGE));
-
-	int output_amp_l = round(map_range((float) machine_state.output_amp_l,0,MAX_AMPLITUDE,0,COMMON_RANGE));
-	int output_amp_r = round(map_range((float) machine_state.output_amp_r,0,MAX_AMPLITUDE,0,COMMON_RANGE));
-
-	int output_peak_amp_l = round(map_range((float) machine_state.output_peak_amp_l,0,MAX_AMPLITUDE,0,COMMON_RANGE));
-	int output_peak_amp_r = round(map_range((float) machine_state.output_peak_amp_r,0,MAX_AMPLITUDE,0,COMMON_RANGE));
-	
-	int cgain = round(map_range((float) machine_state.compression_gain,0,1,0,65535));
+/* Snapshot: every parameter at the version it was last published at,
+ * then the current version.  Anything changed and not yet published
+ * goes out first, so the snapshot covers it.
+ */
 
-	
-	sprintf(send_buffer,"A%d %d %d %d %d %d %d %d %d %d %d\n",input_amp_l,input_amp_r,peak_amp_l, peak_amp_r,output_amp_l,output_amp_r,output_peak_amp_l,output_peak_amp_r,cgain, machine_state.muted, machine_state.gate_open);
-	uart_puts(uart1,send_buffer);
+void send_snapshot() {
+    proto_param p;
+    proto_sync s;
+
+    flush_params();
+    for (size_t i = 0; i < SYNC_PARAMS; i++) {
+	p.param = sync_params[i];
+	p.flags = PROTO_SNAPSHOT;
+	p.version = param_versions[i];
+	p.value = get_param(sync_params[i]);
+	send_message(PROTO_PARAM, &p);
     }
+    s.version = param_version;
+    s.count = SYNC_PARAMS;
+    send_message(PROTO_SYNC, &s);
 }
 
-void send_status() {
-    if (uart_is_writable(uart1)) {
-	sprintf(send_buffer,"C%d %d %d %f %f %f %f %f %f %f %f %f\n",machine_state.compressor_on, machine_state.attack_rate_ms, machine_state.release_rate_ms, machine_state.threshold_dB, machine_state.makeup_dB, machine_state.ratio, machine_state.output_mix, machine_state.input_trim_gain, machine_state.balance, machine_state.channel_gain, machine_state.send1_gain, machine_state.send2_gain);
-	uart_puts(uart1,send_buffer);
+
+/* Input diagnostics (lib/input_monitor.h), reported to the controller
+ * twice a second: the DC offset in parts per million of full scale,
+ * the share of blocks it was measured on, and the stuck and drift
+ * flags.  A new fault is also logged to the console.
+ */
+
+#define INPUT_STUCK_MS 100      // repeated blocks for this long are stuck data
+#define INPUT_DRIFT_DB -60.0    // offset taken as drift
+
+input_report input_status;
+
+void send_diagnostics() {
+    bool was_stuck = input_status.stuck;
+    bool was_drift = input_status.drift;
+
+    input_monitor_report(&input_mon, &input_status, max(1, (control_rate_request * INPUT_STUCK_MS) / 1000), dB_to_ratio(INPUT_DRIFT_DB));
+    if (input_status.stuck && !was_stuck) {
+	printf("WARNING: input data stuck (%lu blocks repeated)\n", input_status.repeats);
     }
+    if (input_status.drift && !was_drift) {
+	printf("WARNING: input DC offset %.1fdBFS\n", ratio_to_dB(fabsf(input_status.dc)));
+    }
+    proto_diagnostics d;
+    d.mode = input_status.mode;
+    d.dc_ppm = (int32_t) roundf(input_status.dc * 1e6f);
+    d.coverage = (uint8_t) roundf(input_status.coverage * 100);
+    d.flags = (input_status.stuck ? PROTO_INPUT_STUCK : 0) | (input_status.drift ? PROTO_INPUT_DRIFT : 0);
+    send_message(PROTO_DIAGNOSTICS, &d);
 }
 
+/* I prints the last report, Is and Ic switch the sniffer to sum (DC
+ * offset) or CRC (stuck data only) mode.
+ */
+
+void input_command(char *args) {
+    if (args[0] == 's' || args[0] == 'c') {
+	bool crc = (args[0] == 'c');
+	i2s_sniff_input(&i2s, crc);
+	input_monitor_set_mode(&input_mon, crc ? INPUT_MONITOR_CRC : INPUT_MONITOR_SUM);
+	printf("input monitor: %s mode\n", input_monitor_mode_name(crc ? INPUT_MONITOR_CRC : INPUT_MONITOR_SUM));
+	return;
+    }
+    printf("input monitor: %s mode\n", input_monitor_mode_name(input_status.mode));
+    if (input_status.mode == INPUT_MONITOR_SUM) {
+	printf("dc offset:   %+.1fppm (%.1fdBFS) over %.0f%% of blocks%s\n", input_status.dc * 1e6f,
+	       ratio_to_dB(max(fabsf(input_status.dc), 1e-9f)), input_status.coverage * 100,
+	       input_status.drift ? "  DRIFT" : "");
+    }
+    printf("repeats:     %lu blocks%s\n", input_status.repeats, input_status.stuck ? "  STUCK" : "");
+}
 
 void set_logging(bool on) {
     machine_state.log_activity = on;
@@ -887,10 +891,199 @@ void clear_entry(char *buf) {
 }
 
 void calc_output_mix (float mix) {
-    comp_output_mix = min(1.0,max(0,mix));
-    raw_output_mix = min(1.0,max(0,1 - mix));
+    channel_kernel_set_output_mix(&kernel, mix);
+}
+
+
+// compute the filter coefficients here on core 1, the audio
+// interrupt swaps them in at its next block
+
+void set_filters() {
+    if (!filters_fit && (machine_state.lowpass_ratio > 0 || machine_state.highpass_ratio > 0)) {
+	printf("the filters don't fit the budget at %luHz\n", i2s_config_default.fs);
+	machine_state.lowpass_ratio = 0;
+	machine_state.highpass_ratio = 0;
+	return;
+    }
+    uint64_t start = time_us_64();
+    while (!biquad_set_filters(&kernel.filter, machine_state.lowpass_ratio, machine_state.highpass_ratio)) {
+	// previous update not taken yet, it will be within a block
+	if (time_us_64() - start > 10000) {
+	    printf("filter update not taken by the audio loop\n");
+	    return;
+	}
+	tight_loop_contents();
+    }
+    printf("low pass: %.3f  high pass: %.3f  (%d sections)\n",
+	   machine_state.lowpass_ratio, machine_state.highpass_ratio,
+	   kernel.filter.bank[kernel.filter.request].sections);
+}
+
+/* The cycle budget of core 0 per sample, and what fits in it.  Core 0
+ * runs both the audio interrupt and the control tick (run_compression,
+ * from main), so they share the budget: the compressor and gate run
+ * once per block in the tick, and their cost is spread over the
+ * block's samples and counted along with the interrupt's.  The cost
+ * of the sends and the filters is the difference between the kernel
+ * runs with and without them.  At boot, stages that would take core 0
+ * over BUDGET_PCT of the sample period are left off - at 96kHz the
+ * budget is 1600 cycles a sample against 2750 at 48kHz.
+ */
+
+#define BENCH_ITERATIONS 2000
+#define BUDGET_ITERATIONS 200
+#define BUDGET_PCT 80
+
+static float bench_cycles(dsp_bench *b, int stage, uint32_t cpu_hz) {
+    uint32_t frames = b->stage[stage].frames ? b->stage[stage].frames : 1;
+    return (b->stage[stage].ns * cpu_hz) / (1e9 * frames);
+}
+
+static const char *fits(float cycles, float budget) {
+    return (cycles <= budget) ? "fits" : "over";
+}
+
+void print_budget(dsp_bench *b, uint32_t cpu_hz, bool apply) {
+    float budget = (float) cpu_hz / b->sample_rate;  // cycles per sample
+    float allowed = budget * BUDGET_PCT / 100;
+    float kernel_cycles = bench_cycles(b, BENCH_PROCESS_AUDIO, cpu_hz);
+    float send_cycles = bench_cycles(b, BENCH_PROCESS_SENDS, cpu_hz) - kernel_cycles;
+    float filter_cycles = bench_cycles(b, BENCH_PROCESS_FILTERED, cpu_hz) - kernel_cycles - send_cycles;
+    float section_cycles = bench_cycles(b, BENCH_BIQUAD, cpu_hz) / 4;
+    float compress_cycles = bench_cycles(b, BENCH_COMPRESS, cpu_hz);
+    float gate_cycles = bench_cycles(b, BENCH_GATE, cpu_hz);
+    float compress_share = compress_cycles / b->block_frames;
+    float gate_share = gate_cycles / b->block_frames;
+    float core_cycles = kernel_cycles + compress_share + gate_share;  // before the sends and filters
+
+    printf("cycle budget at %luHz, %.1fMHz: %.0f cycles/sample, %d%% (%.0f) for core 0\n",
+	   b->sample_rate, cpu_hz / 1e6, budget, BUDGET_PCT, allowed);
+    printf("  kernel + limiter   %6.0f/sample  %3.0f%%  %s\n", kernel_cycles, 100 * kernel_cycles / budget, fits(kernel_cycles, allowed));
+    printf("  compressor         %6.0f/block   %3.0f%%  %s\n", compress_cycles, 100 * compress_share / budget,
+	   fits(kernel_cycles + compress_share, allowed));
+    printf("  gate               %6.0f/block   %3.0f%%  %s\n", gate_cycles, 100 * gate_share / budget, fits(core_cycles, allowed));
+    printf("  sends              %6.0f/sample  %3.0f%%  %s\n", send_cycles, 100 * send_cycles / budget, fits(core_cycles + send_cycles, allowed));
+    printf("  filters (4 sect.)  %6.0f/sample  %3.0f%%  %s\n", filter_cycles, 100 * filter_cycles / budget,
+	   fits(core_cycles + send_cycles + filter_cycles, allowed));
+    if (section_cycles > 0) {
+	printf("filter sections that fit in the remaining budget: %d\n", (int) ((allowed - core_cycles - send_cycles) / section_cycles));
+    }
+    if (!apply) return;
+
+    sends_fit = (core_cycles + send_cycles <= allowed);
+    filters_fit = (core_cycles + (sends_fit ? send_cycles : 0) + filter_cycles <= allowed);
+    if (core_cycles > allowed) {
+	printf("WARNING: the kernel and control tick alone are over the budget at %luHz\n", b->sample_rate);
+    }
+    printf("sends: %s   filters: %s\n", sends_fit ? "on" : "off (over budget)", filters_fit ? "on" : "off (over budget)");
+}
+
+// at boot, before the audio starts
+
+void check_budget() {
+    static dsp_bench bench;
+    dsp_bench_run(&bench, i2s_config_default.fs, audio_block_frames, BUDGET_ITERATIONS);
+    print_budget(&bench, clock_get_hz(clk_sys), true);
 }
 
+/* Run the dsp stage benchmarks (lib/dsp_bench.c) on core 1, so the
+ * audio isn't disturbed, and report each stage per DMA block and per
+ * sample against the budget of the audio interrupt.
+ */
+
+void dsp_benchmark() {
+    static dsp_bench bench;
+    uint32_t cpu_hz = clock_get_hz(clk_sys);
+
+    dsp_bench_run(&bench, i2s_config_default.fs, audio_block_frames, BENCH_ITERATIONS);
+    dsp_bench_print(&bench, cpu_hz);
+    printf("\n");
+    print_budget(&bench, cpu_hz, false);
+}
+
+/* Change the DMA block size and ring depth.  The control rate follows
+ * the block rate, so the envelope coefficients are recomputed for it,
+ * and the interrupt profile starts over against the new period.
+ */
+
+void print_blocks() {
+    uint32_t latency = i2s_latency_frames(audio_block_frames, audio_ring_blocks);
+    printf("block: %d frames x %d   %lu interrupts/s   latency: %lu samples (%.2fms)\n",
+	   audio_block_frames, audio_ring_blocks, control_rate_request,
+	   latency, (latency * 1000.0) / i2s_config_default.fs);
+}
+
+void set_blocks(char *args) {
+    char *end;
+    long frames = strtol(args, &end, 10);
+    long ring = strtol(end, 0, 10);
+    if (frames == 0) {
+	print_blocks();
+	return;
+    }
+    if (ring == 0) ring = audio_ring_blocks;
+    if (!i2s_blocks_valid(frames, ring) || !i2s_set_blocks(&i2s, frames, ring)) {
+	printf("invalid block size: %d to %d frames, ring of 2, 4 or 8 blocks, at most %d frames in all\n",
+	       I2S_MIN_BLOCK_FRAMES, I2S_MAX_BLOCK_FRAMES, I2S_MAX_RING_FRAMES);
+	return;
+    }
+    audio_block_frames = frames;
+    audio_ring_blocks = ring;
+    control_rate_request = block_rate_hz();  // taken by the next control tick
+    irq_profile_set_period(&irq_prof, audio_block_frames, i2s_config_default.fs);
+    print_blocks();
+}
+
+/* Audio interrupt timing against the block period, and xruns.
+ * P0 starts the counts over.
+ */
+
+void profile_command(char *args) {
+    if (args[0] == '0') {
+	irq_profile_reset(&irq_prof);
+	printf("interrupt profile reset\n");
+	return;
+    }
+    print_blocks();
+    irq_profile_print(&irq_prof);
+}
+
+/* Bus contention: the other core reads each SRAM region in turn while
+ * the audio runs, and the interrupt's average and worst case time are
+ * set against the baseline with core 1 asleep.  With the audio path's
+ * placement (lib/sram_banks.h) only loads on the audio path's own
+ * regions should slow it down.  U<ms> sets the time per region.
+ */
+
+#define CONTENTION_MS 500
+
+void bus_contention(char *args) {
+    uint32_t ms = clamp(atoi(args), 0, 10000);
+    float us = 1000000.0f / irq_prof.cycles_hz;
+    float base_avg = 0;
+    float base_max = 0;
+
+    if (ms == 0) ms = CONTENTION_MS;
+    printf("interrupt time with core 1 reading each region for %lums:\n", ms);
+    printf("  load        blocks    avg us  change    max us  change\n");
+    for (int load = 0; load < SRAM_LOADS; load++) {
+	irq_profile_reset(&irq_prof);
+	sram_bus_load(load, ms);
+	uint32_t count = irq_prof.count;
+	float avg = count ? (float) irq_prof.total / count : 0;
+	float max = irq_prof.max;
+	if (load == SRAM_LOAD_NONE) {
+	    base_avg = avg;
+	    base_max = max;
+	}
+	printf("  %-10s %7lu  %8.2f  %+5.1f%%  %8.2f  %+5.1f%%\n",
+	       sram_load_name(load), count, avg * us,
+	       base_avg > 0 ? 100 * (avg - base_avg) / base_avg : 0,
+	       max * us,
+	       base_max > 0 ? 100 * (max - base_max) / base_max : 0);
+    }
+    irq_profile_reset(&irq_prof);
+}
 
 uint16_t calc_gain(float g) {
     uint16_t out = clamp((uint16_t) (g*4096.0),0,4095);
@@ -957,19 +1150,32 @@ void heartbeat() {
 
 // transpond with the controller and the console
 
+void handle_message(proto_message *msg);
+
 char handle_command_io() {
-    // check for controller command...
+    // check for controller messages...
 
-    if (uart_is_readable(uart1)) {
-	return uart_getc(uart1);
+    int b;
+    uart_dma_poll(&controller_link);
+    if (uart_dma_idle(&controller_link)) {
+	proto_rx_idle(&controller_rx);
+    }
+    while ((b = uart_dma_getc(&controller_link)) >= 0) {
+	if (proto_rx_byte(&controller_rx, b)) {
+	    handle_message(&controller_rx.msg);
+	}
     }
     heartbeat();
     machine_state.channel_gain = moving_average(gain_avg,machine_state.channel_gain_raw,false);
     set_channel_gain();
-    static uint64_t last_check = 0;
-    if (machine_state.uptime_milliseconds>(last_check+49)) {	
-	send_activity();	
-	last_check = machine_state.uptime_milliseconds;
+    flush_params();
+    while (meter_stream_waiting(&meter_reports) >= PROTO_METER_REPORTS) {
+	send_meter();
+    }
+    static uint64_t last_diagnostics = 0;
+    if (machine_state.uptime_milliseconds>(last_diagnostics+499)) {
+	send_diagnostics();
+	last_diagnostics = machine_state.uptime_milliseconds;
     }
     // check stdio...
     int rval = 0;    
@@ -1047,6 +1253,7 @@ void show_help() {
     printf("  t - set threshold in dB\n");
     printf("  m - set make up ratio\n");
     printf("  R - set ratio [1 to 30] dB compression for every 1dB of signal\n");
+    printf("  k - set knee width in dB [0 - hard knee to 24]\n");
     printf("  O - output mix [0 - no compressed signal to 1 - only compressed]\n");
     printf("  c - set compression on/off\n");
     printf("noise gate:\n");
@@ -1058,12 +1265,21 @@ void show_help() {
     printf("channel:\n");
     printf("  b - set channel stereo balance [-1.0 to 1.0]\n");
     printf("  g - set channel gain (applied post compression) [0.0 to 2.0]\n");
-    printf("  1 - set send 1 gain (applied post compression) [0.0 to 1.0]\n");
-    printf("  2 - set send 2 gain (applied post compression) [0.0 to 1.0]\n");
+    printf("  1 - set send 1 gain (applied post compression, analog and digital) [0.0 to 1.0]\n");
+    printf("  2 - set send 2 gain (applied post compression, analog and digital) [0.0 to 1.0]\n");
     printf("  T - set channel input gain (trim)\n");
     printf("  M - set channel muted [0 - not muted, 1 - muted]\n\n");
-    printf("  L - set low pass ratio [0 - no filter, 1 - fully filtered\n");
-    printf("  h - set high pass ratio [0 - no filter, 1 - fully filtered\n");
+    printf("  L - set low pass ratio [0 - no filter, 1 - fully filtered]\n");
+    printf("  h - set high pass ratio [0 - no filter, 1 - fully filtered]\n");
+    printf("  F - benchmark the dsp stages against the interrupt budget\n");
+    printf("limiter:\n");
+    printf("  x - set lookahead in milliseconds [0.5 to 2.0]\n");
+    printf("  X - set ceiling in dB [-12 to 0]\n");
+    printf("audio path:\n");
+    printf("  z - set DMA block frames and ring depth [4 to 64] [2, 4, 8], e.g. z16 4\n");
+    printf("  P - audio interrupt timing and xruns   P0 - reset them\n");
+    printf("  U - interrupt time under bus load from core 1 on each SRAM region [ms per region]\n");
+    printf("  I - input DC offset and stuck data   Is - sum (DC) mode   Ic - CRC mode\n");
     printf("  l - log current state to the console on/off\n");
     printf("  S - set minimum permissible cycle steps for slew\n");    
     printf("  C - clear the screen.\n");
@@ -1087,28 +1303,47 @@ void output_settings() {
     printf("\nCompressor\n");
     printf("attack:      %3dms  release:    %3dms\n",machine_state.attack_rate_ms, machine_state.release_rate_ms);
     printf("threshold:   %fdB   makeup:     %.3fdB\n",machine_state.threshold_dB, machine_state.makeup_dB);
-    printf("ratio:       %2.3f:1\n",machine_state.ratio);
-    printf("output mix:  %.0f compressed\n",roundf(comp_output_mix*100));
+    printf("ratio:       %2.3f:1   knee:       %.1fdB\n",machine_state.ratio, machine_state.knee_dB);
+    printf("output mix:  %.0f compressed\n",roundf(kernel.comp_mix*100));
+    printf("\nFilters\n");
+    printf("low pass:    %.3f %s", machine_state.lowpass_ratio, (machine_state.lowpass_ratio > 0) ? "" : "off\n");
+    if (machine_state.lowpass_ratio > 0) printf("(%.0fHz)\n", biquad_lowpass_hz(machine_state.lowpass_ratio));
+    printf("high pass:   %.3f %s", machine_state.highpass_ratio, (machine_state.highpass_ratio > 0) ? "" : "off\n");
+    if (machine_state.highpass_ratio > 0) printf("(%.0fHz)\n", biquad_highpass_hz(machine_state.highpass_ratio));
+    printf("\nLimiter\n");
+    printf("lookahead:   %.2fms   ceiling:    %.2fdB\n",limiter_lookahead_ms(&kernel.limiter), machine_state.limiter_ceiling_dB);
+    printf("clip events: %lu\n",kernel.limiter.clip_events);
+    printf("\nAudio Path\n");
+    print_blocks();
+    printf("\nController Link\n");
+    printf("baud:        %u   frames: %lu   errors: %lu\n",controller_link.baud, controller_rx.frames, controller_rx.errors);
+    printf("rx lost:     %lu bytes   tx dropped: %lu frames\n",controller_link.rx_lost, controller_link.tx_dropped);
+    printf("meters:      %lu reports   skipped: %lu\n",meter_reports.head, meter_reports.skipped);
 
     printf("\n");
 }
 
-void handle_command(char cmd, char* args) {
+/* the settings that take one number, from the console (handle_command)
+ * or the controller (PROTO_SET); param is the command letter.  False if
+ * it isn't one.
+ */
+
+bool set_param(char param, float value) {
     float f; 
     int32_t i;
-    switch(cmd) {
+    switch(param) {
     case 'a':
-	i = clamp(atoi(args),0,500);
+	i = clamp((int32_t) value,0,500);
 	machine_state.attack_rate_ms = i;
 	printf("attack rate = %dms\n",machine_state.attack_rate_ms);
 	break;
     case 'r':
-	i = clamp(atoi(args),0,500);
+	i = clamp((int32_t) value,0,500);
 	machine_state.release_rate_ms = i;
 	printf("release rate = %dms\n",machine_state.release_rate_ms);
 	break;
     case 't':
-	f = atof(args);
+	f = value;
 	if (f < 0) {
 	    f = f * -1;
 	}
@@ -1118,7 +1353,7 @@ void handle_command(char cmd, char* args) {
 	printf("threshold sample = %ld\n",machine_state.threshold_sample);
 	break;
     case 'c':
-	i = clamp(atoi(args),0,1);
+	i = clamp((int32_t) value,0,1);
 	machine_state.compressor_on = (uint8_t) i;
 	if (machine_state.compressor_on) {
 	    printf("compressor is now on.\n");
@@ -1127,79 +1362,53 @@ void handle_command(char cmd, char* args) {
 	}
 	break;
     case 'b':
-	machine_state.balance = max(-1,min(1,atof(args)));
+	machine_state.balance = max(-1,min(1,value));
 	printf("balance is: %2.4f\n",machine_state.balance);
-	balance_l_gain = 1.0 + machine_state.balance;
-	balance_r_gain = 1.0 - machine_state.balance;
+	channel_kernel_set_balance(&kernel, machine_state.balance);
 	break;
     case 'R':
-	f = max(min(30, atof(args)),0);
+	f = max(min(30, value),1);
 	machine_state.ratio = f;
 	printf("ratio = %2.2f:1\n",machine_state.ratio);
 	break;
-    case 'l':
-	if (machine_state.log_activity) {
-	    machine_state.log_activity = false;
-	    printf("logging is off\n");
-	} else {
-	    machine_state.log_activity = true;
-	    printf("logging is on\n");
-	}
+    case 'k':
+	f = clamp(value,0,24);
+	machine_state.knee_dB = f;
+	printf("knee = %.1fdB\n",machine_state.knee_dB);
 	break;
     case 'S':
-	i = clamp(atoi(args),1,1000);
+	i = clamp((int32_t) value,1,1000);
 	machine_state.min_steps = i;
 	printf("minimum transition steps = %ld\n",machine_state.min_steps);
 	break;
     case 'm':
-	f = clamp(atof(args),0,24);
+	f = clamp(value,0,24);
 	machine_state.makeup_dB = f;
 	machine_state.makeup = dB_to_ratio(machine_state.makeup_dB);
 	printf("makeup_dB = %.3f  ratio=%.3f\n",machine_state.makeup_dB,machine_state.makeup);
 	break;
-    case 'C':
-	printf("\033[2J");
-	break;
     case 'g':
-	f = clamp(atof(args),0.0,1.0);
+	f = clamp(value,0.0,1.0);
 	machine_state.channel_gain_raw = f;
 	printf("g=%1.3f\n",machine_state.channel_gain_raw);
 	set_channel_gain();
 	break;
     case '1':
-	f = clamp(atof(args),0.0,1.0);
+	f = clamp(value,0.0,1.0);
 	machine_state.send1_gain = f;
+	channel_kernel_set_sends(&kernel, machine_state.send1_gain, machine_state.send2_gain);
 	set_channel_gain();
 	printf("send 1 gain = %1.3f\n",machine_state.send1_gain);
 	break;
     case '2':
-	f = clamp(atof(args),0.0,1.0);
+	f = clamp(value,0.0,1.0);
 	machine_state.send2_gain = f;
+	channel_kernel_set_sends(&kernel, machine_state.send1_gain, machine_state.send2_gain);
 	set_channel_gain();
 	printf("send 2 gain = %1.3f\n",machine_state.send2_gain);
 	break;
-    case '3':
-	i = clamp(atoi(args),0,100000);
-	float orig = machine_state.channel_gain;
-	machine_state.channel_gain = 0;
-	set_channel_gain();
-	float step_diff = (float) 1.0/(float)i;
-	for(int step = 0; step < i; step++) {
-	    machine_state.channel_gain+=step_diff;
-	    set_channel_gain();
-	}
-	printf("...pausing..\n");
-	sleep_us(100000);
-	printf("decrementing...\n");
-	for(int step = 0; step < i; step++) {
-	    machine_state.channel_gain-=step_diff;
-	    set_channel_gain();
-	}
-	machine_state.channel_gain = orig;
-	set_channel_gain();
-	break;
     case 'G':
-	i = clamp(atoi(args),0,1);
+	i = clamp((int32_t) value,0,1);
 	machine_state.gate_active = (uint8_t) i;
 	if (machine_state.gate_active) {
 	    printf("noise gate is now on.\n");
@@ -1208,18 +1417,17 @@ void handle_command(char cmd, char* args) {
 	}
 	break;
     case 'A':
-	i = clamp(atoi(args),0,3000);
+	i = clamp((int32_t) value,0,3000);
 	machine_state.gate_attack_ms = i;
 	printf("noise gate attack time = %dms\n",machine_state.gate_attack_ms);
 	break;
     case 'E':
-	i = clamp(atoi(args),0,3000);
+	i = clamp((int32_t) value,0,3000);
 	machine_state.gate_release_ms = i;
 	printf("noise gate release time = %dms\n",machine_state.gate_release_ms);
 	break;
     case 'N':
-
-	f = clamp(atof(args),-100,100);
+	f = clamp(value,-100,100);
 	if (f < 0) {
 	    f = f * -1;
 	}
@@ -1229,23 +1437,19 @@ void handle_command(char cmd, char* args) {
 	printf("noise gate threshold arg = %2.2f  dB = %2.2f  sample = %lu\n",f, machine_state.gate_threshold_dB, machine_state.gate_threshold_sample);
 	break;
     case 'H':
-	i = clamp(atoi(args),0,3000);
+	i = clamp((int32_t) value,0,3000);
 	machine_state.gate_hold_ms = i;
 	printf("noise gate hold time = %dms\n",machine_state.gate_hold_ms);
 	break;
-    case 's':
-	send_status();
-	output_settings();	
-	break;
     case 'O':
-	f = clamp(atof(args),0.0,1.0);
+	f = clamp(value,0.0,1.0);
 	machine_state.output_mix = f;
 	// do the precomputation here for the processor loop
 	calc_output_mix(f);
-	printf("compressed mix: %2.3f   raw mix: %2.3f\n", comp_output_mix, raw_output_mix);
+	printf("compressed mix: %2.3f   raw mix: %2.3f\n", kernel.comp_mix, kernel.raw_mix);
 	break;
     case 'M':
-	i = clamp(atoi(args),0,1);
+	i = clamp((int32_t) value,0,1);
 	machine_state.muted = i;
 	if (i == 0) {
 	    gpio_put(MUTE_GPIO,0);
@@ -1253,9 +1457,117 @@ void handle_command(char cmd, char* args) {
 	    gpio_put(MUTE_GPIO,1);
 	}
 	break;
+    case 'x':
+	f = clamp(value,LIMITER_MIN_MS,LIMITER_MAX_MS);
+	machine_state.limiter_lookahead_ms = f;
+	limiter_set_lookahead(&kernel.limiter, f);
+	printf("limiter lookahead = %.2fms\n",limiter_lookahead_ms(&kernel.limiter));
+	break;
+    case 'X':
+	f = value;
+	if (f > 0) {
+	    f = f * -1;
+	}
+	f = max(-12,f);
+	machine_state.limiter_ceiling_dB = f;
+	limiter_set_ceiling(&kernel.limiter, dB_to_sample(f));
+	printf("limiter ceiling = %.2fdB\n",machine_state.limiter_ceiling_dB);
+	break;
     case 'T':
-	f = clamp(atof(args),0.1,3);
+	f = clamp(value,0.1,3);
 	machine_state.input_trim_gain = f;
+	channel_kernel_set_trim(&kernel, f);
+	break;
+    case 'L':
+	f = clamp(value,0.0,1.0);
+	machine_state.lowpass_ratio = f;
+	set_filters();
+	break;
+    case 'h':
+	f = clamp(value,0.0,1.0);
+	machine_state.highpass_ratio = f;
+	set_filters();
+	break;
+    default:
+	return false;
+    }
+    int n = param_index(param);
+    if (n >= 0) {
+	param_changed[n] = true;
+    }
+    return true;
+}
+
+// a parameter's current value, as set_param() takes it
+
+float get_param(char param) {
+    switch(param) {
+    case 'a': return machine_state.attack_rate_ms;
+    case 'r': return machine_state.release_rate_ms;
+    case 't': return machine_state.threshold_dB;
+    case 'c': return machine_state.compressor_on;
+    case 'b': return machine_state.balance;
+    case 'R': return machine_state.ratio;
+    case 'k': return machine_state.knee_dB;
+    case 'S': return machine_state.min_steps;
+    case 'm': return machine_state.makeup_dB;
+    case 'g': return machine_state.channel_gain_raw;
+    case '1': return machine_state.send1_gain;
+    case '2': return machine_state.send2_gain;
+    case 'G': return machine_state.gate_active;
+    case 'A': return machine_state.gate_attack_ms;
+    case 'E': return machine_state.gate_release_ms;
+    case 'H': return machine_state.gate_hold_ms;
+    case 'N': return -machine_state.gate_threshold_dB;    // held positive, set either way
+    case 'O': return machine_state.output_mix;
+    case 'M': return machine_state.muted;
+    case 'x': return machine_state.limiter_lookahead_ms;
+    case 'X': return machine_state.limiter_ceiling_dB;
+    case 'T': return machine_state.input_trim_gain;
+    case 'L': return machine_state.lowpass_ratio;
+    case 'h': return machine_state.highpass_ratio;
+    }
+    return 0;
+}
+
+void handle_command(char cmd, char* args) {
+    int32_t i;
+    switch(cmd) {
+    case 'l':
+	if (machine_state.log_activity) {
+	    machine_state.log_activity = false;
+	    printf("logging is off\n");
+	} else {
+	    machine_state.log_activity = true;
+	    printf("logging is on\n");
+	}
+	break;
+    case 'C':
+	printf("\033[2J");
+	break;
+    case '3':
+	i = clamp(atoi(args),0,100000);
+	float orig = machine_state.channel_gain;
+	machine_state.channel_gain = 0;
+	set_channel_gain();
+	float step_diff = (float) 1.0/(float)i;
+	for(int step = 0; step < i; step++) {
+	    machine_state.channel_gain+=step_diff;
+	    set_channel_gain();
+	}
+	printf("...pausing..\n");
+	sleep_us(100000);
+	printf("decrementing...\n");
+	for(int step = 0; step < i; step++) {
+	    machine_state.channel_gain-=step_diff;
+	    set_channel_gain();
+	}
+	machine_state.channel_gain = orig;
+	set_channel_gain();
+	break;
+    case 's':
+	send_snapshot();
+	output_settings();	
 	break;
     case 'W':
 	i = clamp(atoi(args),0,255);
@@ -1264,6 +1576,21 @@ void handle_command(char cmd, char* args) {
     case '#':	
 	send_bus_command(args);
 	break;
+    case 'F':
+	dsp_benchmark();
+	break;
+    case 'z':
+	set_blocks(args);
+	break;
+    case 'P':
+	profile_command(args);
+	break;
+    case 'U':
+	bus_contention(args);
+	break;
+    case 'I':
+	input_command(args);
+	break;
     case 'B':
 	i = atoi(args);
 	printf("0x%lx   ",i);
@@ -1274,8 +1601,31 @@ void handle_command(char cmd, char* args) {
 	show_help();
 	break;
     default:	
-	uart_puts(uart1,"Eunknown command\n");
-	printf("unknown command: %c\nType ? for command menu.\n",cmd);
+	if (!set_param(cmd, atof(args))) {
+	    printf("unknown command: %c\nType ? for command menu.\n",cmd);
+	}
+    }
+}
+
+// a message from the controller
+
+void handle_message(proto_message *msg) {
+    proto_ack ack;
+    int n;
+
+    switch (msg->type) {
+    case PROTO_SET:
+	n = param_index(msg->u.set.param);
+	ack.param = msg->u.set.param;
+	ack.seq = msg->u.set.seq;
+	ack.ok = (n >= 0) && isfinite(msg->u.set.value) && set_param(msg->u.set.param, msg->u.set.value);
+	ack.version = ack.ok ? publish_param(n) : param_version;
+	ack.value = ack.ok ? get_param(msg->u.set.param) : 0;
+	send_message(PROTO_ACK, &ack);
+	break;
+    case PROTO_SYNC_REQUEST:
+	send_snapshot();
+	break;
     }
 }
 
@@ -1378,7 +1728,9 @@ void core1_init() {
 	
 	gpio_set_function(TX_TO_CONTROLLER, UART_FUNCSEL_NUM(uart1, TX_TO_CONTROLLER));
 	gpio_set_function(RX_FROM_CONTROLLER, UART_FUNCSEL_NUM(uart1, RX_FROM_CONTROLLER));
-	uart_init(uart1,115200);
+	uart_dma_init(&controller_link, uart1, PROTO_BAUD);
+	proto_rx_init(&controller_rx);
+	send_snapshot();          // in case the controller kept running
 	
 	setup_serial_to_pcm3060();
 
@@ -1408,10 +1760,36 @@ void core1_init() {
 }
 
 
+// the signal chain and its control state, with no hardware involved
+
+void dsp_init() {
+    // default threshold is -12dB
+    compute_threshold_for_dB(-12);
+
+    channel_kernel_init(&kernel, i2s_config_default.fs);
+    limiter_set_lookahead(&kernel.limiter, machine_state.limiter_lookahead_ms);
+    limiter_set_ceiling(&kernel.limiter, dB_to_sample(machine_state.limiter_ceiling_dB));
+    channel_kernel_set_sends(&kernel, machine_state.send1_gain, machine_state.send2_gain);
+    control_rate_hz = block_rate_hz();
+    control_rate_request = control_rate_hz;
+    dynamics_init(&dyn, control_rate_hz);
+    dynamics_set_curve(&dyn, machine_state.threshold_dB, machine_state.ratio, machine_state.knee_dB);
+    dynamics_set_times(&dyn, machine_state.attack_rate_ms, machine_state.release_rate_ms, machine_state.min_steps);
+    dynamics_set_gate(&dyn, machine_state.gate_threshold_sample, machine_state.gate_attack_ms, machine_state.gate_hold_ms, machine_state.gate_release_ms);
+    control_busy_avg = initialize_average(100);
+    // the cycle timer and the interpolators are the audio core's own
+    dsp_cycle_timer_init();
+#ifdef DSP_INTERP
+    channel_kernel_claim_interp();
+#endif
+    irq_profile_init(&irq_prof, dsp_cycles_hz(), audio_block_frames, i2s_config_default.fs);
+    input_monitor_init(&input_mon, INPUT_MONITOR_SUM);
+    meter_stream_init(&meter_reports, PROTO_METER_PERIOD_US);
+}
+
 int setup() {
 
     text_buffer = (char *) calloc(1024,sizeof(char));
-    send_buffer = (char *) calloc(ENTRY_SIZE,sizeof(char));
     
     
     // I2C Initialisation. Using it at 100Khz.
@@ -1446,7 +1824,7 @@ int setup() {
     // Note: it is usually best to configure the codec here, and then enable it
     //       after starting the I2S clocks, below.
     // default threshold is -12dB
-    compute_threshold_for_dB(-12);
+    dsp_init();
     
     if (MULTICORE) {
 	multicore_launch_core1(core1_init);
@@ -1459,20 +1837,27 @@ int setup() {
 	}
 	multicore_fifo_push_blocking(CORE1_INIT_FLAG);
     }
+    check_budget();
     printf("initializing i2s...\n");
+    // sends on pio1, started along with the main channel
+    if (sends_fit) {
+	i2s_program_start_sends(pio1, &i2s_config_default, &i2s);
+    }
     // main channel and clocks on pio0
     i2s_program_start_synched(pio0, &i2s_config_default, dma_i2s_in_handler, &i2s);
-    // sends on pio1
-    //    i2s_program_start_sends(pio1, &i2s_config_default, dma_i2s_send_handler, &i2s);
+    i2s_sniff_input(&i2s, false);
     return 0;
 }
 
 int main() {
-    // Set a 132.000 MHz system clock to more evenly divide the audio frequencies
-    set_sys_clock_khz(132000, true);
+    // the audio path's SRAM banks aren't loaded with the binary
+    sram_banks_clear();
+    // Set the system clock that divides exactly to the audio clocks
+    // (132.000 MHz for 48kHz, 153.600 MHz for 96kHz, see i2s.h)
+    set_sys_clock_khz(AUDIO_SYS_CLOCK_KHZ, true);
     stdio_init_all();
     printf("\n\nAudio Channel DSP\n");
-    printf("System Clock: %lu\n", clock_get_hz(clk_sys));
+    printf("System Clock: %lu  Sample Rate: %lu\n", clock_get_hz(clk_sys), i2s_config_default.fs);
 
     // set up the environment...
     setup();
@@ -0,0 +1,169 @@
+/* Chain Bench
+   The compile-time channel chain (lib/channel_chain.hpp) against the
+   hand-written float kernel, channel_process_float().
+
+   Each case sets up a kernel, runs it over the same fixed-seed input
+   through both, from the same starting state, and with the net gain
+   moving every block so the ramp is exercised.  Only the processing
+   is timed.  The outputs, sends and meters of every block are
+   checksummed, and "match" says whether the chain's checksum is the
+   kernel's.
+
+   The last case has no kernel equivalent: the full chain with the
+   filters and limiter compiled out, to show what a dropped stage
+   costs (nothing).
+
+   usage: chain_bench [-n blocks] [-f block_frames]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+extern "C" {
+#include "i2s.h"
+}
+#include "channel_chain.hpp"
+
+#define SIGNAL_FRAMES 4096
+#define BENCH_SEED 0x2545f491
+
+typedef void (*process_fn)(channel_kernel *k, const int32_t *input, int32_t *output, int32_t *sends, size_t num_frames);
+
+static int32_t signal[SIGNAL_FRAMES * 2];
+static int32_t output[I2S_MAX_BLOCK_FRAMES * 2];
+static int32_t send_block[I2S_MAX_BLOCK_FRAMES * 2];
+static channel_kernel kernel;
+
+enum {
+    CASE_GAIN,                // trim, net gain and balance
+    CASE_SENDS,
+    CASE_MIXED,               // the output mix and the sends
+    CASE_FILTERED,            // all of it, high and low pass on
+    CASE_NO_LIMITER,
+    CASES
+};
+
+static const char *case_names[CASES] = {
+    "gain",
+    "gain+sends",
+    "mix+sends",
+    "mix+sends+filters",
+    "no filters/limiter"
+};
+
+// noise stepping between about -6dBFS and -40dBFS, as dsp_bench
+
+static void make_signal() {
+    uint32_t x = BENCH_SEED;
+    for (int i = 0; i < SIGNAL_FRAMES * 2; i++) {
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	int shift = ((i / 2048) & 1) ? 7 : 1;
+	signal[i] = ((int32_t) x >> shift) & ~0xff;
+    }
+}
+
+static void kernel_setup(int c) {
+    channel_kernel_init(&kernel, AUDIO_SAMPLE_RATE);
+    channel_kernel_set_trim(&kernel, 1.2f);
+    channel_kernel_set_balance(&kernel, -0.25f);
+    channel_kernel_set_sends(&kernel, 0.5f, 0.8f);
+    if (c >= CASE_MIXED) channel_kernel_set_output_mix(&kernel, 0.7f);
+    if (c >= CASE_FILTERED) biquad_set_filters(&kernel.filter, 0.5, 0.5);
+}
+
+static void process_no_limiter(channel_kernel *k, const int32_t *input, int32_t *output, int32_t *sends, size_t num_frames) {
+    channel_chain<
+	chain_trim,
+	chain_net_gain,
+	chain_output_mix,
+	chain_sends,
+	chain_balance,
+	chain_stage_if<false, chain_filters>,
+	chain_stage_if<false, chain_limiter>,
+	chain_meter>::process(k, input, output, sends, num_frames);
+}
+
+// FNV-1a over a block's words
+
+static uint64_t checksum(uint64_t h, const int32_t *words, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+	h = (h ^ (uint32_t) words[i]) * 0x100000001b3ull;
+    }
+    return h;
+}
+
+typedef struct run_result {
+    double ns;                // per block
+    uint64_t sum;
+} run_result;
+
+static run_result run(int c, process_fn process, uint32_t blocks, uint32_t frames) {
+    run_result r = { 0, 0xcbf29ce484222325ull };
+    int32_t *sends = (c == CASE_GAIN) ? 0 : send_block;
+    uint64_t elapsed = 0;
+    meter_snapshot meter;
+
+    kernel_setup(c);
+    for (uint32_t i = 0; i < blocks; i++) {
+	const int32_t *input = &signal[((i * frames) % (SIGNAL_FRAMES - frames)) * 2];
+	channel_kernel_set_net_gain(&kernel, 0.25f + (i % 7) * 0.125f);
+	uint64_t start = dsp_time_ns();
+	process(&kernel, input, output, sends, frames);
+	elapsed += dsp_time_ns() - start;
+
+	r.sum = checksum(r.sum, output, frames * 2);
+	if (sends) r.sum = checksum(r.sum, sends, frames * 2);
+	if (meter_read(&kernel.meter, &meter)) {
+	    int32_t peaks[4] = { meter.in_l, meter.in_r, meter.out_l, meter.out_r };
+	    r.sum = checksum(r.sum, peaks, 4);
+	}
+    }
+    r.ns = (double) elapsed / blocks;
+    return r;
+}
+
+int main(int argc, char **argv) {
+    uint32_t blocks = 200000;
+    uint32_t frames = AUDIO_BUFFER_FRAMES;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:f:")) != -1) {
+	switch (opt) {
+	case 'n':
+	    blocks = atoi(optarg);
+	    break;
+	case 'f':
+	    frames = atoi(optarg);
+	    break;
+	default:
+	    fprintf(stderr, "usage: chain_bench [-n blocks] [-f block_frames]\n");
+	    return 2;
+	}
+    }
+    if (blocks == 0 || frames < I2S_MIN_BLOCK_FRAMES || frames > I2S_MAX_BLOCK_FRAMES) {
+	fprintf(stderr, "chain_bench: block frames must be %d - %d\n", I2S_MIN_BLOCK_FRAMES, I2S_MAX_BLOCK_FRAMES);
+	return 2;
+    }
+
+    make_signal();
+    printf("chain bench: %luHz, %lu frame blocks, %lu blocks per run\n",
+	   (unsigned long) AUDIO_SAMPLE_RATE, (unsigned long) frames, (unsigned long) blocks);
+    printf("%-20s %12s %12s %8s %6s\n", "case", "kernel ns/s", "chain ns/s", "speedup", "match");
+
+    for (int c = 0; c < CASES; c++) {
+	run_result chain;
+	if (c == CASE_NO_LIMITER) {
+	    chain = run(c, process_no_limiter, blocks, frames);
+	    printf("%-20s %12s %12.2f %8s %6s\n", case_names[c], "-", chain.ns / frames, "", "");
+	    continue;
+	}
+	run_result scalar = run(c, channel_process_float, blocks, frames);
+	chain = run(c, channel_process_chain, blocks, frames);
+	printf("%-20s %12.2f %12.2f %8.2f %6s\n", case_names[c], scalar.ns / frames, chain.ns / frames,
+	       scalar.ns / chain.ns, (chain.sum == scalar.sum) ? "yes" : "NO");
+    }
+    return 0;
+}
@@ -0,0 +1,261 @@
+/* Channel Render
+   Runs the channel DSP over a WAV file offline, as fast as the host
+   allows.  audio_processor.c is built against the HAL shim in hal/,
+   so the audio interrupt's process_audio(), the dsp loop's control
+   tick and handle_command() are the firmware's own code.  Each DMA
+   block of the file goes through the kernel followed by one control
+   tick, with the simulated clock advanced by the block's duration.
+
+   Settings come from -c options (applied before the first block) and
+   from a script file of timed commands, one per line:
+
+     # seconds  command, using the console letters (see ? on the device)
+     0.0   t-24
+     0.0   R4
+     2.5   M1
+
+   Commands due at the same time are applied on consecutive blocks.
+   z changes the block size (and so the control rate) from the next
+   block; the ring depth only changes the reported latency.
+   g sets the analog VCA gain and has no effect here.
+
+   The trace is a CSV of the compressor and gate every interval ms.
+   -S writes the digital sends as they go out on the send line, send 1
+   left and send 2 right.
+
+   usage: channel_render [-s script] [-c command]... [-t trace.csv]
+                         [-i interval_ms] [-b output_bits] [-S sends.wav]
+                         in.wav out.wav
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "pico_hal.h"
+#include "i2s.h"
+#include "channel_kernel.h"
+#include "dynamics.h"
+#include "fastmath.h"
+#include "wav.h"
+
+#define MAX_COMMANDS 1024
+#define MAX_COMMAND_LEN 32
+
+// from audio_processor.c
+extern channel_kernel kernel;
+extern dynamics dyn;
+extern uint16_t audio_block_frames;
+extern uint8_t audio_ring_blocks;
+void dsp_init();
+void process_audio(const int32_t* input, int32_t* output, int32_t* sends, size_t num_frames);
+void control_tick(meter_snapshot *meter);
+void handle_command(char cmd, char* args);
+
+typedef struct timed_command {
+    uint64_t time_us;
+    char text[MAX_COMMAND_LEN];
+} timed_command;
+
+static timed_command commands[MAX_COMMANDS];
+static int num_commands = 0;
+
+static double now_s() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void usage() {
+    fprintf(stderr, "usage: channel_render [-s script] [-c command]... [-t trace.csv]\n");
+    fprintf(stderr, "                      [-i interval_ms] [-b output_bits] [-S sends.wav]\n");
+    fprintf(stderr, "                      in.wav out.wav\n");
+    exit(2);
+}
+
+// keep the commands in time order, file order within the same time
+
+static void add_command(double seconds, const char *text) {
+    if (num_commands == MAX_COMMANDS) {
+	fprintf(stderr, "too many commands, max %d\n", MAX_COMMANDS);
+	exit(1);
+    }
+    uint64_t t = (uint64_t) llround(seconds * 1e6);
+    int i = num_commands++;
+    while (i > 0 && commands[i-1].time_us > t) {
+	commands[i] = commands[i-1];
+	i--;
+    }
+    commands[i].time_us = t;
+    snprintf(commands[i].text, MAX_COMMAND_LEN, "%s", text);
+}
+
+static void read_script(const char *path) {
+    char line[256];
+    int line_num = 0;
+    FILE *f = fopen(path, "r");
+    if (!f) {
+	fprintf(stderr, "can't open %s\n", path);
+	exit(1);
+    }
+    while (fgets(line, sizeof(line), f)) {
+	double seconds;
+	char text[MAX_COMMAND_LEN];
+	line_num++;
+	char *p = line + strspn(line, " \t");
+	if (*p == '#' || *p == '\n' || *p == '\r' || *p == 0) continue;
+	if (sscanf(p, "%lf %31s", &seconds, text) != 2 || seconds < 0) {
+	    fprintf(stderr, "%s:%d: expected <seconds> <command>\n", path, line_num);
+	    exit(1);
+	}
+	add_command(seconds, text);
+    }
+    fclose(f);
+}
+
+static void apply_command(const char *text) {
+    char args[MAX_COMMAND_LEN];
+    snprintf(args, sizeof(args), "%s", text + 1);
+    printf("-> [%c] [%s]\n", text[0], args);
+    handle_command(text[0], args);
+}
+
+int main(int argc, char **argv) {
+    const char *trace_path = 0;
+    const char *sends_path = 0;
+    double interval_ms = 1.0;
+    int out_bits = 24;
+    int opt;
+    char err[128];
+
+    while ((opt = getopt(argc, argv, "s:c:t:i:b:S:")) != -1) {
+	switch (opt) {
+	case 's':
+	    read_script(optarg);
+	    break;
+	case 'c':
+	    add_command(0, optarg);
+	    break;
+	case 't':
+	    trace_path = optarg;
+	    break;
+	case 'i':
+	    interval_ms = atof(optarg);
+	    break;
+	case 'b':
+	    out_bits = atoi(optarg);
+	    break;
+	case 'S':
+	    sends_path = optarg;
+	    break;
+	default:
+	    usage();
+	}
+    }
+    if (argc - optind != 2 || interval_ms <= 0) usage();
+
+    wav in;
+    if (!wav_read(argv[optind], &in, err)) {
+	fprintf(stderr, "%s\n", err);
+	return 1;
+    }
+    if (in.sample_rate != i2s_config_default.fs) {
+	fprintf(stderr, "%s is %luHz, the channel runs at %luHz\n", argv[optind],
+		(unsigned long) in.sample_rate, (unsigned long) i2s_config_default.fs);
+	return 1;
+    }
+    wav out = { in.sample_rate, 2, (uint16_t) out_bits, false, in.frames, 0 };
+    out.samples = calloc(in.frames * 2 + 1, sizeof(int32_t));
+    wav sends = out;
+    sends.samples = sends_path ? calloc(in.frames * 2 + 1, sizeof(int32_t)) : 0;
+
+    FILE *trace = 0;
+    if (trace_path) {
+	trace = fopen(trace_path, "w");
+	if (!trace) {
+	    fprintf(stderr, "can't open %s\n", trace_path);
+	    return 1;
+	}
+	fprintf(trace, "time_s,input_dB,target_reduction_dB,gain_reduction_dB,gate_gain,net_gain_dB,clip_events\n");
+    }
+
+    dsp_init();
+
+    int32_t block_in[I2S_MAX_BLOCK_FRAMES * 2];
+    int32_t block_out[I2S_MAX_BLOCK_FRAMES * 2];
+    int32_t block_sends[I2S_MAX_BLOCK_FRAMES * 2];
+    meter_snapshot meter;
+    int next_command = 0;
+    int32_t trace_peak = 0;
+    uint64_t next_trace_us = 0;
+    uint64_t interval_us = (uint64_t) (interval_ms * 1000);
+    uint16_t block_frames = audio_block_frames;
+    double start = now_s();
+
+    size_t blocks = 0;
+    for (size_t frame = 0; frame < in.frames; frame += block_frames) {
+	// settings change between blocks, like commands from core 1
+	if (next_command < num_commands && commands[next_command].time_us <= time_us_64()) {
+	    apply_command(commands[next_command++].text);
+	}
+	block_frames = audio_block_frames;
+
+	// the last block is padded out with silence
+	size_t n = in.frames - frame;
+	if (n > block_frames) n = block_frames;
+	memset(block_in, 0, sizeof(block_in));
+	for (size_t i = 0; i < n; i++) {
+	    const int32_t *s = &in.samples[(frame + i) * in.channels];
+	    block_in[i*2] = s[0];
+	    block_in[i*2+1] = s[in.channels - 1];
+	}
+
+	process_audio(block_in, block_out, sends_path ? block_sends : 0, block_frames);
+	memcpy(&out.samples[frame * 2], block_out, n * 2 * sizeof(int32_t));
+	if (sends_path) {
+	    memcpy(&sends.samples[frame * 2], block_sends, n * 2 * sizeof(int32_t));
+	}
+	blocks++;
+
+	// the block took this long on the device, then the dsp loop wakes
+	uint64_t now_us = ((frame + block_frames) * 1000000ULL) / in.sample_rate;
+	hal_advance_us(now_us - time_us_64());
+	if (meter_read(&kernel.meter, &meter)) {
+	    control_tick(&meter);
+	    if (meter.in_l > trace_peak) trace_peak = meter.in_l;
+	    if (meter.in_r > trace_peak) trace_peak = meter.in_r;
+	}
+
+	if (trace && now_us >= next_trace_us) {
+	    fprintf(trace, "%.6f,%.2f,%.3f,%.3f,%.4f,%.3f,%lu\n",
+		    now_us * 1e-6,
+		    fm_amp_to_dB(trace_peak),
+		    -fm_ratio_to_dB(dyn.target_gain),
+		    -fm_ratio_to_dB(dyn.gain),
+		    dyn.gate_gain,
+		    fm_ratio_to_dB(kernel.net_gain),
+		    (unsigned long) kernel.limiter.clip_events);
+	    trace_peak = 0;
+	    next_trace_us += interval_us;
+	}
+    }
+    double elapsed = now_s() - start;
+    double duration = (double) in.frames / in.sample_rate;
+
+    if (trace) fclose(trace);
+    if (!wav_write(argv[optind + 1], &out, err)
+	|| (sends_path && !wav_write(sends_path, &sends, err))) {
+	fprintf(stderr, "%s\n", err);
+	return 1;
+    }
+    printf("\nrendered %.2fs of audio in %.3fs, %.1fx real time (%.2fus per block, %lu blocks)\n",
+	   duration, elapsed, duration / elapsed, elapsed * 1e6 / blocks, (unsigned long) blocks);
+    printf("limiter clip events: %lu\n", (unsigned long) kernel.limiter.clip_events);
+    wav_free(&in);
+    wav_free(&out);
+    if (sends_path) wav_free(&sends);
+    return 0;
+}
@@ -0,0 +1,61 @@
+/* DSP Bench
+   Host runner for the lib/dsp_bench stage benchmarks.  The firmware
+   runs the same suite on the device with the F command.
+
+   usage: dsp_bench [-j] [-n iterations] [-f block_frames] [-r sample_rate] [-m cpu_mhz]
+
+     -j  JSON output
+     -m  also express the cost in cycles at this clock
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "i2s.h"
+#include "dsp_bench.h"
+
+static dsp_bench bench;
+
+int main(int argc, char **argv) {
+    uint32_t iterations = 200000;
+    uint32_t frames = AUDIO_BUFFER_FRAMES;
+    uint32_t sample_rate = AUDIO_SAMPLE_RATE;
+    uint32_t cpu_hz = 0;
+    int json = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "jn:f:r:m:")) != -1) {
+	switch (opt) {
+	case 'j':
+	    json = 1;
+	    break;
+	case 'n':
+	    iterations = atoi(optarg);
+	    break;
+	case 'f':
+	    frames = atoi(optarg);
+	    break;
+	case 'r':
+	    sample_rate = atoi(optarg);
+	    break;
+	case 'm':
+	    cpu_hz = (uint32_t) (atof(optarg) * 1e6);
+	    break;
+	default:
+	    fprintf(stderr, "usage: dsp_bench [-j] [-n iterations] [-f block_frames] [-r sample_rate] [-m cpu_mhz]\n");
+	    return 2;
+	}
+    }
+    if (iterations == 0 || frames == 0 || frames > DSP_BENCH_MAX_FRAMES || sample_rate == 0) {
+	fprintf(stderr, "dsp_bench: block frames must be 1 - %d\n", DSP_BENCH_MAX_FRAMES);
+	return 2;
+    }
+
+    dsp_bench_run(&bench, sample_rate, frames, iterations);
+    if (json) {
+	dsp_bench_print_json(&bench, cpu_hz);
+    } else {
+	dsp_bench_print(&bench, cpu_hz);
+    }
+    return 0;
+}
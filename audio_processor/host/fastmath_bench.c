@@ -0,0 +1,107 @@
+/* Fast Math Benchmark
+   Checks the accuracy of lib/fastmath against libm over the ranges
+   the firmware uses, and times both.
+
+   usage: fastmath_bench [iterations]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include "fastmath.h"
+
+#define MAX_AMPLITUDE 2147483647
+
+static volatile float sink;
+
+static double now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// the original firmware versions
+
+static float libm_signal_dB(int32_t amp) {
+    return 20 * log10f((float) amp / MAX_AMPLITUDE);
+}
+
+static float libm_dB_to_ratio(float dB) {
+    return powf(10.0, dB / 20.0);
+}
+
+static void accuracy() {
+    double err_log2 = 0, err_exp2 = 0, err_amp = 0, err_ratio = 0;
+
+    for (double x = 1e-9; x < 1e9; x *= 1.0001) {
+	err_log2 = fmax(err_log2, fabs(fm_log2(x) - log2(x)));
+    }
+    for (double x = -120; x < 120; x += 0.0001) {
+	err_exp2 = fmax(err_exp2, fabs(fm_exp2(x) / exp2(x) - 1.0));
+    }
+    for (int64_t amp = 1; amp < MAX_AMPLITUDE; amp += amp / 10000 + 1) {
+	err_amp = fmax(err_amp, fabs(fm_amp_to_dB(amp) - 20 * log10((double) amp / MAX_AMPLITUDE)));
+    }
+    for (double dB = -144; dB <= 24; dB += 0.001) {
+	err_ratio = fmax(err_ratio, fabs(20 * log10(fm_dB_to_ratio(dB)) - dB));
+    }
+    printf("accuracy (max error)\n");
+    printf("  fm_log2          %.2e\n", err_log2);
+    printf("  fm_exp2          %.2e relative (%.5fdB)\n", err_exp2, 20 * log10(1 + err_exp2));
+    printf("  fm_amp_to_dB     %.5fdB\n", err_amp);
+    printf("  fm_dB_to_ratio   %.5fdB\n", err_ratio);
+    if (err_amp >= 0.05 || err_ratio >= 0.05) {
+	printf("FAIL: error over 0.05dB\n");
+	exit(1);
+    }
+}
+
+static float *make_inputs(int n, float lo, float hi) {
+    float *v = malloc(n * sizeof(float));
+    for (int i = 0; i < n; i++) {
+	v[i] = lo + (hi - lo) * ((float) rand() / RAND_MAX);
+    }
+    return v;
+}
+
+#define TIME(label, expr)						\
+    do {								\
+	double start = now_ns();					\
+	float acc = 0;							\
+	for (int r = 0; r < runs; r++) {				\
+	    for (int i = 0; i < n; i++) acc += (expr);			\
+	}								\
+	sink = acc;							\
+	printf("  %-22s %6.2fns\n", label, (now_ns() - start) / ((double) runs * n)); \
+    } while (0)
+
+static void speed(int runs) {
+    const int n = 4096;
+    float *ratios = make_inputs(n, 1e-6, 16);
+    float *dBs = make_inputs(n, -96, 24);
+    int32_t *amps = malloc(n * sizeof(int32_t));
+    for (int i = 0; i < n; i++) {
+	amps[i] = 1 + (rand() % MAX_AMPLITUDE);
+    }
+    printf("speed (per call, %d x %d calls)\n", runs, n);
+    TIME("log2f", log2f(ratios[i]));
+    TIME("fm_log2", fm_log2(ratios[i]));
+    TIME("exp2f", exp2f(dBs[i] * 0.1f));
+    TIME("fm_exp2", fm_exp2(dBs[i] * 0.1f));
+    TIME("signal_dB (log10f)", libm_signal_dB(amps[i]));
+    TIME("fm_amp_to_dB", fm_amp_to_dB(amps[i]));
+    TIME("dB_to_ratio (powf)", libm_dB_to_ratio(dBs[i]));
+    TIME("fm_dB_to_ratio", fm_dB_to_ratio(dBs[i]));
+    free(ratios);
+    free(dBs);
+    free(amps);
+}
+
+int main(int argc, char **argv) {
+    int runs = (argc > 1) ? atoi(argv[1]) : 1000;
+    accuracy();
+    speed(runs);
+    return 0;
+}
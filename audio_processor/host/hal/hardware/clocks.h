@@ -0,0 +1,5 @@
+/* hardware/clocks.h
+   See pico_hal.h.
+*/
+
+#include "pico_hal.h"
@@ -0,0 +1,5 @@
+/* hardware/i2c.h
+   See pico_hal.h.
+*/
+
+#include "pico_hal.h"
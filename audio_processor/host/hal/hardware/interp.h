@@ -0,0 +1,5 @@
+/* hardware/interp.h
+   See pico_hal.h.
+*/
+
+#include "pico_hal.h"
@@ -0,0 +1,5 @@
+/* hardware/pio.h
+   See pico_hal.h.
+*/
+
+#include "pico_hal.h"
@@ -0,0 +1,5 @@
+/* hardware/uart.h
+   See pico_hal.h.
+*/
+
+#include "pico_hal.h"
@@ -0,0 +1,107 @@
+/* Interpolator emulation
+   The RP2040 SIO interpolators as described in the datasheet (2.3.1.6),
+   for the host builds.  See pico_hal.h for what is covered.
+*/
+
+#include "pico_hal.h"
+
+// CTRL_LANE0/1 fields, at the same bits as the hardware
+#define CTRL_SHIFT_LSB    0
+#define CTRL_MASK_LSB_LSB 5
+#define CTRL_MASK_MSB_LSB 10
+#define CTRL_SIGNED       (1u << 15)
+#define CTRL_BLEND        (1u << 21)
+#define CTRL_CLAMP        (1u << 22)
+
+_Thread_local interp_hw_t interp_hw[2];
+
+interp_config interp_default_config(void) {
+    interp_config c = { 0 };
+    interp_config_set_mask(&c, 0, 31);
+    return c;
+}
+
+void interp_config_set_shift(interp_config *c, uint shift) {
+    c->ctrl = (c->ctrl & ~(0x1fu << CTRL_SHIFT_LSB)) | ((shift & 0x1f) << CTRL_SHIFT_LSB);
+}
+
+void interp_config_set_mask(interp_config *c, uint mask_lsb, uint mask_msb) {
+    c->ctrl = (c->ctrl & ~((0x1fu << CTRL_MASK_LSB_LSB) | (0x1fu << CTRL_MASK_MSB_LSB)))
+	| ((mask_lsb & 0x1f) << CTRL_MASK_LSB_LSB) | ((mask_msb & 0x1f) << CTRL_MASK_MSB_LSB);
+}
+
+void interp_config_set_signed(interp_config *c, bool _signed) {
+    c->ctrl = _signed ? (c->ctrl | CTRL_SIGNED) : (c->ctrl & ~CTRL_SIGNED);
+}
+
+void interp_config_set_blend(interp_config *c, bool blend) {
+    c->ctrl = blend ? (c->ctrl | CTRL_BLEND) : (c->ctrl & ~CTRL_BLEND);
+}
+
+void interp_config_set_clamp(interp_config *c, bool clamp) {
+    c->ctrl = clamp ? (c->ctrl | CTRL_CLAMP) : (c->ctrl & ~CTRL_CLAMP);
+}
+
+void interp_set_config(interp_hw_t *interp, uint lane, interp_config *config) {
+    interp->ctrl[lane] = config->ctrl;
+}
+
+void interp_claim_lane_mask(interp_hw_t *interp, uint lane_mask) {
+}
+
+// the shifted, masked and sign extended accumulator, before the base
+
+static uint32_t lane_shift_mask(interp_hw_t *interp, uint lane) {
+    uint32_t ctrl = interp->ctrl[lane];
+    uint shift = (ctrl >> CTRL_SHIFT_LSB) & 0x1f;
+    uint lsb = (ctrl >> CTRL_MASK_LSB_LSB) & 0x1f;
+    uint msb = (ctrl >> CTRL_MASK_MSB_LSB) & 0x1f;
+    uint32_t above = (msb == 31) ? 0 : (0xffffffffu << (msb + 1));
+    uint32_t mask = ~above & (0xffffffffu << lsb);
+    uint32_t v = (interp->accum[lane] >> shift) & mask;
+
+    if ((ctrl & CTRL_SIGNED) && (v & (1u << msb))) {
+	v |= above;
+    }
+    return v;
+}
+
+/* In blend mode (interp0) the alpha is the low 8 bits of lane 1's
+ * shift/mask result.  Lane 1 blends from BASE0 to BASE1 by alpha / 256,
+ * signed if lane 1 is; lane 0 gives just the alpha, with no base
+ * added.  Lane 0 of interp1 in clamp mode clamps to BASE0 - BASE1 (no
+ * base added), signed if lane 0 is.
+ */
+
+uint32_t interp_peek_lane_result(interp_hw_t *interp, uint lane) {
+    uint32_t v = lane_shift_mask(interp, lane);
+    bool blend = (interp == interp0) && (interp->ctrl[0] & CTRL_BLEND);
+    bool clamp = (interp == interp1) && (interp->ctrl[0] & CTRL_CLAMP);
+    uint32_t alpha = lane_shift_mask(interp, 1) & 0xff;
+
+    if (lane == 0) {
+	if (blend) return alpha;
+	if (clamp) {
+	    if (interp->ctrl[0] & CTRL_SIGNED) {
+		if ((int32_t) v < (int32_t) interp->base[0]) return interp->base[0];
+		if ((int32_t) v > (int32_t) interp->base[1]) return interp->base[1];
+	    } else {
+		if (v < interp->base[0]) return interp->base[0];
+		if (v > interp->base[1]) return interp->base[1];
+	    }
+	    return v;
+	}
+	return v + interp->base[0];
+    }
+    if (blend) {
+	if (interp->ctrl[1] & CTRL_SIGNED) {
+	    int64_t from = (int32_t) interp->base[0];
+	    int64_t to = (int32_t) interp->base[1];
+	    return (uint32_t) (int32_t) (from + (((to - from) * alpha) >> 8));
+	}
+	uint64_t from = interp->base[0];
+	uint64_t to = interp->base[1];
+	return (uint32_t) (from + ((((int64_t) to - (int64_t) from) * (int64_t) alpha) >> 8));
+    }
+    return v + interp->base[1];
+}
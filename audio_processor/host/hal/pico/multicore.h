@@ -0,0 +1,5 @@
+/* pico/multicore.h
+   See pico_hal.h.
+*/
+
+#include "pico_hal.h"
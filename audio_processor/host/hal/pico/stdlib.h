@@ -0,0 +1,5 @@
+/* pico/stdlib.h
+   See pico_hal.h.
+*/
+
+#include "pico_hal.h"
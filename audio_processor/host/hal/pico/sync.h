@@ -0,0 +1,5 @@
+/* pico/sync.h
+   See pico_hal.h.
+*/
+
+#include "pico_hal.h"
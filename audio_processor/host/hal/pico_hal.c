@@ -0,0 +1,203 @@
+/* Pico HAL shim
+   Host stand-ins for the pico SDK and the board drivers used by
+   audio_processor.c.
+*/
+
+#include <stdlib.h>
+#include "pico_hal.h"
+#include "i2s.h"
+#include "mcp4728.h"
+#include "pcm3060.h"
+#include "uart_dma.h"
+
+// same format as the device, see i2s.c
+const i2s_config i2s_config_default = {AUDIO_SAMPLE_RATE, 256, 32, 10, 6, 7, 8, true, 25, AUDIO_BUFFER_FRAMES, AUDIO_RING_BLOCKS};
+
+static i2c_inst_t i2c_insts[2] = { { 0 }, { 1 } };
+static uart_inst_t uart_insts[2] = { { 0 }, { 1 } };
+static pio_hw_t pio_insts[2];
+static dma_hw_t dma_regs;
+
+i2c_inst_t *i2c0 = &i2c_insts[0];
+i2c_inst_t *i2c1 = &i2c_insts[1];
+uart_inst_t *uart0 = &uart_insts[0];
+uart_inst_t *uart1 = &uart_insts[1];
+PIO pio0 = &pio_insts[0];
+PIO pio1 = &pio_insts[1];
+dma_hw_t *dma_hw = &dma_regs;
+
+// simulated time since boot
+static uint64_t hal_time_us = 0;
+
+// clocks and time
+
+uint32_t clock_get_hz(enum clock_index clk) {
+    return 132000000;
+}
+
+bool set_sys_clock_khz(uint32_t khz, bool required) {
+    return true;
+}
+
+void hal_advance_us(uint64_t us) {
+    hal_time_us += us;
+}
+
+uint64_t time_us_64(void) {
+    return hal_time_us;
+}
+
+uint32_t time_us_32(void) {
+    return (uint32_t) hal_time_us;
+}
+
+absolute_time_t get_absolute_time(void) {
+    return hal_time_us;
+}
+
+uint32_t to_ms_since_boot(absolute_time_t t) {
+    return (uint32_t) (t / 1000);
+}
+
+void sleep_us(uint64_t us) {
+    hal_time_us += us;
+}
+
+void sleep_ms(uint32_t ms) {
+    hal_time_us += ms * 1000ULL;
+}
+
+// stdio
+
+void stdio_init_all(void) {
+}
+
+int stdio_getchar_timeout_us(uint32_t timeout_us) {
+    return PICO_ERROR_TIMEOUT;
+}
+
+// gpio
+
+void gpio_init(uint gpio) {
+}
+
+void gpio_set_dir(uint gpio, bool out) {
+}
+
+void gpio_put(uint gpio, bool value) {
+}
+
+void gpio_pull_up(uint gpio) {
+}
+
+void gpio_pull_down(uint gpio) {
+}
+
+void gpio_set_pulls(uint gpio, bool up, bool down) {
+}
+
+void gpio_set_function(uint gpio, enum gpio_function fn) {
+}
+
+void gpio_set_slew_rate(uint gpio, enum gpio_slew_rate slew) {
+}
+
+void gpio_set_drive_strength(uint gpio, enum gpio_drive_strength drive) {
+}
+
+// i2c and uart: nothing is connected
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate) {
+    return baudrate;
+}
+
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop) {
+    return (int) len;
+}
+
+uint uart_init(uart_inst_t *uart, uint baudrate) {
+    return baudrate;
+}
+
+bool uart_is_writable(uart_inst_t *uart) {
+    return false;
+}
+
+bool uart_is_readable(uart_inst_t *uart) {
+    return false;
+}
+
+char uart_getc(uart_inst_t *uart) {
+    return 0;
+}
+
+void uart_puts(uart_inst_t *uart, const char *s) {
+}
+
+// the controller link: frames go nowhere, nothing arrives
+
+void uart_dma_init(uart_dma *t, uart_inst_t *uart, uint baud) {
+    t->uart = uart;
+    t->baud = baud;
+    t->idle = true;
+}
+
+void uart_dma_poll(uart_dma *t) {
+}
+
+bool uart_dma_send(uart_dma *t, const uint8_t *data, size_t len) {
+    t->tx_bytes += len;
+    return true;
+}
+
+int uart_dma_getc(uart_dma *t) {
+    return -1;
+}
+
+// multicore: the host program is the only core
+
+void multicore_launch_core1(void (*entry)(void)) {
+}
+
+void multicore_fifo_push_blocking(uint32_t data) {
+}
+
+uint32_t multicore_fifo_pop_blocking(void) {
+    return 0;
+}
+
+// board parts: the codec, the i2s pio programs and the VCA dac
+
+void i2s_program_start_synched(PIO pio, const i2s_config* config, void (*dma_handler)(void), pio_i2s* i2s) {
+}
+
+void i2s_program_start_sends(PIO pio, const i2s_config* config, pio_i2s* i2s) {
+}
+
+void i2s_sniff_input(pio_i2s* i2s, bool crc) {
+    i2s->sniff = true;
+    i2s->sniff_crc = crc;
+}
+
+bool i2s_set_blocks(pio_i2s* i2s, uint16_t block_frames, uint8_t ring_blocks) {
+    if (!i2s_blocks_valid(block_frames, ring_blocks)) return false;
+    i2s->block_frames = block_frames;
+    i2s->ring_blocks = ring_blocks;
+    return true;
+}
+
+void init_pcm3060() {
+}
+
+void setup_serial_to_pcm3060() {
+}
+
+void serial_set_pcm3060(uint8_t reg, uint8_t value, bool log) {
+}
+
+mcp4728_t *init_mcp4728(i2c_inst_t *i2c, uint8_t addr, bool restart_mode) {
+    return calloc(1, sizeof(mcp4728_t));
+}
+
+void set_dac(mcp4728_t *inst, uint16_t c0, uint16_t c1, uint16_t c2, uint16_t c3, bool log_packet) {
+}
@@ -0,0 +1,162 @@
+/* Pico HAL shim
+   Just enough of the pico SDK for audio_processor.c to build and run
+   on a workstation.  The hardware calls do nothing, except the clock
+   and the interpolators.  Time is simulated and only moves when the
+   host program advances it (normally by one DMA block of audio at a
+   time), so the control loop sees the same timing it would on the
+   device.  The interpolators are emulated (interp.c) so the kernel
+   that uses them gives the same results here as on the device.
+
+   The per-module headers under hardware/ and pico/ all include this
+   one, so the firmware's includes resolve unchanged.
+*/
+
+#ifndef __PICO_HAL__
+#define __PICO_HAL__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;
+
+#define __not_in_flash_func(f) f
+#define __time_critical_func(f) f
+
+#define PICO_ERROR_TIMEOUT -1
+
+// clocks and time
+
+enum clock_index { clk_sys };
+
+uint32_t clock_get_hz(enum clock_index clk);
+bool set_sys_clock_khz(uint32_t khz, bool required);
+
+void hal_advance_us(uint64_t us);   // move the simulated clock on
+uint64_t time_us_64(void);
+uint32_t time_us_32(void);
+absolute_time_t get_absolute_time(void);
+uint32_t to_ms_since_boot(absolute_time_t t);
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+
+static inline void tight_loop_contents(void) {
+}
+
+// stdio
+
+void stdio_init_all(void);
+int stdio_getchar_timeout_us(uint32_t timeout_us);
+
+// gpio
+
+enum gpio_function { GPIO_FUNC_I2C = 3, GPIO_FUNC_UART = 2 };
+enum gpio_slew_rate { GPIO_SLEW_RATE_SLOW, GPIO_SLEW_RATE_FAST };
+enum gpio_drive_strength { GPIO_DRIVE_STRENGTH_2MA, GPIO_DRIVE_STRENGTH_4MA, GPIO_DRIVE_STRENGTH_8MA, GPIO_DRIVE_STRENGTH_12MA };
+
+#define GPIO_OUT 1
+#define GPIO_IN 0
+
+void gpio_init(uint gpio);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_put(uint gpio, bool value);
+void gpio_pull_up(uint gpio);
+void gpio_pull_down(uint gpio);
+void gpio_set_pulls(uint gpio, bool up, bool down);
+void gpio_set_function(uint gpio, enum gpio_function fn);
+void gpio_set_slew_rate(uint gpio, enum gpio_slew_rate slew);
+void gpio_set_drive_strength(uint gpio, enum gpio_drive_strength drive);
+
+// i2c and uart
+
+typedef struct i2c_inst { int index; } i2c_inst_t;
+typedef struct uart_inst { int index; } uart_inst_t;
+
+extern i2c_inst_t *i2c0, *i2c1;
+extern uart_inst_t *uart0, *uart1;
+
+#define UART_FUNCSEL_NUM(uart, gpio) GPIO_FUNC_UART
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate);
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop);
+
+uint uart_init(uart_inst_t *uart, uint baudrate);
+bool uart_is_writable(uart_inst_t *uart);
+bool uart_is_readable(uart_inst_t *uart);
+char uart_getc(uart_inst_t *uart);
+void uart_puts(uart_inst_t *uart, const char *s);
+
+// multicore
+
+void multicore_launch_core1(void (*entry)(void));
+void multicore_fifo_push_blocking(uint32_t data);
+uint32_t multicore_fifo_pop_blocking(void);
+
+// pio and dma, only as far as the types and the interrupt handler go
+
+typedef struct pio_hw { uint32_t unused; } pio_hw_t;
+typedef pio_hw_t *PIO;
+
+extern PIO pio0, pio1;
+
+typedef struct dma_channel_hw {
+    volatile uintptr_t read_addr;   // pointer sized on the host
+    volatile uintptr_t write_addr;
+    volatile uint32_t transfer_count;
+    volatile uint32_t ctrl_trig;
+} dma_channel_hw_t;
+
+typedef struct dma_hw {
+    dma_channel_hw_t ch[12];
+    volatile uint32_t ints0;
+    volatile uint32_t sniff_ctrl;
+    volatile uint32_t sniff_data;
+} dma_hw_t;
+
+extern dma_hw_t *dma_hw;
+
+// the SIO interpolators.  Each core has its own pair, so here each
+// thread does.  Lanes are shift, mask, sign extend and add base, plus
+// the blend (interp0) and clamp (interp1) modes; the cross input and
+// result, add raw and force MSB options aren't emulated.
+
+typedef struct interp_hw {
+    uint32_t accum[2];
+    uint32_t base[3];
+    uint32_t ctrl[2];
+} interp_hw_t;
+
+typedef struct interp_config { uint32_t ctrl; } interp_config;
+
+#ifdef __cplusplus
+extern thread_local interp_hw_t interp_hw[2];
+#else
+extern _Thread_local interp_hw_t interp_hw[2];
+#endif
+
+#define interp0 (&interp_hw[0])
+#define interp1 (&interp_hw[1])
+
+interp_config interp_default_config(void);
+void interp_config_set_shift(interp_config *c, uint shift);
+void interp_config_set_mask(interp_config *c, uint mask_lsb, uint mask_msb);
+void interp_config_set_signed(interp_config *c, bool _signed);
+void interp_config_set_blend(interp_config *c, bool blend);
+void interp_config_set_clamp(interp_config *c, bool clamp);
+void interp_set_config(interp_hw_t *interp, uint lane, interp_config *config);
+void interp_claim_lane_mask(interp_hw_t *interp, uint lane_mask);
+
+static inline void interp_set_base(interp_hw_t *interp, uint lane, uint32_t val) {
+    interp->base[lane] = val;
+}
+
+static inline void interp_set_accumulator(interp_hw_t *interp, uint lane, uint32_t val) {
+    interp->accum[lane] = val;
+}
+
+uint32_t interp_peek_lane_result(interp_hw_t *interp, uint lane);
+
+#endif
@@ -0,0 +1,111 @@
+/* Interp Test
+   The interpolator emulation (hal/interp.c) against values worked out
+   by hand from the RP2040 datasheet, so the interpolator kernel's
+   host results can be trusted to be the device's.
+
+   Blend mode (interp0): the alpha is the low 8 bits of lane 1's
+   shift/mask result, lane 1 gives BASE0 + alpha * (BASE1 - BASE0) / 256
+   and lane 0 just the alpha.  Checked at both ends, the midpoint, a
+   quarter, with the bits above the alpha set, signed and unsigned, and
+   set up as the kernel sets it.  Clamp mode (interp1 lane 0): inside,
+   at and beyond both bounds, signed and unsigned.
+
+   Any failure is printed and the exit status is 1.
+
+   usage: interp_test
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include "hardware/interp.h"
+
+static int failures = 0;
+
+static void check(int32_t got, int32_t want, const char *what) {
+    if (got != want) {
+	printf("FAIL: %s: %ld, expected %ld\n", what, (long) got, (long) want);
+	failures++;
+    }
+}
+
+static void setup_blend(bool _signed) {
+    interp_config c = interp_default_config();
+    interp_config_set_blend(&c, true);
+    interp_set_config(interp0, 0, &c);
+    c = interp_default_config();
+    interp_config_set_mask(&c, 0, 7);
+    interp_config_set_signed(&c, _signed);
+    interp_set_config(interp0, 1, &c);
+}
+
+static int32_t blend(int32_t from, int32_t to, uint32_t accum1) {
+    interp_set_base(interp0, 0, (uint32_t) from);
+    interp_set_base(interp0, 1, (uint32_t) to);
+    interp_set_accumulator(interp0, 1, accum1);
+    return (int32_t) interp_peek_lane_result(interp0, 1);
+}
+
+static void test_blend(void) {
+    setup_blend(false);
+    check(blend(500, 1000, 0), 500, "blend 500-1000 alpha 0");
+    check(blend(500, 1000, 32), 562, "blend 500-1000 alpha 32");
+    check(blend(500, 1000, 128), 750, "blend 500-1000 alpha 128");
+    check(blend(500, 1000, 255), 998, "blend 500-1000 alpha 255");
+    check(blend(500, 1000, 0x1280), 750, "blend alpha from the low 8 bits");
+    check(blend(0, (int32_t) 0x80000000u, 64), 0x20000000, "blend unsigned above INT32_MAX");
+
+    // the alpha is lane 1's, and ACCUM0 plays no part
+    interp_set_accumulator(interp0, 0, 255);
+    check(blend(500, 1000, 0), 500, "blend ignores ACCUM0");
+    check((int32_t) interp_peek_lane_result(interp0, 0), 0, "lane 0 alpha 0");
+    interp_set_accumulator(interp0, 1, 0x1280);
+    check((int32_t) interp_peek_lane_result(interp0, 0), 128, "lane 0 alpha, no BASE0");
+
+    setup_blend(true);
+    check(blend(-1000, 1000, 0), -1000, "signed blend alpha 0");
+    check(blend(-1000, 1000, 128), 0, "signed blend alpha 128");
+    check(blend(-1000, 1000, 255), 992, "signed blend alpha 255");
+    check(blend(1000, -1000, 64), 500, "signed blend downwards alpha 64");
+    check(blend(INT32_MIN, INT32_MAX, 128), -1, "signed blend full range alpha 128");
+
+    // the balance pass: 0 to a Q4.27 full scale sample
+    check(blend(0, -(1 << 27), 255), -133693440, "balance -full scale alpha 255");
+    check(blend(0, (1 << 27) - 1, 128), (1 << 26) - 1, "balance +full scale alpha 128");
+}
+
+static int32_t clamp(int32_t v) {
+    interp_set_accumulator(interp1, 0, (uint32_t) v);
+    return (int32_t) interp_peek_lane_result(interp1, 0);
+}
+
+static void test_clamp(void) {
+    interp_config c = interp_default_config();
+    interp_config_set_clamp(&c, true);
+    interp_config_set_signed(&c, true);
+    interp_set_config(interp1, 0, &c);
+    interp_set_base(interp1, 0, (uint32_t) -100);
+    interp_set_base(interp1, 1, 100);
+    check(clamp(50), 50, "signed clamp inside");
+    check(clamp(-100), -100, "signed clamp at BASE0");
+    check(clamp(100), 100, "signed clamp at BASE1");
+    check(clamp(-101), -100, "signed clamp below");
+    check(clamp(1000), 100, "signed clamp above");
+    check(clamp(INT32_MIN), -100, "signed clamp INT32_MIN");
+    check(clamp(INT32_MAX), 100, "signed clamp INT32_MAX");
+
+    interp_config_set_signed(&c, false);
+    interp_set_config(interp1, 0, &c);
+    interp_set_base(interp1, 0, 10);
+    interp_set_base(interp1, 1, 20);
+    check(clamp(15), 15, "unsigned clamp inside");
+    check(clamp(5), 10, "unsigned clamp below");
+    check(clamp(21), 20, "unsigned clamp above");
+    check(clamp(-1), 20, "unsigned clamp 0xffffffff");
+}
+
+int main(int argc, char **argv) {
+    test_blend();
+    test_clamp();
+    printf("interp checks: %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
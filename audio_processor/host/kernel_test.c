@@ -0,0 +1,142 @@
+/* Kernel Test
+   The Q31 kernel (channel_process_q31) against the float kernel it
+   replaces, sample for sample.  Two kernels with the same settings
+   are fed the same blocks: a -1dBFS sine, then the edges of the codec
+   range (positive and negative full scale, a square between them,
+   one LSB either side of zero, silence).  Each setting is run in
+   turn: unity, trim, net gain, makeup, the output mix, balance both
+   ways and the sends.  The net gain starts at its target, so the
+   rounding of each path's ramp step isn't part of the comparison.
+
+   Every output and send word of the two must be within one LSB of
+   the 24-bit sample (256 in the Q31 word).  Any that isn't is printed
+   with its setting and the exit status is 1.
+
+   usage: kernel_test
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include "i2s.h"
+#include "channel_kernel.h"
+
+#define BLOCK_FRAMES 64
+#define SINE_BLOCKS 32
+#define LSB 256                   // the 24-bit LSB in a Q31 word
+#define FULL_SCALE 0x7fffff00     // the largest 24-bit sample
+#define REPORT_MAX 10             // failures printed
+
+typedef struct setting {
+    const char *name;
+    float trim;
+    float net_gain;
+    float mix;
+    float balance;
+    float send1;
+    float send2;
+} setting;
+
+static const setting settings[] = {
+    { "unity",        1.0f, 1.0f,  1.0f,  0.0f, 0.0f,  0.0f },
+    { "trim 2x",      2.0f, 1.0f,  1.0f,  0.0f, 0.0f,  0.0f },
+    { "net gain",     1.0f, 0.25f, 1.0f,  0.0f, 0.0f,  0.0f },
+    { "makeup +12dB", 0.5f, 3.98f, 1.0f,  0.0f, 0.0f,  0.0f },
+    { "mix 50%",      1.0f, 0.5f,  0.5f,  0.0f, 0.0f,  0.0f },
+    { "balance left", 1.0f, 1.0f,  1.0f, -0.5f, 0.0f,  0.0f },
+    { "balance right",1.0f, 1.0f,  1.0f,  0.5f, 0.0f,  0.0f },
+    { "sends",        1.0f, 0.7f,  1.0f,  0.0f, 1.0f,  0.3f },
+};
+
+#define NUM_SETTINGS (sizeof(settings) / sizeof(settings[0]))
+
+static int32_t input[BLOCK_FRAMES * 2];
+static int32_t output_float[BLOCK_FRAMES * 2];
+static int32_t output_q31[BLOCK_FRAMES * 2];
+static int32_t sends_float[BLOCK_FRAMES * 2];
+static int32_t sends_q31[BLOCK_FRAMES * 2];
+
+static channel_kernel kernel_float;
+static channel_kernel kernel_q31;
+
+static int failures = 0;
+
+// a -1dBFS sine (the right channel half of it, inverted) for the
+// first blocks, then the edge cases a block each
+
+static bool fill_block(uint32_t block) {
+    for (uint32_t i = 0; i < BLOCK_FRAMES; i++) {
+	int32_t l, r;
+	if (block < SINE_BLOCKS) {
+	    double t = (double) (block * BLOCK_FRAMES + i) / AUDIO_SAMPLE_RATE;
+	    double s = 0.891 * sin(2 * M_PI * 997 * t);
+	    l = (int32_t) lrint(s * (FULL_SCALE >> 8)) * LSB;
+	    r = -(l >> 1) & ~(LSB - 1);
+	} else {
+	    switch (block - SINE_BLOCKS) {
+	    case 0: l = FULL_SCALE; r = INT32_MIN; break;
+	    case 1: l = INT32_MIN; r = FULL_SCALE; break;
+	    case 2: l = (i & 1) ? FULL_SCALE : INT32_MIN; r = -l - LSB; break;
+	    case 3: l = LSB; r = -LSB; break;
+	    case 4: l = 0; r = 0; break;
+	    default: return false;
+	    }
+	}
+	input[i*2] = l;
+	input[i*2+1] = r;
+    }
+    return true;
+}
+
+static void apply(channel_kernel *k, const setting *s) {
+    channel_kernel_init(k, AUDIO_SAMPLE_RATE);
+    channel_kernel_set_trim(k, s->trim);
+    channel_kernel_set_net_gain(k, s->net_gain);
+    channel_kernel_set_output_mix(k, s->mix);
+    channel_kernel_set_balance(k, s->balance);
+    channel_kernel_set_sends(k, s->send1, s->send2);
+    k->net_gain_now = k->net_gain;
+    k->net_gain_now_q = k->net_gain_q;
+}
+
+static int compare(const setting *s, uint32_t block, const char *what, const int32_t *a, const int32_t *b) {
+    int bad = 0;
+    for (uint32_t i = 0; i < BLOCK_FRAMES * 2; i++) {
+	if (llabs((int64_t) a[i] - b[i]) > LSB) {
+	    if (failures + bad < REPORT_MAX) {
+		printf("FAIL: %s, block %u %s[%u]: float %ld, q31 %ld\n", s->name,
+		       block, what, i, (long) a[i], (long) b[i]);
+	    }
+	    bad++;
+	}
+    }
+    return bad;
+}
+
+int main(int argc, char **argv) {
+    for (uint32_t n = 0; n < NUM_SETTINGS; n++) {
+	const setting *s = &settings[n];
+	int64_t worst = 0;
+	int bad = 0;
+
+	apply(&kernel_float, s);
+	apply(&kernel_q31, s);
+	for (uint32_t block = 0; fill_block(block); block++) {
+	    channel_process_float(&kernel_float, input, output_float, sends_float, BLOCK_FRAMES);
+	    channel_process_q31(&kernel_q31, input, output_q31, sends_q31, BLOCK_FRAMES);
+	    bad += compare(s, block, "output", output_float, output_q31);
+	    bad += compare(s, block, "send", sends_float, sends_q31);
+	    for (uint32_t i = 0; i < BLOCK_FRAMES * 2; i++) {
+		int64_t d = llabs((int64_t) output_float[i] - output_q31[i]);
+		if (d > worst) worst = d;
+		d = llabs((int64_t) sends_float[i] - sends_q31[i]);
+		if (d > worst) worst = d;
+	    }
+	}
+	printf("%-14s worst %5.2f LSB%s\n", s->name, (double) worst / LSB, bad ? "  FAILED" : "");
+	failures += bad;
+    }
+    printf("kernel checks: %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,453 @@
+/* Mixer Sim
+   Capacity model of a full desk: N channel strips, each running the
+   channel DSP from lib/ (the gate and compressor of the control tick,
+   then the kernel's mix, balance, sends, filters and limiter), summed
+   into a stereo main bus and the two send buses.  The strips run on a
+   pool of threads, each strip a task, with idle threads stealing the
+   strips queued for busier ones.
+
+   For each channel count from 1 up to the maximum (doubling) it times
+   the run single threaded and on the pool, and reports throughput,
+   how many channels would run in real time at that rate, the speedup
+   and the summing headroom of each bus: the peak of the bus sum
+   against full scale (above 0dBFS means the bus needs that much pad)
+   and the samples that clip when it is taken back to 32 bits.
+
+   Each strip gets its own synthetic input (a tone in bursts, so the
+   gate and compressor both work) and its own settings, from a fixed
+   seed, so runs are repeatable.  The control tick here is the gain
+   path of the firmware's control_tick() without the UI state: gate,
+   compressor, makeup, then the kernel's net gain, once per block on
+   that block's peaks.
+
+   usage: mixer_sim [-n max_channels] [-j threads] [-d seconds] [-f block_frames]
+                    [-o main.wav] [-S sends.wav]
+
+     -o, -S  write the buses (saturated to 32 bits) of the largest run
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "i2s.h"
+#include "channel_kernel.h"
+#include "dynamics.h"
+#include "fastmath.h"
+#include "wav.h"
+
+#define MAX_CHANNELS 64
+#define MAX_THREADS 64
+#define CHUNK_FRAMES 1024      // frames each strip runs per task
+#define SIGNAL_CHUNKS 48       // the input loops after this many chunks (~1s)
+#define SUM_FRAMES 64          // frames per summing task
+#define SIM_SEED 0x2545f491
+
+#define min(X, Y) ((X) < (Y) ? (X) : (Y))
+#define max(X, Y) ((X) > (Y) ? (X) : (Y))
+
+typedef struct strip {
+    channel_kernel kernel;
+    dynamics dyn;
+    float makeup;
+    int32_t *input;            // SIGNAL_CHUNKS * CHUNK_FRAMES stereo frames
+    size_t pos;                // next input frame
+    int32_t out[CHUNK_FRAMES * 2];
+    int32_t sends[CHUNK_FRAMES * 2];
+} strip;
+
+typedef struct bus {
+    int64_t sum[CHUNK_FRAMES * 2];
+    int64_t peak[2];           // left and right
+    uint64_t clipped;
+} bus;
+
+static strip *strips;
+static int num_strips;
+static uint32_t sample_rate = AUDIO_SAMPLE_RATE;
+static uint16_t block_frames = AUDIO_BUFFER_FRAMES;
+static size_t chunk_frames;    // CHUNK_FRAMES rounded down to whole blocks
+static bus main_bus;           // stereo
+static bus send_bus;           // send 1 left, send 2 right
+
+static double now_s() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void usage() {
+    fprintf(stderr, "usage: mixer_sim [-n max_channels] [-j threads] [-d seconds] [-f block_frames]\n");
+    fprintf(stderr, "                 [-o main.wav] [-S sends.wav]\n");
+    exit(2);
+}
+
+// -- the thread pool --------------------------------------------------
+
+/* Each run hands the pool a number of tasks, split into a contiguous
+ * slice per thread.  A thread takes tasks from the front of its own
+ * slice, and when that is empty steals from the front of the others'
+ * in turn, so uneven tasks (or an unlucky thread) don't leave the
+ * rest idle.  Taking a task is one atomic add on the slice's cursor,
+ * whoever takes it.  The calling thread works as thread 0.
+ */
+
+typedef struct pool {
+    int threads;
+    pthread_t thread[MAX_THREADS];
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    uint32_t generation;       // bumped for each run
+    int busy;                  // threads still working on this run
+    bool quit;
+    void (*task)(int index);
+    atomic_int cursor[MAX_THREADS];
+    int end[MAX_THREADS];
+    atomic_ulong steals;
+} pool;
+
+static pool workers;
+
+static int pool_take(pool *p, int self) {
+    for (int n = 0; n < p->threads; n++) {
+	int slice = (self + n) % p->threads;
+	if (atomic_load_explicit(&p->cursor[slice], memory_order_relaxed) >= p->end[slice]) continue;
+	int i = atomic_fetch_add(&p->cursor[slice], 1);
+	if (i < p->end[slice]) {
+	    if (n > 0) atomic_fetch_add_explicit(&p->steals, 1, memory_order_relaxed);
+	    return i;
+	}
+    }
+    return -1;
+}
+
+static void pool_work(pool *p, int self) {
+    int i;
+    while ((i = pool_take(p, self)) >= 0) {
+	p->task(i);
+    }
+}
+
+typedef struct worker_arg {
+    pool *p;
+    int self;
+} worker_arg;
+
+static void *pool_thread(void *arg) {
+    worker_arg *w = arg;
+    pool *p = w->p;
+    uint32_t seen = 0;
+
+    pthread_mutex_lock(&p->lock);
+    for (;;) {
+	while (p->generation == seen && !p->quit) {
+	    pthread_cond_wait(&p->wake, &p->lock);
+	}
+	if (p->quit) break;
+	seen = p->generation;
+	pthread_mutex_unlock(&p->lock);
+	pool_work(p, w->self);
+	pthread_mutex_lock(&p->lock);
+	if (--p->busy == 0) pthread_cond_signal(&p->done);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return 0;
+}
+
+static void pool_start(pool *p, int threads) {
+    static worker_arg args[MAX_THREADS];
+    p->threads = threads;
+    p->generation = 0;
+    p->quit = false;
+    pthread_mutex_init(&p->lock, 0);
+    pthread_cond_init(&p->wake, 0);
+    pthread_cond_init(&p->done, 0);
+    for (int t = 1; t < threads; t++) {
+	args[t].p = p;
+	args[t].self = t;
+	pthread_create(&p->thread[t], 0, pool_thread, &args[t]);
+    }
+}
+
+static void pool_stop(pool *p) {
+    pthread_mutex_lock(&p->lock);
+    p->quit = true;
+    pthread_cond_broadcast(&p->wake);
+    pthread_mutex_unlock(&p->lock);
+    for (int t = 1; t < p->threads; t++) {
+	pthread_join(p->thread[t], 0);
+    }
+}
+
+// run tasks 0 to tasks - 1 on all the pool's threads
+
+static void pool_run(pool *p, int tasks, void (*task)(int index)) {
+    p->task = task;
+    for (int t = 0; t < p->threads; t++) {
+	atomic_store(&p->cursor[t], (tasks * t) / p->threads);
+	p->end[t] = (tasks * (t + 1)) / p->threads;
+    }
+    if (p->threads == 1) {
+	pool_work(p, 0);
+	return;
+    }
+    pthread_mutex_lock(&p->lock);
+    p->busy = p->threads - 1;
+    p->generation++;
+    pthread_cond_broadcast(&p->wake);
+    pthread_mutex_unlock(&p->lock);
+
+    pool_work(p, 0);
+
+    pthread_mutex_lock(&p->lock);
+    while (p->busy > 0) {
+	pthread_cond_wait(&p->done, &p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+}
+
+// -- channel strips ---------------------------------------------------
+
+static uint32_t rng_state;
+
+static float rng_uniform(float lo, float hi) {
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return lo + (hi - lo) * ((rng_state >> 8) / 16777216.0f);
+}
+
+/* A tone at its own frequency and level, in bursts with short gaps
+ * so the gate opens and closes, over a noise floor well below the
+ * gate threshold.  Right is a little quieter than left.
+ */
+
+static void strip_signal(strip *s) {
+    size_t frames = (size_t) SIGNAL_CHUNKS * chunk_frames;
+    float hz = rng_uniform(60, 2000);
+    float level = fm_dB_to_ratio(rng_uniform(-24, -6));
+    float skew = fm_dB_to_ratio(rng_uniform(-3, 0));
+    size_t burst = (size_t) (rng_uniform(0.15f, 0.4f) * sample_rate);
+    size_t gap = (size_t) (rng_uniform(0.05f, 0.15f) * sample_rate);
+    double phase = 0;
+    double step = 2 * M_PI * hz / sample_rate;
+
+    s->input = malloc(frames * 2 * sizeof(int32_t));
+    for (size_t i = 0; i < frames; i++) {
+	bool on = (i % (burst + gap)) < burst;
+	float noise = rng_uniform(-1, 1) * 1e-4f;
+	float v = (on ? level * (float) sin(phase) : 0) + noise;
+	phase += step;
+	s->input[i*2] = (int32_t) (v * 2147483647.0f);
+	s->input[i*2+1] = (int32_t) (v * skew * 2147483647.0f);
+    }
+    s->pos = 0;
+}
+
+static void strip_init(strip *s, int index, int count) {
+    float threshold = rng_uniform(-30, -10);
+    float ratio = rng_uniform(2, 8);
+
+    channel_kernel_init(&s->kernel, sample_rate);
+    channel_kernel_set_output_mix(&s->kernel, rng_uniform(0.8f, 1.0f));
+    channel_kernel_set_balance(&s->kernel, (count > 1) ? -0.8f + (1.6f * index) / (count - 1) : 0);
+    channel_kernel_set_sends(&s->kernel, rng_uniform(0, 1), rng_uniform(0, 1));
+
+    dynamics_init(&s->dyn, (float) sample_rate / block_frames);
+    dynamics_set_curve(&s->dyn, threshold, ratio, 6.0f);
+    dynamics_set_times(&s->dyn, 5, 150, 20);
+    dynamics_set_gate(&s->dyn, fm_dB_to_amp(-60), 2, 60, 200);
+    // half the gain reduction at 0dBFS made back up
+    s->makeup = fm_dB_to_ratio(-threshold * (1 - 1 / ratio) * 0.5f);
+    strip_signal(s);
+}
+
+// chunk_frames of audio through one strip, a control tick per block
+
+static void strip_task(int index) {
+    strip *s = &strips[index];
+    meter_snapshot meter;
+
+    for (size_t f = 0; f < chunk_frames; f += block_frames) {
+	channel_process(&s->kernel, &s->input[(s->pos + f) * 2], &s->out[f * 2], &s->sends[f * 2], block_frames);
+	if (meter_read(&s->kernel.meter, &meter)) {
+	    float gate_gain = dynamics_gate(&s->dyn, meter.in_l, meter.in_r, true, 1);
+	    float rgain = dynamics_compress(&s->dyn, max(meter.in_l, meter.in_r), 1);
+	    channel_kernel_set_net_gain(&s->kernel, rgain * s->makeup * gate_gain);
+	}
+    }
+    s->pos = (s->pos + chunk_frames) % ((size_t) SIGNAL_CHUNKS * chunk_frames);
+}
+
+// the buses over SUM_FRAMES of the chunk, in 64 bits so the peaks
+// show how far over full scale a sum goes
+
+static void sum_task(int index) {
+    size_t lo = (size_t) index * SUM_FRAMES * 2;
+    size_t hi = min(lo + SUM_FRAMES * 2, chunk_frames * 2);
+
+    for (size_t i = lo; i < hi; i++) {
+	int64_t m = 0;
+	int64_t x = 0;
+	for (int c = 0; c < num_strips; c++) {
+	    m += strips[c].out[i];
+	    x += strips[c].sends[i];
+	}
+	main_bus.sum[i] = m;
+	send_bus.sum[i] = x;
+    }
+}
+
+static int32_t bus_word(bus *b, size_t i) {
+    int64_t v = b->sum[i];
+    int64_t a = (v < 0) ? -v : v;
+    if (a > b->peak[i & 1]) b->peak[i & 1] = a;
+    if (v > INT32_MAX) {
+	b->clipped++;
+	return INT32_MAX;
+    }
+    if (v < INT32_MIN) {
+	b->clipped++;
+	return INT32_MIN;
+    }
+    return (int32_t) v;
+}
+
+static float peak_dB(int64_t peak) {
+    return (peak > 0) ? 20 * log10f((float) peak / 2147483648.0f) : -INFINITY;
+}
+
+// -- runs -------------------------------------------------------------
+
+typedef struct run_result {
+    double seconds;            // wall time
+    unsigned long steals;
+} run_result;
+
+/* One run of count strips over frames frames, single threaded or on
+ * the pool.  Only the strips and the summing are timed.  If main or
+ * sends are given they get the buses.
+ */
+
+static run_result run(int count, int threads, size_t frames, wav *main_out, wav *sends_out) {
+    run_result r = { 0, 0 };
+    int sum_tasks = (int) ((chunk_frames + SUM_FRAMES - 1) / SUM_FRAMES);
+
+    rng_state = SIM_SEED;
+    num_strips = count;
+    for (int c = 0; c < count; c++) {
+	free(strips[c].input);
+	strip_init(&strips[c], c, count);
+    }
+    memset(&main_bus, 0, sizeof(main_bus));
+    memset(&send_bus, 0, sizeof(send_bus));
+    atomic_store(&workers.steals, 0);
+
+    for (size_t frame = 0; frame < frames; frame += chunk_frames) {
+	double start = now_s();
+	if (threads == 1) {
+	    for (int c = 0; c < count; c++) strip_task(c);
+	    for (int t = 0; t < sum_tasks; t++) sum_task(t);
+	} else {
+	    pool_run(&workers, count, strip_task);
+	    pool_run(&workers, sum_tasks, sum_task);
+	}
+	r.seconds += now_s() - start;
+
+	size_t n = min(chunk_frames, frames - frame);
+	for (size_t i = 0; i < n * 2; i++) {
+	    int32_t m = bus_word(&main_bus, i);
+	    int32_t x = bus_word(&send_bus, i);
+	    if (main_out) main_out->samples[frame * 2 + i] = m;
+	    if (sends_out) sends_out->samples[frame * 2 + i] = x;
+	}
+    }
+    r.steals = atomic_load(&workers.steals);
+    return r;
+}
+
+int main(int argc, char **argv) {
+    int max_channels = MAX_CHANNELS;
+    int threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    double seconds = 2.0;
+    const char *main_path = 0;
+    const char *sends_path = 0;
+    int opt;
+    char err[128];
+
+    while ((opt = getopt(argc, argv, "n:j:d:f:o:S:")) != -1) {
+	switch (opt) {
+	case 'n':
+	    max_channels = atoi(optarg);
+	    break;
+	case 'j':
+	    threads = atoi(optarg);
+	    break;
+	case 'd':
+	    seconds = atof(optarg);
+	    break;
+	case 'f':
+	    block_frames = atoi(optarg);
+	    break;
+	case 'o':
+	    main_path = optarg;
+	    break;
+	case 'S':
+	    sends_path = optarg;
+	    break;
+	default:
+	    usage();
+	}
+    }
+    if (optind != argc || max_channels < 1 || max_channels > MAX_CHANNELS || seconds <= 0
+	|| block_frames < I2S_MIN_BLOCK_FRAMES || block_frames > I2S_MAX_BLOCK_FRAMES) {
+	usage();
+    }
+    threads = max(1, min(threads, MAX_THREADS));
+    chunk_frames = (CHUNK_FRAMES / block_frames) * block_frames;
+
+    size_t frames = (size_t) (seconds * sample_rate);
+    frames = ((frames + chunk_frames - 1) / chunk_frames) * chunk_frames;
+    strips = calloc(MAX_CHANNELS, sizeof(strip));
+    pool_start(&workers, threads);
+
+    printf("mixer sim: %luHz, %d frame blocks, %.2fs of audio per run, %s kernel, %d threads\n",
+	   (unsigned long) sample_rate, block_frames, (double) frames / sample_rate, CHANNEL_KERNEL_NAME, threads);
+    printf("%8s %10s %10s %9s %11s %8s %8s %7s %10s %10s %10s %9s\n",
+	   "channels", "1 thr ms", "pool ms", "x real", "rt channels", "ns/smpl", "speedup", "steals",
+	   "main dBFS", "send1 dBFS", "send2 dBFS", "clipped");
+
+    wav main_wav = { sample_rate, 2, 24, false, frames, 0 };
+    wav sends_wav = { sample_rate, 2, 24, false, frames, 0 };
+    if (main_path) main_wav.samples = calloc(frames * 2, sizeof(int32_t));
+    if (sends_path) sends_wav.samples = calloc(frames * 2, sizeof(int32_t));
+
+    for (int count = 1; ; count = min(count * 2, max_channels)) {
+	bool last = (count == max_channels);
+	double duration = (double) frames / sample_rate;
+	wav *main_out = (last && main_path) ? &main_wav : 0;
+	wav *sends_out = (last && sends_path) ? &sends_wav : 0;
+	run_result single = run(count, 1, frames, (threads == 1) ? main_out : 0, (threads == 1) ? sends_out : 0);
+	run_result pooled = (threads > 1) ? run(count, threads, frames, main_out, sends_out) : single;
+	double x_real = duration / pooled.seconds;
+	printf("%8d %10.1f %10.1f %9.1f %11.0f %8.1f %8.2f %7lu %10.1f %10.1f %10.1f %9lu\n",
+	       count, single.seconds * 1000, pooled.seconds * 1000, x_real, x_real * count,
+	       pooled.seconds * 1e9 / ((double) frames * count), single.seconds / pooled.seconds,
+	       pooled.steals, peak_dB(max(main_bus.peak[0], main_bus.peak[1])),
+	       peak_dB(send_bus.peak[0]), peak_dB(send_bus.peak[1]),
+	       (unsigned long) (main_bus.clipped + send_bus.clipped));
+	if (last) break;
+    }
+
+    pool_stop(&workers);
+    if ((main_path && !wav_write(main_path, &main_wav, err))
+	|| (sends_path && !wav_write(sends_path, &sends_wav, err))) {
+	fprintf(stderr, "%s\n", err);
+	return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,454 @@
+/* Proto Bench
+   The binary DSP/controller protocol (lib/proto.h) against the ASCII
+   lines it replaced.
+
+   It first checks the codec: every message type, with edge values, is
+   encoded and fed back one byte at a time through the stream decoder,
+   between idle delimiters and line noise, and must come back as it
+   went in.  A frame with any one byte changed, one cut short, one cut
+   off by an idle line and one that overruns the buffer must each be
+   dropped and counted.  The meter codes must come back within a
+   quarter step, and every code must survive a round trip.  Any failure
+   is printed and the exit status is 1.
+
+   It then times the meters both ways, 50ms of them: one PROTO_METER
+   frame of ten 5ms reports against the one "A..." line the DSP sent
+   every 50ms, for the same levels (even in dB down to -60dBFS); and a
+   settings change both ways: one PROTO_PARAM frame against the whole
+   "C..." status line the DSP used to send for it.  That's encode and decode of the
+   binary frames, and the sprintf and strtok/atof of the old lines,
+   with the bytes each puts on the wire and what those take on the
+   link: the ASCII lines at the 115200 baud they had, the frames at
+   PROTO_BAUD.  A full snapshot, as sent on a resync, is shown too.
+
+   usage: proto_bench [-n messages]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "dsp_platform.h"
+#include "proto.h"
+
+#define ASCII_BAUD 115200         // the link before the binary protocol
+#define BENCH_SEED 0x2545f491
+#define LEVEL_RANGE 8192          // full scale in the old "A..." line
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+    if (!ok) {
+	printf("FAIL: %s\n", what);
+	failures++;
+    }
+}
+
+static uint32_t next_random(uint32_t *x) {
+    *x ^= *x << 13;
+    *x ^= *x >> 17;
+    *x ^= *x << 5;
+    return *x;
+}
+
+// what the old "A..." line carried
+
+typedef struct activity_line {
+    uint16_t input_l;         // 0 to LEVEL_RANGE
+    uint16_t input_r;
+    uint16_t peak_l;
+    uint16_t peak_r;
+    uint16_t output_l;
+    uint16_t output_r;
+    uint16_t output_peak_l;
+    uint16_t output_peak_r;
+    uint16_t compression_gain;  // 0 to 65535 for 0 to 1
+    uint8_t flags;
+} activity_line;
+
+// a level even in dB, full scale to -60dBFS
+
+static float sample_level(uint32_t *x) {
+    return powf(10, -(float) (next_random(x) % 601) / 200);
+}
+
+// 50ms of meter reports, as a meter frame and, if a isn't null, as
+// the old line
+
+static void sample_meter(proto_meter *m, activity_line *a, uint32_t *x) {
+    float in_l = 0, in_r = 0;
+    float peak_l = 0, peak_r = 0;
+
+    for (int i = 0; i < PROTO_METER_REPORTS; i++) {
+	in_l = sample_level(x);
+	in_r = sample_level(x);
+	m->input_l[i] = proto_level_code(in_l);
+	m->input_r[i] = proto_level_code(in_r);
+	peak_l = fmaxf(peak_l, in_l);
+	peak_r = fmaxf(peak_r, in_r);
+    }
+    float gain = (float) (next_random(x) % 1001) / 1000;
+    m->output_l = proto_level_code(peak_l * gain);
+    m->output_r = proto_level_code(peak_r * gain);
+    m->reduction = proto_reduction_code(gain);
+    m->flags = next_random(x) & (PROTO_MUTED | PROTO_GATE_OPEN);
+    m->version = next_random(x);
+    if (a) {
+	a->input_l = in_l * LEVEL_RANGE;
+	a->input_r = in_r * LEVEL_RANGE;
+	a->peak_l = peak_l * LEVEL_RANGE;
+	a->peak_r = peak_r * LEVEL_RANGE;
+	a->output_l = in_l * gain * LEVEL_RANGE;
+	a->output_r = in_r * gain * LEVEL_RANGE;
+	a->output_peak_l = peak_l * gain * LEVEL_RANGE;
+	a->output_peak_r = peak_r * gain * LEVEL_RANGE;
+	a->compression_gain = gain * 65535;
+	a->flags = m->flags;
+    }
+}
+
+static void sample_param(proto_param *p, uint32_t *x) {
+    p->param = "artcbRkSmg12GAEHNOMxXTLh"[next_random(x) % 24];
+    p->flags = 0;
+    p->version = next_random(x);
+    p->value = (float) (next_random(x) % 2000) / 16 - 60;
+}
+
+// the settings the old "C..." line carried
+
+typedef struct status_line {
+    uint8_t compressor_on;
+    uint16_t attack_ms;
+    uint16_t release_ms;
+    float threshold_dB;
+    float makeup_dB;
+    float ratio;
+    float output_mix;
+    float input_trim_gain;
+    float balance;
+    float channel_gain;
+    float send1_gain;
+    float send2_gain;
+} status_line;
+
+static void sample_status(status_line *c) {
+    c->compressor_on = 1;
+    c->attack_ms = 1;
+    c->release_ms = 225;
+    c->threshold_dB = -18.5f;
+    c->makeup_dB = 3.25f;
+    c->ratio = 30;
+    c->output_mix = 1;
+    c->input_trim_gain = 1.2f;
+    c->balance = -0.25f;
+    c->channel_gain = 0.8125f;
+    c->send1_gain = 0.5f;
+    c->send2_gain = 0;
+}
+
+// feed a frame through the decoder, true if it gives back a message
+// of the type with the payload
+
+static bool decodes_to(proto_rx *rx, const uint8_t *frame, size_t len, uint8_t type, const void *payload) {
+    bool got = false;
+    for (size_t i = 0; i < len; i++) {
+	got = proto_rx_byte(rx, frame[i]);
+	if (got && i != len - 1) return false;
+    }
+    return got && rx->msg.type == type && memcmp(rx->msg.u.bytes, payload, proto_payload_size(type)) == 0;
+}
+
+static void round_trip(uint8_t type, const void *payload, const char *name) {
+    uint8_t frame[PROTO_MAX_FRAME];
+    char what[80];
+    proto_rx rx;
+
+    proto_rx_init(&rx);
+    size_t len = proto_encode(type, payload, frame);
+    snprintf(what, sizeof(what), "%s encodes", name);
+    check(len > 0 && len <= PROTO_MAX_FRAME && memchr(frame, 0, len) == &frame[len-1], what);
+
+    // idle delimiters and a run of line noise ahead of it
+
+    proto_rx_byte(&rx, 0);
+    proto_rx_byte(&rx, 0);
+    uint8_t noise[] = { 0x41, 0x31, 0x32, 0x20, 0x0a };
+    for (size_t i = 0; i < sizeof(noise); i++) proto_rx_byte(&rx, noise[i]);
+    proto_rx_byte(&rx, 0);
+    uint32_t errors = rx.errors;
+    snprintf(what, sizeof(what), "%s round trip", name);
+    check(decodes_to(&rx, frame, len, type, payload) && rx.errors == errors, what);
+
+    // any one byte changed
+
+    bool dropped = true;
+    for (size_t i = 0; i < len - 1; i++) {
+	uint8_t bad[PROTO_MAX_FRAME];
+	memcpy(bad, frame, len);
+	bad[i] ^= (i & 1) ? 0x10 : 0x01;
+	if (bad[i] == 0) bad[i] = 0x80;
+	errors = rx.errors;
+	if (decodes_to(&rx, bad, len, type, payload) || rx.errors != errors + 1) dropped = false;
+    }
+    snprintf(what, sizeof(what), "%s corrupt frames dropped", name);
+    check(dropped, what);
+
+    // cut short
+
+    errors = rx.errors;
+    for (size_t i = 0; i < len / 2; i++) proto_rx_byte(&rx, frame[i]);
+    snprintf(what, sizeof(what), "%s short frame dropped", name);
+    check(!proto_rx_byte(&rx, 0) && rx.errors == errors + 1, what);
+    snprintf(what, sizeof(what), "%s after errors", name);
+    check(decodes_to(&rx, frame, len, type, payload), what);
+}
+
+static void codec_checks() {
+    proto_meter a;
+    proto_param p;
+    proto_sync y;
+    proto_diagnostics d;
+    proto_set s;
+    proto_ack k;
+    uint32_t x = BENCH_SEED;
+
+    memset(&a, 0, sizeof(a));
+    round_trip(PROTO_METER, &a, "meter (all zero)");
+    memset(&a, 0xff, sizeof(a));
+    round_trip(PROTO_METER, &a, "meter (all ones)");
+    for (int i = 0; i < 1000; i++) {
+	sample_meter(&a, NULL, &x);
+	round_trip(PROTO_METER, &a, "meter");
+    }
+    for (int i = 0; i < 1000; i++) {
+	sample_param(&p, &x);
+	round_trip(PROTO_PARAM, &p, "param");
+    }
+    p.param = 'N';
+    p.flags = PROTO_SNAPSHOT;
+    p.version = 0;
+    p.value = 0;
+    round_trip(PROTO_PARAM, &p, "param (snapshot, zero)");
+    y.version = 65535;
+    y.count = 24;
+    round_trip(PROTO_SYNC, &y, "sync");
+
+    d.mode = 0;
+    d.dc_ppm = -596;
+    d.coverage = 100;
+    d.flags = PROTO_INPUT_DRIFT;
+    round_trip(PROTO_DIAGNOSTICS, &d, "diagnostics");
+    d.dc_ppm = INT32_MIN;
+    d.flags = PROTO_INPUT_STUCK | PROTO_INPUT_DRIFT;
+    round_trip(PROTO_DIAGNOSTICS, &d, "diagnostics (min)");
+
+    s.param = 't';
+    s.seq = 255;
+    s.value = -18;
+    round_trip(PROTO_SET, &s, "set");
+    k.param = 't';
+    k.seq = 255;
+    k.ok = 0;
+    k.version = 0;
+    k.value = 0;
+    round_trip(PROTO_ACK, &k, "ack (refused)");
+    k.ok = 1;
+    k.version = 0x1234;
+    k.value = -18;
+    round_trip(PROTO_ACK, &k, "ack");
+    round_trip(PROTO_SYNC_REQUEST, NULL, "sync request");
+
+    uint8_t frame[PROTO_MAX_FRAME];
+    check(proto_encode(0, &a, frame) == 0 && proto_encode(PROTO_TYPES, &a, frame) == 0, "unknown types refused");
+
+    // a frame of another type's length is dropped
+
+    proto_rx rx;
+    proto_rx_init(&rx);
+    size_t len = proto_encode(PROTO_ACK, &k, frame);
+    frame[1] = PROTO_SET;  // the type is the first byte after the code
+    uint32_t errors = rx.errors;
+    check(!decodes_to(&rx, frame, len, PROTO_SET, &k) && rx.errors == errors + 1, "wrong length dropped");
+
+    // an overrun drops everything up to the next delimiter
+
+    errors = rx.errors;
+    for (int i = 0; i < PROTO_MAX_FRAME * 3; i++) proto_rx_byte(&rx, 0x55);
+    check(!proto_rx_byte(&rx, 0) && rx.errors == errors + 1, "overrun dropped");
+    len = proto_encode(PROTO_PARAM, &p, frame);
+    check(decodes_to(&rx, frame, len, PROTO_PARAM, &p), "param after overrun");
+
+    // a frame cut off by an idle line is dropped, not joined to the next
+
+    errors = rx.errors;
+    for (size_t i = 0; i < len / 2; i++) proto_rx_byte(&rx, frame[i]);
+    proto_rx_idle(&rx);
+    check(rx.errors == errors + 1 && decodes_to(&rx, frame, len, PROTO_PARAM, &p), "idle line drops a partial frame");
+
+    // the CCITT check value
+
+    check(proto_crc16((const uint8_t *) "123456789", 9) == 0x29b1, "crc check value");
+
+    // the meter codes
+
+    check(proto_level_code(1) == 255 && proto_level_code(2) == 255, "full scale is 255");
+    check(proto_level_code(0) == 0 && proto_level_code(-1) == 0 && proto_level_code(NAN) == 0, "silence is 0");
+    check(proto_level_code(powf(10, -127.0f / 20)) == 1 && proto_level_code(powf(10, -128.0f / 20)) == 0, "1 is -127dBFS");
+    bool exact = true;
+    for (int c = 0; c < 256; c++) {
+	if (proto_level_code(proto_level_ratio(c)) != c) exact = false;
+	if (proto_reduction_code(proto_reduction_gain(c)) != c) exact = false;
+    }
+    check(exact, "meter codes round trip");
+    check(proto_reduction_code(1) == 0 && proto_reduction_code(0) == 255 && proto_reduction_gain(0) == 1, "reduction ends");
+    float worst = 0;
+    for (float dB = -127; dB <= 0; dB += 0.01f) {
+	float back = 20 * log10f(proto_level_ratio(proto_level_code(powf(10, dB / 20))));
+	worst = fmaxf(worst, fabsf(back - dB));
+	back = -20 * log10f(proto_reduction_gain(proto_reduction_code(powf(10, dB / 20))));
+	worst = fmaxf(worst, fabsf(back + dB));
+    }
+    check(worst <= PROTO_METER_STEP_DB / 2 + 0.001f, "meter codes within a quarter step");
+}
+
+// the lines the DSP sent before, and the controller's parse of them
+
+static size_t ascii_activity(char *buf, const activity_line *a) {
+    return sprintf(buf, "A%d %d %d %d %d %d %d %d %d %d %d\n", a->input_l, a->input_r, a->peak_l, a->peak_r,
+		   a->output_l, a->output_r, a->output_peak_l, a->output_peak_r, a->compression_gain,
+		   (a->flags & PROTO_MUTED) != 0, (a->flags & PROTO_GATE_OPEN) != 0);
+}
+
+static float ascii_parse_activity(char *buf) {
+    float sum = 0;
+    char *field = strtok(buf + 1, " ");
+    for (int i = 0; i < 9 && field; i++) {
+	sum += (float) atof(field) / LEVEL_RANGE;
+	field = strtok(NULL, " ");
+    }
+    for (int i = 0; i < 2 && field; i++) {
+	sum += atoi(field);
+	field = strtok(NULL, " ");
+    }
+    return sum;
+}
+
+static size_t ascii_status(char *buf, const status_line *c) {
+    return sprintf(buf, "C%d %d %d %f %f %f %f %f %f %f %f %f\n", c->compressor_on, c->attack_ms, c->release_ms,
+		   c->threshold_dB, c->makeup_dB, c->ratio, c->output_mix, c->input_trim_gain, c->balance,
+		   c->channel_gain, c->send1_gain, c->send2_gain);
+}
+
+static float ascii_parse_status(char *buf) {
+    float sum = atoi(strtok(buf + 1, " "));
+    sum += atoi(strtok(NULL, " "));
+    sum += atoi(strtok(NULL, " "));
+    for (int i = 0; i < 9; i++) sum += atof(strtok(NULL, " "));
+    return sum;
+}
+
+typedef struct timing {
+    double encode_ns;
+    double decode_ns;
+    double bytes;
+} timing;
+
+static volatile float sink;
+
+static timing time_binary(uint8_t type, uint32_t n) {
+    uint8_t frame[PROTO_MAX_FRAME];
+    proto_meter m;
+    proto_param p;
+    proto_rx rx;
+    uint32_t x = BENCH_SEED;
+    uint64_t encode = 0, decode = 0, bytes = 0;
+    const void *payload = (type == PROTO_METER) ? (const void *) &m : (const void *) &p;
+
+    proto_rx_init(&rx);
+    for (uint32_t i = 0; i < n; i++) {
+	if (type == PROTO_METER) {
+	    sample_meter(&m, NULL, &x);
+	} else {
+	    sample_param(&p, &x);
+	}
+	uint64_t start = dsp_time_ns();
+	size_t len = proto_encode(type, payload, frame);
+	uint64_t mid = dsp_time_ns();
+	for (size_t j = 0; j < len; j++) {
+	    if (proto_rx_byte(&rx, frame[j])) sink = rx.msg.u.bytes[0];
+	}
+	decode += dsp_time_ns() - mid;
+	encode += mid - start;
+	bytes += len;
+    }
+    timing t = { (double) encode / n, (double) decode / n, (double) bytes / n };
+    return t;
+}
+
+static timing time_ascii(uint8_t type, uint32_t n) {
+    char buf[256];
+    proto_meter m;
+    activity_line a;
+    status_line c;
+    uint32_t x = BENCH_SEED;
+    uint64_t encode = 0, decode = 0, bytes = 0;
+
+    sample_status(&c);
+    for (uint32_t i = 0; i < n; i++) {
+	if (type == PROTO_METER) {
+	    sample_meter(&m, &a, &x);
+	}
+	uint64_t start = dsp_time_ns();
+	size_t len = (type == PROTO_METER) ? ascii_activity(buf, &a) : ascii_status(buf, &c);
+	uint64_t mid = dsp_time_ns();
+	sink = (type == PROTO_METER) ? ascii_parse_activity(buf) : ascii_parse_status(buf);
+	decode += dsp_time_ns() - mid;
+	encode += mid - start;
+	bytes += len;
+    }
+    timing t = { (double) encode / n, (double) decode / n, (double) bytes / n };
+    return t;
+}
+
+static void print_timing(const char *name, timing t, uint32_t baud) {
+    printf("%-18s %10.1f %10.1f %8.1f %10.0f\n", name, t.encode_ns, t.decode_ns, t.bytes,
+	   t.bytes * 10 * 1e6 / baud);
+}
+
+int main(int argc, char **argv) {
+    uint32_t n = 200000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+	switch (opt) {
+	case 'n':
+	    n = atoi(optarg);
+	    break;
+	default:
+	    fprintf(stderr, "usage: proto_bench [-n messages]\n");
+	    return 2;
+	}
+    }
+    if (n == 0) n = 1;
+
+    codec_checks();
+    printf("codec checks: %s\n", failures ? "FAILED" : "passed");
+
+    printf("\n%lu messages, ascii at %d baud, binary at %d\n", (unsigned long) n, ASCII_BAUD, PROTO_BAUD);
+    printf("%-18s %10s %10s %8s %10s\n", "message", "encode ns", "decode ns", "bytes", "wire us");
+    print_timing("meter binary", time_binary(PROTO_METER, n), PROTO_BAUD);
+    print_timing("meter ascii", time_ascii(PROTO_METER, n), ASCII_BAUD);
+    print_timing("change binary", time_binary(PROTO_PARAM, n), PROTO_BAUD);
+    print_timing("change ascii", time_ascii(PROTO_PARAM, n), ASCII_BAUD);
+
+    // a snapshot: 24 parameters and the sync
+
+    uint8_t frame[PROTO_MAX_FRAME];
+    proto_param p = { 't', PROTO_SNAPSHOT, 1, -18 };
+    proto_sync y = { 24, 24 };
+    timing t = { 0, 0, 24 * proto_encode(PROTO_PARAM, &p, frame) + proto_encode(PROTO_SYNC, &y, frame) };
+    printf("%-18s %10s %10s %8.1f %10.0f\n", "snapshot binary", "-", "-", t.bytes, t.bytes * 10 * 1e6 / PROTO_BAUD);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,238 @@
+/* SoA Bench
+   The strip SoA engine (strip_soa.h) against the scalar float kernel
+   called strip by strip, for a desk of channel strips.
+
+   Each strip gets a synthetic input and settings from a fixed seed, as
+   in mixer_sim, and the same control tick (gate, compressor, makeup,
+   net gain) after every block, so the gain ramps, the output mix and
+   the sends are all exercised.  For each channel count from 1 up to
+   the maximum (doubling) the strips are run once through
+   channel_process_float() in a loop and once through the engine on
+   each vector path the CPU has, from the same starting state.  Only
+   the processing is timed.  The outputs and sends of every block are
+   checksummed, and "match" says whether a path's checksum is the
+   scalar kernel's.
+
+   usage: soa_bench [-n max_channels] [-d seconds] [-f block_frames]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "i2s.h"
+#include "channel_kernel.h"
+#include "dynamics.h"
+#include "fastmath.h"
+#include "strip_soa.h"
+
+#define SIGNAL_FRAMES 48000    // the input loops after this many frames
+#define BENCH_SEED 0x2545f491
+
+#define min(X, Y) ((X) < (Y) ? (X) : (Y))
+#define max(X, Y) ((X) > (Y) ? (X) : (Y))
+
+typedef struct strip {
+    channel_kernel kernel;
+    dynamics dyn;
+    float makeup;
+    int32_t *input;            // SIGNAL_FRAMES stereo frames
+    int32_t out[I2S_MAX_BLOCK_FRAMES * 2];
+    int32_t sends[I2S_MAX_BLOCK_FRAMES * 2];
+} strip;
+
+static strip strips[SOA_MAX_LANES];
+static uint32_t sample_rate = AUDIO_SAMPLE_RATE;
+static uint16_t block_frames = AUDIO_BUFFER_FRAMES;
+
+static double now_s() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void usage() {
+    fprintf(stderr, "usage: soa_bench [-n max_channels] [-d seconds] [-f block_frames]\n");
+    exit(2);
+}
+
+static uint32_t rng_state;
+
+static float rng_uniform(float lo, float hi) {
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return lo + (hi - lo) * ((rng_state >> 8) / 16777216.0f);
+}
+
+// a tone in bursts over a low noise floor, right a little quieter
+
+static void strip_signal(strip *s) {
+    float hz = rng_uniform(60, 2000);
+    float level = fm_dB_to_ratio(rng_uniform(-24, -6));
+    float skew = fm_dB_to_ratio(rng_uniform(-3, 0));
+    size_t burst = (size_t) (rng_uniform(0.15f, 0.4f) * sample_rate);
+    size_t gap = (size_t) (rng_uniform(0.05f, 0.15f) * sample_rate);
+    double step = 2 * M_PI * hz / sample_rate;
+
+    for (size_t i = 0; i < SIGNAL_FRAMES; i++) {
+	bool on = (i % (burst + gap)) < burst;
+	float noise = rng_uniform(-1, 1) * 1e-4f;
+	float v = (on ? level * (float) sin(step * i) : 0) + noise;
+	s->input[i*2] = (int32_t) (v * 2147483647.0f);
+	s->input[i*2+1] = (int32_t) (v * skew * 2147483647.0f);
+    }
+}
+
+// every strip back to the same settings and state
+
+static void strips_init(int count) {
+    rng_state = BENCH_SEED;
+    for (int c = 0; c < count; c++) {
+	strip *s = &strips[c];
+	float threshold = rng_uniform(-30, -10);
+	float ratio = rng_uniform(2, 8);
+
+	channel_kernel_init(&s->kernel, sample_rate);
+	channel_kernel_set_trim(&s->kernel, rng_uniform(0.7f, 1.4f));
+	// some strips blend in the dry signal, the rest are all wet
+	channel_kernel_set_output_mix(&s->kernel, (c % 3 == 0) ? rng_uniform(0.5f, 0.95f) : 1.0f);
+	channel_kernel_set_balance(&s->kernel, (count > 1) ? -0.8f + (1.6f * c) / (count - 1) : 0);
+	channel_kernel_set_sends(&s->kernel, rng_uniform(0, 1), rng_uniform(0, 1));
+
+	dynamics_init(&s->dyn, (float) sample_rate / block_frames);
+	dynamics_set_curve(&s->dyn, threshold, ratio, 6.0f);
+	dynamics_set_times(&s->dyn, 5, 150, 20);
+	dynamics_set_gate(&s->dyn, fm_dB_to_amp(-60), 2, 60, 200);
+	s->makeup = fm_dB_to_ratio(-threshold * (1 - 1 / ratio) * 0.5f);
+	if (!s->input) s->input = malloc(SIGNAL_FRAMES * 2 * sizeof(int32_t));
+	strip_signal(s);
+    }
+}
+
+static void control_tick(strip *s) {
+    meter_snapshot meter;
+
+    if (meter_read(&s->kernel.meter, &meter)) {
+	float gate_gain = dynamics_gate(&s->dyn, meter.in_l, meter.in_r, true, 1);
+	float rgain = dynamics_compress(&s->dyn, max(meter.in_l, meter.in_r), 1);
+	channel_kernel_set_net_gain(&s->kernel, rgain * s->makeup * gate_gain);
+    }
+}
+
+// FNV-1a over a block's words
+
+static uint64_t checksum(uint64_t h, const int32_t *words, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+	h = (h ^ (uint32_t) words[i]) * 0x100000001b3ull;
+    }
+    return h;
+}
+
+typedef struct run_result {
+    double seconds;
+    uint64_t sum;
+} run_result;
+
+/* count strips over frames frames, through the scalar kernel if soa
+ * is null, otherwise through the engine on the given path.
+ */
+
+static run_result run(int count, strip_soa *soa, int isa, size_t frames) {
+    run_result r = { 0, 0xcbf29ce484222325ull };
+    channel_kernel *kernels[SOA_MAX_LANES];
+    const int32_t *inputs[SOA_MAX_LANES];
+    int32_t *outputs[SOA_MAX_LANES];
+    int32_t *sends[SOA_MAX_LANES];
+
+    strips_init(count);
+    for (int c = 0; c < count; c++) {
+	kernels[c] = &strips[c].kernel;
+	outputs[c] = strips[c].out;
+	sends[c] = strips[c].sends;
+    }
+    if (soa) {
+	strip_soa_init(soa, kernels, count);
+	soa->isa = isa;
+    }
+
+    for (size_t frame = 0; frame < frames; frame += block_frames) {
+	size_t pos = frame % SIGNAL_FRAMES;
+	double start = now_s();
+	if (soa) {
+	    for (int c = 0; c < count; c++) inputs[c] = &strips[c].input[pos * 2];
+	    strip_soa_process(soa, inputs, outputs, sends, block_frames);
+	} else {
+	    for (int c = 0; c < count; c++) {
+		strip *s = &strips[c];
+		channel_process_float(&s->kernel, &s->input[pos * 2], s->out, s->sends, block_frames);
+	    }
+	}
+	for (int c = 0; c < count; c++) control_tick(&strips[c]);
+	r.seconds += now_s() - start;
+
+	for (int c = 0; c < count; c++) {
+	    r.sum = checksum(r.sum, strips[c].out, block_frames * 2);
+	    r.sum = checksum(r.sum, strips[c].sends, block_frames * 2);
+	}
+    }
+    return r;
+}
+
+int main(int argc, char **argv) {
+    int max_channels = SOA_MAX_LANES;
+    double seconds = 2.0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:d:f:")) != -1) {
+	switch (opt) {
+	case 'n':
+	    max_channels = atoi(optarg);
+	    break;
+	case 'd':
+	    seconds = atof(optarg);
+	    break;
+	case 'f':
+	    block_frames = atoi(optarg);
+	    break;
+	default:
+	    usage();
+	}
+    }
+    if (optind != argc || max_channels < 1 || max_channels > SOA_MAX_LANES || seconds <= 0
+	|| block_frames < I2S_MIN_BLOCK_FRAMES || block_frames > I2S_MAX_BLOCK_FRAMES
+	|| SIGNAL_FRAMES % block_frames) {
+	usage();
+    }
+
+    // whole blocks, none straddling the end of the input loop
+    size_t frames = (size_t) (seconds * sample_rate);
+    frames = ((frames + block_frames - 1) / block_frames) * block_frames;
+    strip_soa *soa = aligned_alloc(32, (sizeof(strip_soa) + 31) & ~(size_t) 31);
+    int best = strip_soa_best_isa();
+
+    printf("soa bench: %luHz, %d frame blocks, %.2fs of audio per run, best path %s\n",
+	   (unsigned long) sample_rate, block_frames, (double) frames / sample_rate, strip_soa_isa_name(best));
+    printf("%8s %8s %10s %9s %8s %8s %6s\n",
+	   "channels", "engine", "ms", "x real", "ns/smpl", "speedup", "match");
+
+    for (int count = 1; ; count = min(count * 2, max_channels)) {
+	double duration = (double) frames / sample_rate;
+	run_result scalar = run(count, 0, 0, frames);
+
+	printf("%8d %8s %10.1f %9.1f %8.2f %8s %6s\n",
+	       count, "kernel", scalar.seconds * 1000, duration / scalar.seconds,
+	       scalar.seconds * 1e9 / ((double) frames * count), "", "");
+	for (int isa = SOA_ISA_SCALAR; isa <= best; isa++) {
+	    run_result r = run(count, soa, isa, frames);
+	    printf("%8d %8s %10.1f %9.1f %8.2f %8.2f %6s\n",
+		   count, strip_soa_isa_name(isa), r.seconds * 1000, duration / r.seconds,
+		   r.seconds * 1e9 / ((double) frames * count), scalar.seconds / r.seconds,
+		   (r.sum == scalar.sum) ? "yes" : "NO");
+	}
+	if (count == max_channels) break;
+    }
+    free(soa);
+    return 0;
+}
@@ -0,0 +1,292 @@
+/* Strip SoA
+   The gather, the three vector paths and the per-strip stages.
+*/
+
+#include <string.h>
+#include "strip_soa.h"
+#include "dsp_platform.h"
+#include "meter.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SOA_X86
+#include <immintrin.h>
+#define SOA_TARGET_AVX2 __attribute__((target("avx2")))
+#define SOA_TARGET_SSE41 __attribute__((target("sse4.1")))
+#endif
+
+static const char *isa_names[SOA_ISAS] = {
+    "scalar",
+    "sse4.1",
+    "avx2"
+};
+
+int strip_soa_best_isa(void) {
+#ifdef SOA_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SOA_ISA_AVX2;
+    if (__builtin_cpu_supports("sse4.1")) return SOA_ISA_SSE41;
+#endif
+    return SOA_ISA_SCALAR;
+}
+
+const char *strip_soa_isa_name(int isa) {
+    return (isa >= 0 && isa < SOA_ISAS) ? isa_names[isa] : "?";
+}
+
+void strip_soa_init(strip_soa *s, channel_kernel **kernels, int lanes) {
+    memset(s, 0, sizeof(*s));
+    s->lanes = lanes;
+    s->isa = strip_soa_best_isa();
+    for (int l = 0; l < lanes; l++) {
+	s->kernel[l] = kernels[l];
+    }
+}
+
+// the kernels' parameters into the lane arrays, as
+// channel_process_float() reads them at the start of a block
+
+static void gather(strip_soa *s) {
+    for (int l = 0; l < s->lanes; l++) {
+	channel_kernel *k = s->kernel[l];
+	s->trim_gain[l] = k->trim_gain;
+	s->net_gain[l] = k->net_gain;
+	s->net_gain_now[l] = k->net_gain_now;
+	s->comp_mix[l] = k->comp_mix;
+	s->raw_mix[l] = k->raw_mix;
+	s->mixed[l] = k->mixed ? -1 : 0;
+	s->balance_l[l] = k->balance_l;
+	s->balance_r[l] = k->balance_r;
+	s->send1_gain[l] = k->send1_gain * 0.5f;
+	s->send2_gain[l] = k->send2_gain * 0.5f;
+    }
+}
+
+/* Each path runs lanes lo to hi - 1 over the block, leaving the
+ * outputs and sends in the rows, the input peaks in peak_in_l/r and
+ * the gains reached in net_gain_now.  The plain C path takes the
+ * lanes left over by the wider ones.
+ */
+
+static void lanes_scalar(strip_soa *s, int lo, int hi, size_t num_frames, bool sends) {
+    for (int l = lo; l < hi; l++) {
+	float trim_gain = s->trim_gain[l];
+	float net_gain = s->net_gain_now[l];
+	float gain_step = (s->net_gain[l] - net_gain) / (float) num_frames;
+	int32_t peak_in_l = 0;
+	int32_t peak_in_r = 0;
+
+	for (size_t f = 0; f < num_frames; f++) {
+	    int32_t word_l = s->in_l[f][l];
+	    int32_t word_r = s->in_r[f][l];
+	    peak_in_l = meter_max(peak_in_l, meter_abs(word_l));
+	    peak_in_r = meter_max(peak_in_r, meter_abs(word_r));
+
+	    net_gain += gain_step;
+	    float input_l = int2float(word_l) * trim_gain;
+	    float input_r = int2float(word_r) * trim_gain;
+	    float wordf_l = input_l * net_gain;
+	    float wordf_r = input_r * net_gain;
+	    if (s->mixed[l]) {
+		wordf_l = (s->comp_mix[l] * wordf_l) + (s->raw_mix[l] * input_l);
+		wordf_r = (s->comp_mix[l] * wordf_r) + (s->raw_mix[l] * input_r);
+	    }
+	    if (sends) {
+		float mono = wordf_l + wordf_r;
+		s->send_l[f][l] = float2int(mono * s->send1_gain[l]);
+		s->send_r[f][l] = float2int(mono * s->send2_gain[l]);
+	    }
+	    s->out_l[f][l] = float2int(wordf_l * s->balance_l[l]);
+	    s->out_r[f][l] = float2int(wordf_r * s->balance_r[l]);
+	}
+	s->peak_in_l[l] = peak_in_l;
+	s->peak_in_r[l] = peak_in_r;
+	s->net_gain_now[l] = s->net_gain[l];
+    }
+}
+
+#ifdef SOA_X86
+
+/* float2int(): round down, then saturate.  Truncating conversion of
+ * anything at or below -2^31 (and of NaN) already gives INT32_MIN, so
+ * only the top needs fixing.
+ */
+
+static inline SOA_TARGET_AVX2 __m256i float2int_avx2(__m256 x) {
+    __m256i r = _mm256_cvttps_epi32(_mm256_floor_ps(x));
+    __m256 over = _mm256_cmp_ps(x, _mm256_set1_ps(2147483648.0f), _CMP_GE_OQ);
+    return _mm256_blendv_epi8(r, _mm256_set1_epi32(INT32_MAX), _mm256_castps_si256(over));
+}
+
+static inline SOA_TARGET_AVX2 __m256i meter_abs_avx2(__m256i x) {
+    return _mm256_xor_si256(x, _mm256_srai_epi32(x, 31));
+}
+
+static SOA_TARGET_AVX2 int lanes_avx2(strip_soa *s, int lo, int hi, size_t num_frames, bool sends) {
+    __m256 frames = _mm256_set1_ps((float) num_frames);
+    int l;
+
+    for (l = lo; l + 8 <= hi; l += 8) {
+	__m256 trim_gain = _mm256_load_ps(&s->trim_gain[l]);
+	__m256 target_gain = _mm256_load_ps(&s->net_gain[l]);
+	__m256 net_gain = _mm256_load_ps(&s->net_gain_now[l]);
+	__m256 gain_step = _mm256_div_ps(_mm256_sub_ps(target_gain, net_gain), frames);
+	__m256 comp_mix = _mm256_load_ps(&s->comp_mix[l]);
+	__m256 raw_mix = _mm256_load_ps(&s->raw_mix[l]);
+	__m256 mixed = _mm256_castsi256_ps(_mm256_load_si256((const __m256i *) &s->mixed[l]));
+	__m256 balance_l = _mm256_load_ps(&s->balance_l[l]);
+	__m256 balance_r = _mm256_load_ps(&s->balance_r[l]);
+	__m256 send1_gain = _mm256_load_ps(&s->send1_gain[l]);
+	__m256 send2_gain = _mm256_load_ps(&s->send2_gain[l]);
+	__m256i peak_in_l = _mm256_setzero_si256();
+	__m256i peak_in_r = _mm256_setzero_si256();
+
+	for (size_t f = 0; f < num_frames; f++) {
+	    __m256i word_l = _mm256_load_si256((const __m256i *) &s->in_l[f][l]);
+	    __m256i word_r = _mm256_load_si256((const __m256i *) &s->in_r[f][l]);
+	    peak_in_l = _mm256_max_epi32(peak_in_l, meter_abs_avx2(word_l));
+	    peak_in_r = _mm256_max_epi32(peak_in_r, meter_abs_avx2(word_r));
+
+	    net_gain = _mm256_add_ps(net_gain, gain_step);
+	    __m256 input_l = _mm256_mul_ps(_mm256_cvtepi32_ps(word_l), trim_gain);
+	    __m256 input_r = _mm256_mul_ps(_mm256_cvtepi32_ps(word_r), trim_gain);
+	    __m256 wordf_l = _mm256_mul_ps(input_l, net_gain);
+	    __m256 wordf_r = _mm256_mul_ps(input_r, net_gain);
+	    __m256 mix_l = _mm256_add_ps(_mm256_mul_ps(comp_mix, wordf_l), _mm256_mul_ps(raw_mix, input_l));
+	    __m256 mix_r = _mm256_add_ps(_mm256_mul_ps(comp_mix, wordf_r), _mm256_mul_ps(raw_mix, input_r));
+	    wordf_l = _mm256_blendv_ps(wordf_l, mix_l, mixed);
+	    wordf_r = _mm256_blendv_ps(wordf_r, mix_r, mixed);
+	    if (sends) {
+		__m256 mono = _mm256_add_ps(wordf_l, wordf_r);
+		_mm256_store_si256((__m256i *) &s->send_l[f][l], float2int_avx2(_mm256_mul_ps(mono, send1_gain)));
+		_mm256_store_si256((__m256i *) &s->send_r[f][l], float2int_avx2(_mm256_mul_ps(mono, send2_gain)));
+	    }
+	    _mm256_store_si256((__m256i *) &s->out_l[f][l], float2int_avx2(_mm256_mul_ps(wordf_l, balance_l)));
+	    _mm256_store_si256((__m256i *) &s->out_r[f][l], float2int_avx2(_mm256_mul_ps(wordf_r, balance_r)));
+	}
+	_mm256_store_si256((__m256i *) &s->peak_in_l[l], peak_in_l);
+	_mm256_store_si256((__m256i *) &s->peak_in_r[l], peak_in_r);
+	_mm256_store_ps(&s->net_gain_now[l], target_gain);
+    }
+    return l;
+}
+
+static inline SOA_TARGET_SSE41 __m128i float2int_sse41(__m128 x) {
+    __m128i r = _mm_cvttps_epi32(_mm_floor_ps(x));
+    __m128 over = _mm_cmpge_ps(x, _mm_set1_ps(2147483648.0f));
+    return _mm_blendv_epi8(r, _mm_set1_epi32(INT32_MAX), _mm_castps_si128(over));
+}
+
+static inline SOA_TARGET_SSE41 __m128i meter_abs_sse41(__m128i x) {
+    return _mm_xor_si128(x, _mm_srai_epi32(x, 31));
+}
+
+static SOA_TARGET_SSE41 int lanes_sse41(strip_soa *s, int lo, int hi, size_t num_frames, bool sends) {
+    __m128 frames = _mm_set1_ps((float) num_frames);
+    int l;
+
+    for (l = lo; l + 4 <= hi; l += 4) {
+	__m128 trim_gain = _mm_load_ps(&s->trim_gain[l]);
+	__m128 target_gain = _mm_load_ps(&s->net_gain[l]);
+	__m128 net_gain = _mm_load_ps(&s->net_gain_now[l]);
+	__m128 gain_step = _mm_div_ps(_mm_sub_ps(target_gain, net_gain), frames);
+	__m128 comp_mix = _mm_load_ps(&s->comp_mix[l]);
+	__m128 raw_mix = _mm_load_ps(&s->raw_mix[l]);
+	__m128 mixed = _mm_castsi128_ps(_mm_load_si128((const __m128i *) &s->mixed[l]));
+	__m128 balance_l = _mm_load_ps(&s->balance_l[l]);
+	__m128 balance_r = _mm_load_ps(&s->balance_r[l]);
+	__m128 send1_gain = _mm_load_ps(&s->send1_gain[l]);
+	__m128 send2_gain = _mm_load_ps(&s->send2_gain[l]);
+	__m128i peak_in_l = _mm_setzero_si128();
+	__m128i peak_in_r = _mm_setzero_si128();
+
+	for (size_t f = 0; f < num_frames; f++) {
+	    __m128i word_l = _mm_load_si128((const __m128i *) &s->in_l[f][l]);
+	    __m128i word_r = _mm_load_si128((const __m128i *) &s->in_r[f][l]);
+	    peak_in_l = _mm_max_epi32(peak_in_l, meter_abs_sse41(word_l));
+	    peak_in_r = _mm_max_epi32(peak_in_r, meter_abs_sse41(word_r));
+
+	    net_gain = _mm_add_ps(net_gain, gain_step);
+	    __m128 input_l = _mm_mul_ps(_mm_cvtepi32_ps(word_l), trim_gain);
+	    __m128 input_r = _mm_mul_ps(_mm_cvtepi32_ps(word_r), trim_gain);
+	    __m128 wordf_l = _mm_mul_ps(input_l, net_gain);
+	    __m128 wordf_r = _mm_mul_ps(input_r, net_gain);
+	    __m128 mix_l = _mm_add_ps(_mm_mul_ps(comp_mix, wordf_l), _mm_mul_ps(raw_mix, input_l));
+	    __m128 mix_r = _mm_add_ps(_mm_mul_ps(comp_mix, wordf_r), _mm_mul_ps(raw_mix, input_r));
+	    wordf_l = _mm_blendv_ps(wordf_l, mix_l, mixed);
+	    wordf_r = _mm_blendv_ps(wordf_r, mix_r, mixed);
+	    if (sends) {
+		__m128 mono = _mm_add_ps(wordf_l, wordf_r);
+		_mm_store_si128((__m128i *) &s->send_l[f][l], float2int_sse41(_mm_mul_ps(mono, send1_gain)));
+		_mm_store_si128((__m128i *) &s->send_r[f][l], float2int_sse41(_mm_mul_ps(mono, send2_gain)));
+	    }
+	    _mm_store_si128((__m128i *) &s->out_l[f][l], float2int_sse41(_mm_mul_ps(wordf_l, balance_l)));
+	    _mm_store_si128((__m128i *) &s->out_r[f][l], float2int_sse41(_mm_mul_ps(wordf_r, balance_r)));
+	}
+	_mm_store_si128((__m128i *) &s->peak_in_l[l], peak_in_l);
+	_mm_store_si128((__m128i *) &s->peak_in_r[l], peak_in_r);
+	_mm_store_ps(&s->net_gain_now[l], target_gain);
+    }
+    return l;
+}
+
+#endif
+
+/* The transposes walk the rows in order, reading (or writing) every
+ * strip's block a frame at a time, so each strip's block is a stream
+ * of its own rather than a stride across the rows.
+ */
+
+void strip_soa_process(strip_soa *s, const int32_t *const *inputs, int32_t **outputs, int32_t **sends, size_t num_frames) {
+    int lanes = s->lanes;
+    int l = 0;
+
+    gather(s);
+    for (size_t f = 0; f < num_frames; f++) {
+	for (l = 0; l < lanes; l++) {
+	    s->in_l[f][l] = inputs[l][f * 2];
+	    s->in_r[f][l] = inputs[l][f * 2 + 1];
+	}
+    }
+
+    l = 0;
+#ifdef SOA_X86
+    if (s->isa == SOA_ISA_AVX2) {
+	l = lanes_avx2(s, 0, lanes, num_frames, sends != 0);
+    }
+    if (s->isa >= SOA_ISA_SSE41) {
+	l = lanes_sse41(s, l, lanes, num_frames, sends != 0);
+    }
+#endif
+    lanes_scalar(s, l, lanes, num_frames, sends != 0);
+
+    for (size_t f = 0; f < num_frames; f++) {
+	for (l = 0; l < lanes; l++) {
+	    outputs[l][f * 2] = s->out_l[f][l];
+	    outputs[l][f * 2 + 1] = s->out_r[f][l];
+	}
+    }
+    if (sends) {
+	for (size_t f = 0; f < num_frames; f++) {
+	    for (l = 0; l < lanes; l++) {
+		sends[l][f * 2] = s->send_l[f][l];
+		sends[l][f * 2 + 1] = s->send_r[f][l];
+	    }
+	}
+    }
+
+    for (l = 0; l < lanes; l++) {
+	channel_kernel *k = s->kernel[l];
+	int32_t *output = outputs[l];
+	int32_t peak_out_l = 0;
+	int32_t peak_out_r = 0;
+
+	biquad_process(&k->filter, output, num_frames);
+	limiter_process(&k->limiter, output, num_frames);
+	for (size_t i = 0; i < num_frames * 2; i += 2) {
+	    peak_out_l = meter_max(peak_out_l, meter_abs(output[i]));
+	    peak_out_r = meter_max(peak_out_r, meter_abs(output[i+1]));
+	}
+	k->net_gain_now = s->net_gain_now[l];
+	meter_publish(&k->meter, s->peak_in_l[l], s->peak_in_r[l], peak_out_l, peak_out_r);
+    }
+}
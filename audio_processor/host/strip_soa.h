@@ -0,0 +1,89 @@
+/* Strip SoA
+   Many channel strips run at once on the host, each strip a lane of
+   the workstation's vector registers: AVX2 (8 lanes) or SSE4.1 (4
+   lanes), chosen at run time, with a plain C fallback.
+
+   The strips are channel_kernels, driven by the control side through
+   the usual setters.  Each block the engine gathers their parameters
+   into aligned arrays, one per parameter indexed by lane, and
+   transposes the inputs so that a frame of every strip is one row.
+   The trim, net gain ramp, output mix, sends and balance of
+   channel_process_float() then run down the rows a vector of lanes
+   at a time.  The filters, limiter and metering stay per strip, run
+   on each strip's block once it is transposed back: they carry
+   history per strip and the limiter branches on every sample.
+
+   The vector paths do the same float operations in the same order as
+   channel_process_float(), with no fused multiply-adds, and round
+   down and saturate like float2int(), so each strip's output matches
+   the scalar kernel's bit for bit.
+
+   strip_soa holds the transposed block, so allocate it 32 byte
+   aligned (aligned_alloc or static).
+*/
+
+#ifndef __STRIP_SOA__
+#define __STRIP_SOA__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "i2s.h"
+#include "channel_kernel.h"
+
+#define SOA_MAX_LANES 64
+#define SOA_ALIGNED __attribute__((aligned(32)))
+
+// vector paths, in order of preference
+enum {
+    SOA_ISA_SCALAR,
+    SOA_ISA_SSE41,
+    SOA_ISA_AVX2,
+    SOA_ISAS
+};
+
+typedef struct strip_soa {
+    int lanes;
+    int isa;                  // path in use, at most strip_soa_best_isa()
+    channel_kernel *kernel[SOA_MAX_LANES];
+
+    // kernel parameters by lane, gathered each block
+    float trim_gain[SOA_MAX_LANES] SOA_ALIGNED;
+    float net_gain[SOA_MAX_LANES] SOA_ALIGNED;
+    float net_gain_now[SOA_MAX_LANES] SOA_ALIGNED;
+    float comp_mix[SOA_MAX_LANES] SOA_ALIGNED;
+    float raw_mix[SOA_MAX_LANES] SOA_ALIGNED;
+    int32_t mixed[SOA_MAX_LANES] SOA_ALIGNED;     // all ones if mixed, else 0
+    float balance_l[SOA_MAX_LANES] SOA_ALIGNED;
+    float balance_r[SOA_MAX_LANES] SOA_ALIGNED;
+    float send1_gain[SOA_MAX_LANES] SOA_ALIGNED;  // halved for the mono sum
+    float send2_gain[SOA_MAX_LANES] SOA_ALIGNED;
+    int32_t peak_in_l[SOA_MAX_LANES] SOA_ALIGNED;
+    int32_t peak_in_r[SOA_MAX_LANES] SOA_ALIGNED;
+
+    // the block, a row of lanes per frame
+    int32_t in_l[I2S_MAX_BLOCK_FRAMES][SOA_MAX_LANES] SOA_ALIGNED;
+    int32_t in_r[I2S_MAX_BLOCK_FRAMES][SOA_MAX_LANES] SOA_ALIGNED;
+    int32_t out_l[I2S_MAX_BLOCK_FRAMES][SOA_MAX_LANES] SOA_ALIGNED;
+    int32_t out_r[I2S_MAX_BLOCK_FRAMES][SOA_MAX_LANES] SOA_ALIGNED;
+    int32_t send_l[I2S_MAX_BLOCK_FRAMES][SOA_MAX_LANES] SOA_ALIGNED;
+    int32_t send_r[I2S_MAX_BLOCK_FRAMES][SOA_MAX_LANES] SOA_ALIGNED;
+} strip_soa;
+
+// the widest path this CPU runs
+int strip_soa_best_isa(void);
+
+const char *strip_soa_isa_name(int isa);
+
+// kernels[0] to kernels[lanes - 1] as the lanes, already initialized,
+// on the best path
+void strip_soa_init(strip_soa *s, channel_kernel **kernels, int lanes);
+
+/* One block of num_frames (up to I2S_MAX_BLOCK_FRAMES) interleaved
+ * stereo frames through every lane, as channel_process_float() on
+ * each kernel would: inputs[lane] to outputs[lane], and the sends to
+ * sends[lane] if sends isn't null.
+ */
+void strip_soa_process(strip_soa *s, const int32_t *const *inputs, int32_t **outputs, int32_t **sends, size_t num_frames);
+
+#endif
@@ -0,0 +1,185 @@
+/* WAV
+   Minimal RIFF/WAVE reader and writer for the host tools.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "wav.h"
+
+#define WAV_FORMAT_PCM 1
+#define WAV_FORMAT_FLOAT 3
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE
+
+static uint16_t get16(const uint8_t *p) {
+    return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+static uint32_t get32(const uint8_t *p) {
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static void put16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = v >> 24;
+}
+
+static int32_t float_to_q31(float f) {
+    double d = (double) f * 2147483648.0;
+    if (d >= 2147483647.0) return INT32_MAX;
+    if (d <= -2147483648.0) return INT32_MIN;
+    return (int32_t) lrint(d);
+}
+
+static uint8_t *read_file(const char *path, size_t *len, char *err) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+	snprintf(err, 128, "can't open %s", path);
+	return 0;
+    }
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *buf = malloc(*len);
+    if (!buf || fread(buf, 1, *len, f) != *len) {
+	snprintf(err, 128, "can't read %s", path);
+	free(buf);
+	fclose(f);
+	return 0;
+    }
+    fclose(f);
+    return buf;
+}
+
+bool wav_read(const char *path, wav *w, char *err) {
+    size_t len;
+    uint8_t *buf = read_file(path, &len, err);
+    if (!buf) return false;
+
+    memset(w, 0, sizeof(wav));
+    if (len < 12 || memcmp(buf, "RIFF", 4) || memcmp(buf + 8, "WAVE", 4)) {
+	snprintf(err, 128, "%s is not a WAV file", path);
+	free(buf);
+	return false;
+    }
+
+    uint16_t format = 0;
+    const uint8_t *data = 0;
+    size_t data_len = 0;
+    size_t pos = 12;
+    while (pos + 8 <= len) {
+	uint32_t size = get32(buf + pos + 4);
+	const uint8_t *chunk = buf + pos + 8;
+	if (size > len - pos - 8) size = len - pos - 8;
+	if (!memcmp(buf + pos, "fmt ", 4) && size >= 16) {
+	    format = get16(chunk);
+	    w->channels = get16(chunk + 2);
+	    w->sample_rate = get32(chunk + 4);
+	    w->bits = get16(chunk + 14);
+	    if (format == WAV_FORMAT_EXTENSIBLE && size >= 26) {
+		format = get16(chunk + 24);  // first two bytes of the sub format GUID
+	    }
+	} else if (!memcmp(buf + pos, "data", 4)) {
+	    data = chunk;
+	    data_len = size;
+	}
+	pos += 8 + size + (size & 1);
+    }
+
+    w->is_float = (format == WAV_FORMAT_FLOAT);
+    if (!data || !(format == WAV_FORMAT_PCM || format == WAV_FORMAT_FLOAT)
+	|| (w->channels != 1 && w->channels != 2)
+	|| (w->is_float && w->bits != 32)
+	|| (!w->is_float && w->bits != 16 && w->bits != 24 && w->bits != 32)) {
+	snprintf(err, 128, "%s: unsupported format (%d, %d channels, %d bits)", path, format, w->channels, w->bits);
+	free(buf);
+	return false;
+    }
+
+    size_t bytes = w->bits / 8;
+    w->frames = data_len / (bytes * w->channels);
+    w->samples = malloc(w->frames * w->channels * sizeof(int32_t) + 1);
+    for (size_t i = 0; i < w->frames * w->channels; i++) {
+	const uint8_t *p = data + i * bytes;
+	switch (bytes) {
+	case 2:
+	    w->samples[i] = (int32_t) ((uint32_t) get16(p) << 16);
+	    break;
+	case 3:
+	    w->samples[i] = (int32_t) (((uint32_t) p[0] << 8) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 24));
+	    break;
+	default:
+	    if (w->is_float) {
+		float f;
+		uint32_t u = get32(p);
+		memcpy(&f, &u, sizeof(f));
+		w->samples[i] = float_to_q31(f);
+	    } else {
+		w->samples[i] = (int32_t) get32(p);
+	    }
+	}
+    }
+    free(buf);
+    return true;
+}
+
+bool wav_write(const char *path, const wav *w, char *err) {
+    size_t bytes = w->bits / 8;
+    if (w->is_float || (bytes != 2 && bytes != 3 && bytes != 4)) {
+	snprintf(err, 128, "can't write %d bit WAV files", w->bits);
+	return false;
+    }
+    size_t data_len = w->frames * w->channels * bytes;
+    uint8_t *buf = malloc(44 + data_len);
+
+    memcpy(buf, "RIFF", 4);
+    put32(buf + 4, (uint32_t) (36 + data_len));
+    memcpy(buf + 8, "WAVEfmt ", 8);
+    put32(buf + 16, 16);
+    put16(buf + 20, WAV_FORMAT_PCM);
+    put16(buf + 22, w->channels);
+    put32(buf + 24, w->sample_rate);
+    put32(buf + 28, (uint32_t) (w->sample_rate * w->channels * bytes));
+    put16(buf + 32, (uint16_t) (w->channels * bytes));
+    put16(buf + 34, w->bits);
+    memcpy(buf + 36, "data", 4);
+    put32(buf + 40, (uint32_t) data_len);
+
+    uint8_t *p = buf + 44;
+    for (size_t i = 0; i < w->frames * w->channels; i++) {
+	uint32_t u = (uint32_t) w->samples[i];
+	switch (bytes) {
+	case 2:
+	    put16(p, u >> 16);
+	    break;
+	case 3:
+	    p[0] = (u >> 8) & 0xff;
+	    p[1] = (u >> 16) & 0xff;
+	    p[2] = u >> 24;
+	    break;
+	default:
+	    put32(p, u);
+	}
+	p += bytes;
+    }
+
+    FILE *f = fopen(path, "wb");
+    bool ok = f && fwrite(buf, 1, 44 + data_len, f) == 44 + data_len;
+    if (f) fclose(f);
+    if (!ok) snprintf(err, 128, "can't write %s", path);
+    free(buf);
+    return ok;
+}
+
+void wav_free(wav *w) {
+    free(w->samples);
+    w->samples = 0;
+}
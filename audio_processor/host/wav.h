@@ -0,0 +1,33 @@
+/* WAV
+   Minimal RIFF/WAVE reader and writer for the host tools.
+
+   Reads 16, 24 and 32 bit integer PCM and 32 bit float, mono or
+   stereo, plain or WAVE_FORMAT_EXTENSIBLE.  Samples are held as Q31
+   words, left justified like the codec delivers them, interleaved by
+   channel.  Writes 16, 24 or 32 bit integer PCM, truncating the Q31
+   words to the output width.
+*/
+
+#ifndef __WAV__
+#define __WAV__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct wav {
+    uint32_t sample_rate;
+    uint16_t channels;
+    uint16_t bits;            // bits per sample in the file
+    bool is_float;
+    size_t frames;
+    int32_t *samples;         // frames * channels Q31 words
+} wav;
+
+// false with a message in err (at least 128 chars) on failure
+bool wav_read(const char *path, wav *w, char *err);
+bool wav_write(const char *path, const wav *w, char *err);
+
+void wav_free(wav *w);
+
+#endif
@@ -25,13 +25,15 @@
 #include "hardware/clocks.h"
 #include "hardware/dma.h"
 #include "hardware/irq.h"
+#include "pico/time.h"
 #include "i2s.pio.h"
+#include "sram_banks.h"
 
 // gp 10 sysclock
 // gp 9 word clock
 // gp 8 bit clock
 
-const i2s_config i2s_config_default = {48000, 256, 32, 10, 6, 7, 8, true, 25};
+const i2s_config i2s_config_default = {AUDIO_SAMPLE_RATE, 256, 32, 10, 6, 7, 8, true, 25, AUDIO_BUFFER_FRAMES, AUDIO_RING_BLOCKS};
 
 static float pio_div(float freq, uint16_t* div, uint8_t* frac) {
     float clk   = (float)clock_get_hz(clk_sys);
@@ -76,25 +78,32 @@ static bool validate_sck_bck_sync(pio_i2s_clocks* clocks) {
 
 
 
-static void dma_double_buffer_init(pio_i2s* i2s, void (*dma_handler)(void)) {
-    // Set up DMA for PIO I2s - two channels, in and out
-    i2s->dma_ch_in_ctrl  = dma_claim_unused_channel(true);
-    i2s->dma_ch_out_ctrl = dma_claim_unused_channel(true);
-    i2s->dma_ch_out_data = dma_claim_unused_channel(true);
-    i2s->dma_ch_in_data  = dma_claim_unused_channel(true);
-    
-    // Control blocks support double-buffering with interrupts on buffer change
-    i2s->in_ctrl_blocks[0]  = i2s->input_buffer;
-    i2s->in_ctrl_blocks[1]  = &i2s->input_buffer[STEREO_BUFFER_SIZE];
-    i2s->out_ctrl_blocks[0] = i2s->output_buffer;
-    i2s->out_ctrl_blocks[1] = &i2s->output_buffer[STEREO_BUFFER_SIZE];
+// log2 of the size in bytes of a control block ring, for the DMA wrap
+
+static uint ring_bits(uint8_t ring_blocks) {
+    uint bits = 0;
+    while ((1u << bits) < ring_blocks * sizeof(int32_t*)) {
+	bits++;
+    }
+    return bits;
+}
+
+static void dma_ring_configure(pio_i2s* i2s) {
+    uint words = i2s->block_frames * 2;
+
+    // Control blocks point the data channels at each block of the ring
+    // in turn, with an interrupt as each input block completes
+    for (uint8_t b = 0; b < i2s->ring_blocks; b++) {
+	i2s->in_ctrl_blocks[b]  = &i2s->input_buffer[b * words];
+	i2s->out_ctrl_blocks[b] = &i2s->output_buffer[b * words];
+    }
     
-    // DMA I2S OUT control channel - wrap read address every 8 bytes (2 words)
+    // DMA I2S OUT control channel - wrap read address around the ring
     // Transfer 1 word at a time, to the out channel read address and trigger.
     dma_channel_config c = dma_channel_get_default_config(i2s->dma_ch_out_ctrl);
     channel_config_set_read_increment(&c, true);
     channel_config_set_write_increment(&c, false);
-    channel_config_set_ring(&c, false, 3);
+    channel_config_set_ring(&c, false, ring_bits(i2s->ring_blocks));
     channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
     dma_channel_configure(i2s->dma_ch_out_ctrl,
 			  &c,
@@ -113,7 +122,7 @@ static void dma_double_buffer_init(pio_i2s* i2s, void (*dma_handler)(void)) {
                           &c,
                           &i2s->pio->txf[i2s->sm_dout],  // Destination pointer
                           NULL,                          // Source pointer, will be set by ctrl channel
-                          STEREO_BUFFER_SIZE,            // Number of transfers
+                          words,                         // Number of transfers
                           false                          // Start immediately
     );
 
@@ -123,7 +132,7 @@ static void dma_double_buffer_init(pio_i2s* i2s, void (*dma_handler)(void)) {
     c = dma_channel_get_default_config(i2s->dma_ch_in_ctrl);
     channel_config_set_read_increment(&c, true);
     channel_config_set_write_increment(&c, false);
-    channel_config_set_ring(&c, false, 3);
+    channel_config_set_ring(&c, false, ring_bits(i2s->ring_blocks));
     channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
     dma_channel_configure(i2s->dma_ch_in_ctrl, &c, &dma_hw->ch[i2s->dma_ch_in_data].al2_write_addr_trig, i2s->in_ctrl_blocks, 1, false);
 
@@ -132,18 +141,39 @@ static void dma_double_buffer_init(pio_i2s* i2s, void (*dma_handler)(void)) {
     channel_config_set_write_increment(&c, true);
     channel_config_set_chain_to(&c, i2s->dma_ch_in_ctrl);
     channel_config_set_dreq(&c, pio_get_dreq(i2s->pio, i2s->sm_din, false));
+    channel_config_set_sniff_enable(&c, i2s->sniff);
 
     dma_channel_configure(i2s->dma_ch_in_data,
                           &c,
                           NULL,                         // Will be set by ctrl chan
                           &i2s->pio->rxf[i2s->sm_din],  // Source pointer
-                          STEREO_BUFFER_SIZE,           // Number of transfers
+                          words,                        // Number of transfers
                           false                         // Don't start yet
     );
 
     // Input channel triggers the DMA interrupt handler, hopefully these stay
     // in perfect sync with the output.
     dma_channel_set_irq0_enabled(i2s->dma_ch_in_data, true);
+}
+
+// each ring in a bank of its own, so the DMA and the interrupt meet
+// on the bus only over the block being handed between them
+
+static int32_t input_ring[I2S_RING_WORDS] SRAM_BANK(0);
+static int32_t output_ring[I2S_RING_WORDS] SRAM_BANK(1);
+static int32_t send1_ring[I2S_RING_WORDS] SRAM_BANK(2);
+
+static void dma_ring_init(pio_i2s* i2s, void (*dma_handler)(void)) {
+    i2s->input_buffer = input_ring;
+    i2s->output_buffer = output_ring;
+
+    // Set up DMA for PIO I2s - two channels, in and out
+    i2s->dma_ch_in_ctrl  = dma_claim_unused_channel(true);
+    i2s->dma_ch_out_ctrl = dma_claim_unused_channel(true);
+    i2s->dma_ch_out_data = dma_claim_unused_channel(true);
+    i2s->dma_ch_in_data  = dma_claim_unused_channel(true);
+
+    dma_ring_configure(i2s);
     irq_set_exclusive_handler(DMA_IRQ_0, dma_handler);
     irq_set_enabled(DMA_IRQ_0, true);
 
@@ -152,23 +182,23 @@ static void dma_double_buffer_init(pio_i2s* i2s, void (*dma_handler)(void)) {
     // Enable all the dma channels
     dma_channel_start(i2s->dma_ch_out_ctrl);  // This will trigger-start the out chan
     dma_channel_start(i2s->dma_ch_in_ctrl);   // This will trigger-start the in chan
-    dma_channel_start(i2s->dma_ch_send1_ctrl);
 }
 
-// DMA I2S Sends setup
+// DMA I2S Sends setup - the same ring as the output, paced by the send
+// state machine, with no interrupt of its own: the input interrupt
+// fills the send block along with the output block
 
-static void dma_double_buffer_send_init(pio_i2s* i2s, void (*dma_handler)(void)) {
-    
-    i2s->dma_ch_send1_ctrl = dma_claim_unused_channel(true);
-    i2s->dma_ch_send1_data = dma_claim_unused_channel(true);
+static void dma_send_ring_configure(pio_i2s* i2s) {
+    uint words = i2s->block_frames * 2;
 
-    i2s->send1_ctrl_blocks[0] = i2s->send1_buffer;
-    i2s->send1_ctrl_blocks[1] = &i2s->send1_buffer[STEREO_BUFFER_SIZE];
+    for (uint8_t b = 0; b < i2s->ring_blocks; b++) {
+	i2s->send1_ctrl_blocks[b] = &i2s->send1_buffer[b * words];
+    }
 
     dma_channel_config c = dma_channel_get_default_config(i2s->dma_ch_send1_ctrl);
     channel_config_set_read_increment(&c, true);
     channel_config_set_write_increment(&c, false);
-    channel_config_set_ring(&c, false, 3);
+    channel_config_set_ring(&c, false, ring_bits(i2s->ring_blocks));
     channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
     dma_channel_configure(i2s->dma_ch_send1_ctrl,
 			  &c,
@@ -187,15 +217,99 @@ static void dma_double_buffer_send_init(pio_i2s* i2s, void (*dma_handler)(void))
                           &c,
                           &i2s->spio->txf[i2s->sm_send1],  // Destination pointer
                           NULL,                          // Source pointer, will be set by ctrl channel
-                          STEREO_BUFFER_SIZE,            // Number of transfers
+                          words,                         // Number of transfers
                           false                          // Start immediately
     );
+}
 
-    dma_channel_set_irq1_enabled(i2s->dma_ch_send1_data, true);
-    irq_set_exclusive_handler(DMA_IRQ_1, dma_handler);
-    irq_set_enabled(DMA_IRQ_1, true);
-    
-    
+static void dma_send_ring_init(pio_i2s* i2s) {
+    i2s->send1_buffer = send1_ring;
+    i2s->dma_ch_send1_ctrl = dma_claim_unused_channel(true);
+    i2s->dma_ch_send1_data = dma_claim_unused_channel(true);
+
+    dma_send_ring_configure(i2s);
+    dma_channel_start(i2s->dma_ch_send1_ctrl);
+}
+
+// stop a data channel and the control channel feeding it.  The data
+// channel is unchained first, so the abort can't restart it through the
+// control channel.
+
+static void dma_chain_abort(uint ctrl_ch, uint data_ch) {
+    dma_channel_config c = dma_get_channel_config(data_ch);
+    channel_config_set_chain_to(&c, data_ch);
+    dma_channel_set_config(data_ch, &c, false);
+    dma_channel_abort(ctrl_ch);
+    dma_channel_abort(data_ch);
+}
+
+bool i2s_set_blocks(pio_i2s* i2s, uint16_t block_frames, uint8_t ring_blocks) {
+    if (!i2s_blocks_valid(block_frames, ring_blocks)) {
+	return false;
+    }
+    // stop the state machines, so the DMA stops with them, and let any
+    // interrupt already raised finish its block
+    pio_set_sm_mask_enabled(i2s->pio, i2s->sm_mask, false);
+    dma_channel_set_irq0_enabled(i2s->dma_ch_in_data, false);
+    sleep_us((2000000 * i2s->block_frames) / i2s->config.fs);
+
+    dma_chain_abort(i2s->dma_ch_out_ctrl, i2s->dma_ch_out_data);
+    dma_chain_abort(i2s->dma_ch_in_ctrl, i2s->dma_ch_in_data);
+    dma_hw->ints0 = 1u << i2s->dma_ch_in_data;
+    if (i2s->sends) {
+	pio_set_sm_mask_enabled(i2s->spio, i2s->sm_mask1, false);
+	dma_chain_abort(i2s->dma_ch_send1_ctrl, i2s->dma_ch_send1_data);
+	// leave the bit clock low, as at power up, for the send state
+	// machine to wait on
+	pio_sm_set_pins_with_mask(i2s->pio, i2s->sm_dout, 0, 3u << i2s->config.clock_pin_base);
+    }
+
+    i2s->block_frames = block_frames;
+    i2s->ring_blocks = ring_blocks;
+    for (uint i = 0; i < I2S_RING_WORDS; i++) {
+	i2s->output_buffer[i] = 0;
+	if (i2s->sends) i2s->send1_buffer[i] = 0;
+    }
+    dma_ring_configure(i2s);
+    if (i2s->sends) {
+	dma_send_ring_configure(i2s);
+	pio_sm_clear_fifos(i2s->spio, i2s->sm_send1);
+	pio_sm_restart(i2s->spio, i2s->sm_send1);
+	pio_sm_exec(i2s->spio, i2s->sm_send1, pio_encode_jmp(i2s->offset_send));
+	dma_channel_start(i2s->dma_ch_send1_ctrl);
+	pio_sm_set_enabled(i2s->spio, i2s->sm_send1, true);
+    }
+
+    // back to the start of the programs, then start everything together
+    // as at power up, so the words line up with the frames again
+    for (uint sm = 0; sm < 4; sm++) {
+	if (i2s->sm_mask & (1u << sm)) {
+	    pio_sm_clear_fifos(i2s->pio, sm);
+	    pio_sm_restart(i2s->pio, sm);
+	}
+    }
+    if (i2s->config.sck_enable) {
+	pio_sm_exec(i2s->pio, i2s->sm_sck, pio_encode_jmp(i2s->offset_sck));
+    }
+    pio_sm_exec(i2s->pio, i2s->sm_din, pio_encode_jmp(i2s->offset_din));
+    if (i2s->sm_dout != i2s->sm_din) {
+	pio_sm_exec(i2s->pio, i2s->sm_dout, pio_encode_jmp(i2s->offset_dout));
+    }
+    dma_channel_start(i2s->dma_ch_out_ctrl);
+    dma_channel_start(i2s->dma_ch_in_ctrl);
+    pio_enable_sm_mask_in_sync(i2s->pio, i2s->sm_mask);
+    return true;
+}
+
+// the sniffer watches one channel at a time, and only the input uses it
+
+void i2s_sniff_input(pio_i2s* i2s, bool crc) {
+    i2s->sniff = true;
+    i2s->sniff_crc = crc;
+    dma_sniffer_enable(i2s->dma_ch_in_data,
+		       crc ? DMA_SNIFF_CTRL_CALC_VALUE_CRC32 : DMA_SNIFF_CTRL_CALC_VALUE_SUM,
+		       true);
+    dma_hw->sniff_data = 0;
 }
 
 /* Initializes an I2S block (of 3 state machines) on the designated PIO.
@@ -215,6 +329,7 @@ static void i2s_slave_program_init(PIO pio, const i2s_config* config, pio_i2s* i
         i2s->sm_sck = pio_claim_unused_sm(pio, true);
         i2s->sm_mask |= (1u << i2s->sm_sck);
         offset = pio_add_program(pio, &i2s_sck_program);
+        i2s->offset_sck = offset;
         i2s_sck_program_init(pio, i2s->sm_sck, offset, config->sck_pin);
         pio_sm_set_clkdiv_int_frac(pio, i2s->sm_sck, clocks.sck_d, clocks.sck_f);
     }
@@ -224,6 +339,8 @@ static void i2s_slave_program_init(PIO pio, const i2s_config* config, pio_i2s* i
     i2s->sm_dout = i2s->sm_din;
     i2s->sm_mask |= (1u << i2s->sm_din);
     offset = pio_add_program(pio, &i2s_bidi_slave_program);
+    i2s->offset_din = offset;
+    i2s->offset_dout = offset;
     i2s_bidi_slave_program_init(pio, i2s->sm_din, offset, config->dout_pin, config->din_pin);
     pio_sm_set_clkdiv_int_frac(pio, i2s->sm_din, clocks.sck_d, clocks.sck_f);
 }
@@ -251,11 +368,16 @@ static void i2s_sync_program_init(PIO pio, const i2s_config* config, pio_i2s* i2
              */
             panic("SCK and BCK are not in sync.");
         }
+        if (clocks.fs_attained != (float)config->fs) {
+            printf("WARNING: fs is %f, not %lu - the system clock doesn't divide to it exactly\n",
+                   clocks.fs_attained, config->fs);
+        }
 
         // SCK block
         i2s->sm_sck = pio_claim_unused_sm(pio, true);
         i2s->sm_mask |= (1u << i2s->sm_sck);
         offset = pio_add_program(pio, &i2s_sck_program);
+        i2s->offset_sck = offset;
 	printf("sck offset: %d\n",offset);
         i2s_sck_program_init(pio, i2s->sm_sck, offset, config->sck_pin);
         pio_sm_set_clkdiv_int_frac(pio, i2s->sm_sck, clocks.sck_d, clocks.sck_f);
@@ -265,6 +387,7 @@ static void i2s_sync_program_init(PIO pio, const i2s_config* config, pio_i2s* i2
     i2s->sm_din = pio_claim_unused_sm(pio, true);
     i2s->sm_mask |= (1u << i2s->sm_din);
     offset = pio_add_program(pio, &i2s_in_slave_program);
+    i2s->offset_din = offset;
     printf("in block offset: %d\n",offset);
     i2s_in_slave_program_init(pio, i2s->sm_din, offset, config->din_pin);
     pio_sm_set_clkdiv_int_frac(pio, i2s->sm_din, clocks.sck_d, clocks.sck_f);
@@ -273,6 +396,7 @@ static void i2s_sync_program_init(PIO pio, const i2s_config* config, pio_i2s* i2
     i2s->sm_dout = pio_claim_unused_sm(pio, true);
     i2s->sm_mask |= (1u << i2s->sm_dout);
     offset = pio_add_program(pio, &i2s_out_master_program);
+    i2s->offset_dout = offset;
     printf("out offset: %d\n",offset);
     i2s_out_master_program_init(pio, i2s->sm_dout, offset, config->bit_depth, config->dout_pin, config->clock_pin_base);
     pio_sm_set_clkdiv_int_frac(pio, i2s->sm_dout, clocks.bck_d, clocks.bck_f);
@@ -293,38 +417,62 @@ static void i2s_send_program_init(PIO pio, const i2s_config* config, pio_i2s* i2
     i2s->sm_send1 = pio_claim_unused_sm(i2s->spio, true);
     i2s->sm_mask1 |= (1u << i2s->sm_send1);
     offset = pio_add_program(i2s->spio, &i2s_out_send_program);
+    i2s->offset_send = offset;
     printf("send 1 offset: %d\n",offset);
     
-    i2s_out_send_program_init(i2s->spio, i2s->sm_send1, offset, config->bit_depth, config->send1_pin, config->clock_pin_base);
+    // the clocks are read from the input block's pins: din, bck, lrck
+    i2s_out_send_program_init(i2s->spio, i2s->sm_send1, offset, config->bit_depth, config->send1_pin, config->din_pin);
     pio_sm_set_clkdiv_int_frac(i2s->spio, i2s->sm_send1, clocks.sck_d, clocks.sck_f);  // clock at 4x bit clock
 }
 
 void i2s_program_start_slaved(PIO pio, const i2s_config* config, void (*dma_handler)(void), pio_i2s* i2s) {
-    if (((uint32_t)i2s & 0x7) != 0) {
-        panic("pio_i2s argument must be 8-byte aligned!");
+    if (((uint32_t)i2s & 0x1f) != 0) {
+        panic("pio_i2s argument must be 32-byte aligned!");
+    }
+    if (!i2s_blocks_valid(config->block_frames, config->ring_blocks)) {
+        panic("invalid DMA block size or ring depth");
     }
+    i2s->config       = *config;
+    i2s->block_frames = config->block_frames;
+    i2s->ring_blocks  = config->ring_blocks;
     i2s_slave_program_init(pio, config, i2s);
-    dma_double_buffer_init(i2s, dma_handler);
+    dma_ring_init(i2s, dma_handler);
     pio_enable_sm_mask_in_sync(i2s->pio, i2s->sm_mask);
 }
 
 void i2s_program_start_synched(PIO pio, const i2s_config* config, void (*dma_handler)(void), pio_i2s* i2s) {
-    if (((uint32_t)i2s & 0x7) != 0) {
-        panic("pio_i2s argument must be 8-byte aligned!");
+    if (((uint32_t)i2s & 0x1f) != 0) {
+        panic("pio_i2s argument must be 32-byte aligned!");
     }
+    if (!i2s_blocks_valid(config->block_frames, config->ring_blocks)) {
+        panic("invalid DMA block size or ring depth");
+    }
+    i2s->config       = *config;
+    i2s->block_frames = config->block_frames;
+    i2s->ring_blocks  = config->ring_blocks;
     i2s_sync_program_init(pio, config, i2s);
-    dma_double_buffer_init(i2s, dma_handler);
+    dma_ring_init(i2s, dma_handler);
+    if (i2s->sends) {
+	// waits for the first bit clock, so it starts on the same frame
+	pio_sm_set_enabled(i2s->spio, i2s->sm_send1, true);
+    }
     pio_enable_sm_mask_in_sync(i2s->pio, i2s->sm_mask);
-    pio_enable_sm_mask_in_sync(i2s->spio, i2s->sm_mask1);
 }
 
-void i2s_program_start_sends(PIO pio, const i2s_config* config, void (*dma_handler)(void), pio_i2s* i2s) {
-    if (((uint32_t)i2s & 0x7) != 0) {
-        panic("pio_i2s argument must be 8-byte aligned!");
+void i2s_program_start_sends(PIO pio, const i2s_config* config, pio_i2s* i2s) {
+    if (((uint32_t)i2s & 0x1f) != 0) {
+        panic("pio_i2s argument must be 32-byte aligned!");
+    }
+    if (!i2s_blocks_valid(config->block_frames, config->ring_blocks)) {
+        panic("invalid DMA block size or ring depth");
     }
+    i2s->config       = *config;
+    i2s->block_frames = config->block_frames;
+    i2s->ring_blocks  = config->ring_blocks;
     i2s_send_program_init(pio, config, i2s);
-    dma_double_buffer_send_init(i2s, dma_handler);
-    pio_enable_sm_mask_in_sync(i2s->spio, i2s->sm_mask1);
+    dma_send_ring_init(i2s);
+    // enabled by i2s_program_start_synched, once the clock pins are set up
+    i2s->sends = true;
 }
 
 
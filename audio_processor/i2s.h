@@ -21,12 +21,60 @@
  */
 #include <stdio.h>
 #include "hardware/pio.h"
+#include "hardware/dma.h"
 
 #ifndef I2S_TEST_I2S_H
 #define I2S_TEST_I2S_H
 
+/* The sample rate is fixed at build time, 48kHz or 96kHz, each with a
+ * system clock the PIO dividers take exactly to the 256fs SCK and 64fs
+ * BCK (see the clock table in README.md), so fs comes out exact.
+ */
+
+#ifndef AUDIO_SAMPLE_RATE
+#define AUDIO_SAMPLE_RATE 48000
+#endif
+
+#if AUDIO_SAMPLE_RATE == 48000
+#define AUDIO_SYS_CLOCK_KHZ 132000   // SCK divider 5.37109375, BCK 21.484375
+#elif AUDIO_SAMPLE_RATE == 96000
+#define AUDIO_SYS_CLOCK_KHZ 153600   // SCK divider 3.125, BCK 12.5
+#else
+#error "AUDIO_SAMPLE_RATE must be 48000 or 96000"
+#endif
+
+/* The DMA runs a ring of ring_blocks control blocks, each block_frames
+ * stereo frames long, with one interrupt per block.  Bigger blocks mean
+ * fewer interrupts, a deeper ring more time for the interrupt to finish
+ * a block before the output needs it.  Both add latency: a sample takes
+ * ring_blocks * block_frames frames to get through, plus the TX FIFO.
+ * The defaults can be set at build time, and changed while running with
+ * i2s_set_blocks().
+ *
+ * The sends go out as one more I2S data line (send1_pin) from a state
+ * machine on the second PIO, slaved to the main bit and word clocks:
+ * send 1 in the left word, send 2 in the right.  Its DMA ring mirrors
+ * the output ring block for block, and is started with it, so the send
+ * block the interrupt writes goes out with the same output block.
+ */
+
+#ifndef AUDIO_BUFFER_FRAMES
+#if AUDIO_SAMPLE_RATE == 96000
+#define AUDIO_BUFFER_FRAMES 8 // the same interrupt and control rate as 48kHz
+#else
 #define AUDIO_BUFFER_FRAMES 4 // orig 48
-#define STEREO_BUFFER_SIZE  AUDIO_BUFFER_FRAMES * 2  // roughly 2ms, 48 L + R words
+#endif
+#endif
+#ifndef AUDIO_RING_BLOCKS
+#define AUDIO_RING_BLOCKS 2
+#endif
+
+#define I2S_MIN_BLOCK_FRAMES 4
+#define I2S_MAX_BLOCK_FRAMES 64
+#define I2S_MAX_RING_BLOCKS 8      // must be a power of 2
+#define I2S_MAX_RING_FRAMES 256    // ring_blocks * block_frames
+#define I2S_RING_WORDS (I2S_MAX_RING_FRAMES * 2)
+#define I2S_FIFO_FRAMES 4          // the joined TX FIFO the DMA keeps full
 
 typedef struct i2s_config {
     uint32_t fs;
@@ -38,6 +86,8 @@ typedef struct i2s_config {
     uint8_t  clock_pin_base;
     bool     sck_enable;
     uint8_t  send1_pin;
+    uint16_t block_frames;
+    uint8_t  ring_blocks;
 } i2s_config;
 
 typedef struct pio_i2s_clocks {
@@ -53,7 +103,8 @@ typedef struct pio_i2s_clocks {
     uint8_t  bck_f;
 } pio_i2s_clocks;
 
-// NOTE: Use __attribute__ ((aligned(8))) on this struct or the DMA wrap won't work!
+// NOTE: The control block rings must be aligned to their size for the DMA
+//       wrap to work, which makes the struct 32 byte aligned.
 typedef struct pio_i2s {
     PIO        pio;
     PIO        spio;  // sends pio - secondary pio
@@ -63,24 +114,82 @@ typedef struct pio_i2s {
     uint8_t    sm_dout;
     uint8_t    sm_din;
     uint8_t    sm_send1;
+    uint8_t    offset_sck;         // program offsets, to restart the state machines
+    uint8_t    offset_din;
+    uint8_t    offset_dout;
+    uint8_t    offset_send;
+    bool       sends;              // the send ring is running
+    bool       sniff;              // the DMA sniffer is on the input data channel
+    bool       sniff_crc;          // CRC-32 rather than sum
+    uint16_t   block_frames;
+    uint8_t    ring_blocks;
     uint       dma_ch_in_ctrl;
     uint       dma_ch_in_data;
     uint       dma_ch_out_ctrl;
     uint       dma_ch_out_data;
     uint       dma_ch_send1_ctrl;
     uint       dma_ch_send1_data;
-    int32_t*   in_ctrl_blocks[2];  // Control blocks MUST have 8-byte alignment.
-    int32_t*   out_ctrl_blocks[2];
-    int32_t*   send1_ctrl_blocks[2];
-    int32_t    input_buffer[STEREO_BUFFER_SIZE * 2];
-    int32_t    output_buffer[STEREO_BUFFER_SIZE * 2];
-    int32_t    send1_buffer[STEREO_BUFFER_SIZE * 2];
+    int32_t*   in_ctrl_blocks[I2S_MAX_RING_BLOCKS] __attribute__((aligned(32)));
+    int32_t*   out_ctrl_blocks[I2S_MAX_RING_BLOCKS] __attribute__((aligned(32)));
+    int32_t*   send1_ctrl_blocks[I2S_MAX_RING_BLOCKS] __attribute__((aligned(32)));
+    int32_t*   input_buffer;       // the rings, I2S_RING_WORDS each, in banks of
+    int32_t*   output_buffer;      // their own (see lib/sram_banks.h)
+    int32_t*   send1_buffer;
     i2s_config config;
 } pio_i2s;
 
+static inline bool i2s_blocks_valid(uint16_t block_frames, uint8_t ring_blocks) {
+    return (block_frames >= I2S_MIN_BLOCK_FRAMES) && (block_frames <= I2S_MAX_BLOCK_FRAMES)
+	&& (ring_blocks >= 2) && (ring_blocks <= I2S_MAX_RING_BLOCKS)
+	&& ((ring_blocks & (ring_blocks - 1)) == 0)
+	&& (block_frames * ring_blocks <= I2S_MAX_RING_FRAMES);
+}
+
+// input to output delay through the ring, in frames
+static inline uint32_t i2s_latency_frames(uint16_t block_frames, uint8_t ring_blocks) {
+    return (block_frames * ring_blocks) + I2S_FIFO_FRAMES;
+}
+
+/* The ring block the input DMA has just finished, for the DMA handler.
+ * When the interrupt is raised the control channel has already loaded
+ * the next block into the data channel, so it points two past the one
+ * that completed.
+ */
+static inline uint8_t i2s_completed_block(pio_i2s* i2s) {
+    uintptr_t next = (dma_hw->ch[i2s->dma_ch_in_ctrl].read_addr - (uintptr_t) i2s->in_ctrl_blocks) / sizeof(int32_t*);
+    return (next - 2) & (i2s->ring_blocks - 1);
+}
+
+// the interleaved stereo frames of one ring block
+static inline int32_t* i2s_block(int32_t* buffer, pio_i2s* i2s, uint8_t block) {
+    return &buffer[block * i2s->block_frames * 2];
+}
+
+/* The DMA sniffer's reading of the input, for the DMA handler (see
+ * lib/input_monitor.h).  reseed starts the next CRC; in sum mode the
+ * running sum is left alone.
+ */
+static inline uint32_t i2s_sniff_take(bool reseed) {
+    uint32_t value = dma_hw->sniff_data;
+    if (reseed) dma_hw->sniff_data = 0;
+    return value;
+}
+
 extern const i2s_config i2s_config_default;
 
 void i2s_program_start_slaved(PIO pio, const i2s_config* config, void (*dma_handler)(void), pio_i2s* i2s);
 void i2s_program_start_synched(PIO pio, const i2s_config* config, void (*dma_handler)(void), pio_i2s* i2s);
-void i2s_program_start_sends(PIO pio, const i2s_config* config, void (*dma_handler)(void), pio_i2s* i2s);
+
+// set up the sends before i2s_program_start_synched, which starts them
+// with the main I2S so the send words line up with the output words
+void i2s_program_start_sends(PIO pio, const i2s_config* config, pio_i2s* i2s);
+
+// rebuild the DMA ring with a new block size and depth while running,
+// false if the combination isn't valid.  The audio drops out briefly.
+bool i2s_set_blocks(pio_i2s* i2s, uint16_t block_frames, uint8_t ring_blocks);
+
+// put the DMA sniffer on the input data channel, summing every word or
+// running a CRC-32 over them, once the I2S is started.  It stays on
+// through i2s_set_blocks.
+void i2s_sniff_input(pio_i2s* i2s, bool crc);
 #endif  // I2S_TEST_I2S_H
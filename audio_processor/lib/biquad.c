@@ -0,0 +1,162 @@
+/* Biquad
+   Direct Form I biquad cascade with error feedback and bank swapping.
+*/
+
+#include <math.h>
+#include "biquad.h"
+#include "dsp_platform.h"
+#include "fixed_point.h"
+#include "sram_banks.h"
+
+#define min(X, Y) ((X) < (Y) ? (X) : (Y))
+#define max(X, Y) ((X) > (Y) ? (X) : (Y))
+#define clamp(V, X, Y) min(Y,max(X,V))
+
+// Q values of the two sections of a 4th order Butterworth
+static const double butterworth_q[2] = { 0.54119610, 1.30656296 };
+
+void biquad_init(biquad_cascade *f, uint32_t sample_rate) {
+    f->sample_rate = sample_rate;
+    f->lowpass_ratio = 0;
+    f->highpass_ratio = 0;
+    f->active = 0;
+    f->request = 0;
+    f->bank[0].sections = 0;
+    f->bank[0].in_use = 0;
+    f->bank[1].sections = 0;
+    f->bank[1].in_use = 0;
+    for (int ch = 0; ch < 2; ch++) {
+	for (int s = 0; s < BIQUAD_MAX_SECTIONS; s++) {
+	    f->state[ch][s] = (biquad_state) { 0, 0, 0, 0, 0 };
+	}
+    }
+}
+
+// cutoffs move logarithmically across the audio band
+
+float biquad_lowpass_hz(float ratio) {
+    return BIQUAD_MAX_HZ * powf(BIQUAD_MIN_HZ / BIQUAD_MAX_HZ, clamp(ratio, 0.0, 1.0));
+}
+
+float biquad_highpass_hz(float ratio) {
+    return BIQUAD_MIN_HZ * powf(BIQUAD_MAX_HZ / BIQUAD_MIN_HZ, clamp(ratio, 0.0, 1.0));
+}
+
+static int32_t coef_q30(double c) {
+    return (int32_t) llround(clamp(c, -2.0, 1.999999999) * Q30_ONE);
+}
+
+// RBJ cookbook low/high pass section
+
+static void design_section(biquad_coefs *c, bool highpass, double hz, double q, uint32_t sample_rate) {
+    double w0 = 2.0 * M_PI * min(hz, 0.45 * sample_rate) / sample_rate;
+    double cosw = cos(w0);
+    double alpha = sin(w0) / (2.0 * q);
+    double a0 = 1.0 + alpha;
+    double b1 = highpass ? -(1.0 + cosw) : (1.0 - cosw);
+    double b0 = highpass ? -b1 / 2.0 : b1 / 2.0;
+    // the feedforward bound of section_process: |b0|, |b2| <= 1 and
+    // |b1| < 2 (true of these sections, held here against rounding)
+    c->b0 = coef_q30(clamp(b0 / a0, -1.0, 1.0));
+    c->b1 = coef_q30(b1 / a0);
+    c->b2 = coef_q30(clamp(b0 / a0, -1.0, 1.0));
+    c->a1 = coef_q30((-2.0 * cosw) / a0);
+    c->a2 = coef_q30((1.0 - alpha) / a0);
+}
+
+bool biquad_ready(biquad_cascade *f) {
+    return f->active == f->request;
+}
+
+bool biquad_set_filters(biquad_cascade *f, float lowpass_ratio, float highpass_ratio) {
+    if (!biquad_ready(f)) return false;
+
+    uint8_t next = f->active ^ 1;
+    biquad_bank *bank = &f->bank[next];
+    uint8_t in_use = 0;
+    if (highpass_ratio > 0) {
+	double hz = biquad_highpass_hz(highpass_ratio);
+	design_section(&bank->c[BIQUAD_HIGHPASS], true, hz, butterworth_q[0], f->sample_rate);
+	design_section(&bank->c[BIQUAD_HIGHPASS + 1], true, hz, butterworth_q[1], f->sample_rate);
+	in_use |= 3 << BIQUAD_HIGHPASS;
+    }
+    if (lowpass_ratio > 0) {
+	double hz = biquad_lowpass_hz(lowpass_ratio);
+	design_section(&bank->c[BIQUAD_LOWPASS], false, hz, butterworth_q[0], f->sample_rate);
+	design_section(&bank->c[BIQUAD_LOWPASS + 1], false, hz, butterworth_q[1], f->sample_rate);
+	in_use |= 3 << BIQUAD_LOWPASS;
+    }
+    bank->in_use = in_use;
+    bank->sections = __builtin_popcount(in_use);
+    f->lowpass_ratio = lowpass_ratio;
+    f->highpass_ratio = highpass_ratio;
+
+    // publish the bank only once it is complete
+    dsp_barrier();
+    f->request = next;
+    return true;
+}
+
+/* One section over one channel of the block.  Coefficients and state
+ * are held in locals for the block so the inner loop is just the five
+ * 32x32->64 multiplies.
+ *
+ * With |b0| + |b1| + |b2| < 4 (see design_section) the feedforward sum
+ * is under 2^63, and with |a1| < 2 and |a2| <= 1 the feedback sum under
+ * 3 * 2^61.  Their difference can still pass 2^63 when a full scale
+ * input meets saturated feedback (the 20Hz high pass has a1 near -2,
+ * a2 near 1), so it is saturated before the shift rather than left to
+ * wrap.
+ */
+
+static void SRAM_ISR_FUNC(section_process)(const biquad_coefs *c, biquad_state *st, int32_t *buffer, size_t num_frames) {
+    int32_t b0 = c->b0, b1 = c->b1, b2 = c->b2, a1 = c->a1, a2 = c->a2;
+    int32_t x1 = st->x1, x2 = st->x2, y1 = st->y1, y2 = st->y2;
+    int64_t err = st->err;
+
+    for (size_t i = 0; i < num_frames * 2; i += 2) {
+	int32_t x = buffer[i];
+	int64_t ff = ((int64_t) b0 * x) + ((int64_t) b1 * x1) + ((int64_t) b2 * x2);
+	int64_t fb = ((int64_t) a1 * y1) + ((int64_t) a2 * y2) - err;
+	int64_t acc;
+	if (__builtin_sub_overflow(ff, fb, &acc)) {
+	    acc = (ff < 0) ? INT64_MIN : INT64_MAX;
+	}
+	int32_t y = q_sat32(acc >> Q30_SHIFT);
+	err = acc - ((int64_t) y << Q30_SHIFT);
+	if (err < 0 || err >= Q30_ONE) err = 0;  // saturated, don't carry
+	x2 = x1;
+	x1 = x;
+	y2 = y1;
+	y1 = y;
+	buffer[i] = y;
+    }
+    st->x1 = x1;
+    st->x2 = x2;
+    st->y1 = y1;
+    st->y2 = y2;
+    st->err = (int32_t) err;
+}
+
+void SRAM_ISR_FUNC(biquad_process)(biquad_cascade *f, int32_t *buffer, size_t num_frames) {
+    // take a new bank at the block boundary
+    uint8_t request = f->request;
+    if (request != f->active) {
+	// sections coming into use start from silence, the others keep
+	// their state
+	uint8_t starting = f->bank[request].in_use & ~f->bank[f->active].in_use;
+	for (uint8_t s = 0; s < BIQUAD_MAX_SECTIONS; s++) {
+	    if (starting & (1 << s)) {
+		f->state[0][s] = (biquad_state) { 0, 0, 0, 0, 0 };
+		f->state[1][s] = (biquad_state) { 0, 0, 0, 0, 0 };
+	    }
+	}
+	f->active = request;
+    }
+    const biquad_bank *bank = &f->bank[f->active];
+    for (uint8_t s = 0; s < BIQUAD_MAX_SECTIONS; s++) {
+	if (!(bank->in_use & (1 << s))) continue;
+	section_process(&bank->c[s], &f->state[0][s], buffer, num_frames);
+	section_process(&bank->c[s], &f->state[1][s], buffer + 1, num_frames);
+    }
+}
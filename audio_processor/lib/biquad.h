@@ -0,0 +1,82 @@
+/* Biquad
+   Cascade of up to BIQUAD_MAX_SECTIONS Direct Form I biquads per
+   channel, run from the audio interrupt on the integer codec words.
+
+   Coefficients are Q2.30, designed with |b0| + |b1| + |b2| < 4 so the
+   feedforward sum fits 64 bits.  Each section accumulates in 64 bits,
+   saturated rather than wrapped when full scale input meets saturated
+   feedback, and carries the fraction dropped when the accumulator is shifted back
+   to a sample into the next sample (first order error feedback), so
+   low cutoff sections don't build up a truncation noise floor or
+   limit cycle.
+
+   Each filter has fixed sections: the high pass 0 and 1, the low pass
+   2 and 3, each pair bypassed while its filter is off.  So a section
+   always holds the same filter, whatever the other one is doing.
+
+   The coefficients live in two banks.  The control side (core 1)
+   computes the new coefficients into the bank the interrupt is not
+   using, then asks for a swap; the interrupt swaps banks at the start
+   of the next block.  A section in use in both banks keeps its state
+   across the swap (its cutoff moved), one coming into use starts from
+   silence.  Only one swap can be outstanding - the setters return
+   false until the last one has been taken.
+*/
+
+#ifndef __BIQUAD__
+#define __BIQUAD__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define BIQUAD_MAX_SECTIONS 4
+#define BIQUAD_HIGHPASS 0         // first section of each filter
+#define BIQUAD_LOWPASS 2
+#define BIQUAD_MIN_HZ 20.0
+#define BIQUAD_MAX_HZ 20000.0
+
+typedef struct biquad_coefs {
+    int32_t b0, b1, b2;       // Q2.30
+    int32_t a1, a2;           // Q2.30, a0 normalized to 1
+} biquad_coefs;
+
+typedef struct biquad_bank {
+    uint8_t sections;         // sections in use, 0 bypasses the filter
+    uint8_t in_use;           // a bit per section, the rest are bypassed
+    biquad_coefs c[BIQUAD_MAX_SECTIONS];
+} biquad_bank;
+
+typedef struct biquad_state {
+    int32_t x1, x2;
+    int32_t y1, y2;
+    int32_t err;              // fraction carried from the last output
+} biquad_state;
+
+typedef struct biquad_cascade {
+    uint32_t sample_rate;
+    float lowpass_ratio;      // the settings the pending bank was built from
+    float highpass_ratio;
+    volatile uint8_t active;  // bank in use by the interrupt
+    volatile uint8_t request; // bank the control side wants in use
+    biquad_bank bank[2];
+    biquad_state state[2][BIQUAD_MAX_SECTIONS];  // [channel][section]
+} biquad_cascade;
+
+void biquad_init(biquad_cascade *f, uint32_t sample_rate);
+
+// control side: false if the previous swap hasn't been taken yet
+
+bool biquad_ready(biquad_cascade *f);
+bool biquad_set_filters(biquad_cascade *f, float lowpass_ratio, float highpass_ratio);
+
+// map a 0 - 1 filter ratio to a cutoff frequency (0 = open, 1 = fully filtered)
+
+float biquad_lowpass_hz(float ratio);
+float biquad_highpass_hz(float ratio);
+
+// interrupt side: filter num_frames interleaved stereo frames in place
+
+void biquad_process(biquad_cascade *f, int32_t *buffer, size_t num_frames);
+
+#endif
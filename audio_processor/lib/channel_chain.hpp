@@ -0,0 +1,269 @@
+/* Channel Chain
+   The float channel path of channel_process_float() (see
+   channel_kernel.h) as a list of stages composed at compile time.
+   channel_chain<Stages...> runs the stages' per-frame work in the
+   order given, fused into one loop over the block, then their block
+   work (filters, limiter, meters) in the same order.  Stages are
+   plain structs called through the chain's template parameters, so
+   there is no virtual dispatch, and every call inlines into the loop.
+
+   A stage has three members, each of which may be left to the
+   chain_stage defaults (which do nothing):
+
+     begin(k, b)  at the start of the block, reads its settings from
+                  the kernel into the stage
+     frame(f)     once per frame, on the frame being built
+     end(k, b)    after the loop, on the whole output block
+
+   The frame carries the input words, the trimmed input and the
+   processed (wet) signal.  The chain starts each frame with the wet
+   signal equal to the input and stores it, saturated like float2int(),
+   as the output word once every stage has run.
+
+   A stage is dropped with chain_stage_if<false, S>, which gives the
+   empty chain_bypass in its place; a dropped stage costs nothing, and
+   a stage that is present always runs, so there are no per-sample
+   tests of the settings.  The kernel's run time choices (the output
+   mix, and building the sends) are made once per block by
+   channel_process_chain(), which picks one of four chains.
+
+   The gate and compressor run at the control rate (see dynamics.h);
+   they reach the audio path as the net gain the chain_net_gain stage
+   ramps to.  The sends tap the signal before balance, as in the
+   kernel, so chain_sends comes before chain_balance.
+
+   channel_process_chain() does the same float operations in the same
+   order as channel_process_float(), so its output, sends and meters
+   match the C kernel bit for bit.  The firmware still calls the C
+   kernel; host/chain_bench compares the two.
+*/
+
+#ifndef __CHANNEL_CHAIN__
+#define __CHANNEL_CHAIN__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <tuple>
+#include <type_traits>
+
+extern "C" {
+#include "dsp_platform.h"
+#include "channel_kernel.h"
+}
+
+#if defined(__GNUC__)
+#define CHAIN_INLINE inline __attribute__((always_inline))
+#else
+#define CHAIN_INLINE inline
+#endif
+
+struct chain_block {
+    const int32_t *input;     // interleaved stereo frames
+    int32_t *output;
+    int32_t *sends;           // null unless the chain has chain_sends
+    size_t num_frames;
+};
+
+struct chain_frame {
+    size_t i;                 // index of the left word in the block
+    int32_t word_l;           // input words
+    int32_t word_r;
+    float in_l;               // input after trim
+    float in_r;
+    float w_l;                // processed signal
+    float w_r;
+};
+
+struct chain_stage {
+    CHAIN_INLINE void begin(channel_kernel *, const chain_block &) {}
+    CHAIN_INLINE void frame(chain_frame &) {}
+    CHAIN_INLINE void end(channel_kernel *, const chain_block &) {}
+};
+
+struct chain_bypass : chain_stage {};
+
+template <bool On, typename S>
+using chain_stage_if = std::conditional_t<On, S, chain_bypass>;
+
+// stages, in the order the kernel runs them
+
+struct chain_trim : chain_stage {
+    float gain;
+
+    CHAIN_INLINE void begin(channel_kernel *k, const chain_block &) {
+	gain = k->trim_gain;
+    }
+    CHAIN_INLINE void frame(chain_frame &f) {
+	f.in_l *= gain;
+	f.in_r *= gain;
+	f.w_l = f.in_l;
+	f.w_r = f.in_r;
+    }
+};
+
+// compression * makeup * gate * mute, ramped across the block
+
+struct chain_net_gain : chain_stage {
+    float gain;
+    float step;
+    float target;
+
+    CHAIN_INLINE void begin(channel_kernel *k, const chain_block &b) {
+	gain = k->net_gain_now;
+	target = k->net_gain;
+	step = (target - gain) / (float) b.num_frames;
+    }
+    CHAIN_INLINE void frame(chain_frame &f) {
+	gain += step;
+	f.w_l *= gain;
+	f.w_r *= gain;
+    }
+    CHAIN_INLINE void end(channel_kernel *k, const chain_block &) {
+	k->net_gain_now = target;
+    }
+};
+
+// dry/wet output mix
+
+struct chain_output_mix : chain_stage {
+    float comp_mix;
+    float raw_mix;
+
+    CHAIN_INLINE void begin(channel_kernel *k, const chain_block &) {
+	comp_mix = k->comp_mix;
+	raw_mix = k->raw_mix;
+    }
+    CHAIN_INLINE void frame(chain_frame &f) {
+	f.w_l = (comp_mix * f.w_l) + (raw_mix * f.in_l);
+	f.w_r = (comp_mix * f.w_r) + (raw_mix * f.in_r);
+    }
+};
+
+struct chain_sends : chain_stage {
+    float send1_gain;
+    float send2_gain;
+    int32_t *sends;
+
+    CHAIN_INLINE void begin(channel_kernel *k, const chain_block &b) {
+	send1_gain = k->send1_gain * 0.5f;  // halved for the mono sum
+	send2_gain = k->send2_gain * 0.5f;
+	sends = b.sends;
+    }
+    CHAIN_INLINE void frame(chain_frame &f) {
+	float mono = f.w_l + f.w_r;
+	sends[f.i] = float2int(mono * send1_gain);
+	sends[f.i+1] = float2int(mono * send2_gain);
+    }
+};
+
+struct chain_balance : chain_stage {
+    float balance_l;
+    float balance_r;
+
+    CHAIN_INLINE void begin(channel_kernel *k, const chain_block &) {
+	balance_l = k->balance_l;
+	balance_r = k->balance_r;
+    }
+    CHAIN_INLINE void frame(chain_frame &f) {
+	f.w_l *= balance_l;
+	f.w_r *= balance_r;
+    }
+};
+
+// block stages, on the output words
+
+struct chain_filters : chain_stage {
+    CHAIN_INLINE void end(channel_kernel *k, const chain_block &b) {
+	biquad_process(&k->filter, b.output, b.num_frames);
+    }
+};
+
+struct chain_limiter : chain_stage {
+    CHAIN_INLINE void end(channel_kernel *k, const chain_block &b) {
+	limiter_process(&k->limiter, b.output, b.num_frames);
+    }
+};
+
+// input peaks from the frames, output peaks from the finished block,
+// published together; goes last
+
+struct chain_meter : chain_stage {
+    int32_t peak_in_l;
+    int32_t peak_in_r;
+
+    CHAIN_INLINE void begin(channel_kernel *, const chain_block &) {
+	peak_in_l = 0;
+	peak_in_r = 0;
+    }
+    CHAIN_INLINE void frame(chain_frame &f) {
+	peak_in_l = meter_max(peak_in_l, meter_abs(f.word_l));
+	peak_in_r = meter_max(peak_in_r, meter_abs(f.word_r));
+    }
+    CHAIN_INLINE void end(channel_kernel *k, const chain_block &b) {
+	int32_t peak_out_l = 0;
+	int32_t peak_out_r = 0;
+	for (size_t i = 0; i < b.num_frames * 2; i += 2) {
+	    peak_out_l = meter_max(peak_out_l, meter_abs(b.output[i]));
+	    peak_out_r = meter_max(peak_out_r, meter_abs(b.output[i+1]));
+	}
+	meter_publish(&k->meter, peak_in_l, peak_in_r, peak_out_l, peak_out_r);
+    }
+};
+
+template <typename... Stages>
+struct channel_chain {
+    static_assert(sizeof...(Stages) > 0, "a chain needs at least one stage");
+
+    static void process(channel_kernel *k, const int32_t *input, int32_t *output, int32_t *sends, size_t num_frames) {
+	std::tuple<Stages...> stages;
+	chain_block b = { input, output, sends, num_frames };
+
+	std::apply([&](auto &... s) { (s.begin(k, b), ...); }, stages);
+	for (size_t i = 0; i < num_frames * 2; i += 2) {
+	    chain_frame f;
+	    f.i = i;
+	    f.word_l = input[i];
+	    f.word_r = input[i+1];
+	    f.in_l = int2float(f.word_l);
+	    f.in_r = int2float(f.word_r);
+	    f.w_l = f.in_l;
+	    f.w_r = f.in_r;
+	    std::apply([&](auto &... s) { (s.frame(f), ...); }, stages);
+	    output[i] = float2int(f.w_l);
+	    output[i+1] = float2int(f.w_r);
+	}
+	std::apply([&](auto &... s) { (s.end(k, b), ...); }, stages);
+    }
+};
+
+// channel_process_float() as a chain, for one choice of the output mix
+// and the sends
+
+template <bool Mix, bool Sends>
+using channel_chain_float = channel_chain<
+    chain_trim,
+    chain_net_gain,
+    chain_stage_if<Mix, chain_output_mix>,
+    chain_stage_if<Sends, chain_sends>,
+    chain_balance,
+    chain_filters,
+    chain_limiter,
+    chain_meter>;
+
+static inline void channel_process_chain(channel_kernel *k, const int32_t *input, int32_t *output, int32_t *sends, size_t num_frames) {
+    if (k->mixed) {
+	if (sends) {
+	    channel_chain_float<true, true>::process(k, input, output, sends, num_frames);
+	} else {
+	    channel_chain_float<true, false>::process(k, input, output, sends, num_frames);
+	}
+    } else {
+	if (sends) {
+	    channel_chain_float<false, true>::process(k, input, output, sends, num_frames);
+	} else {
+	    channel_chain_float<false, false>::process(k, input, output, sends, num_frames);
+	}
+    }
+}
+
+#endif
@@ -0,0 +1,302 @@
+/* Channel Kernel
+   Float and Q31 implementations of the per-sample channel path.
+*/
+
+#include "channel_kernel.h"
+#include "dsp_platform.h"
+#include "fixed_point.h"
+#include "sram_banks.h"
+#ifdef DSP_INTERP
+#include "hardware/interp.h"
+#endif
+
+#define min(X, Y) ((X) < (Y) ? (X) : (Y))
+#define max(X, Y) ((X) > (Y) ? (X) : (Y))
+#define clamp(V, X, Y) min(Y,max(X,V))
+
+void channel_kernel_init(channel_kernel *k, uint32_t sample_rate) {
+    meter_init(&k->meter);
+    biquad_init(&k->filter, sample_rate);
+    limiter_init(&k->limiter, sample_rate);
+    channel_kernel_set_trim(k, 1.0);
+    channel_kernel_set_net_gain(k, 1.0);
+    k->net_gain_now = k->net_gain;
+    k->net_gain_now_q = k->net_gain_q;
+    channel_kernel_set_output_mix(k, 1.0);
+    channel_kernel_set_balance(k, 0);
+    channel_kernel_set_sends(k, 0, 0);
+}
+
+// weight 0 to 1 as an interpolator blend alpha, 0 to 255
+
+static uint32_t blend_alpha(float w) {
+    return clamp((int32_t) (w * 256.0f + 0.5f), 0, 255);
+}
+
+void channel_kernel_set_trim(channel_kernel *k, float gain) {
+    k->trim_gain = gain;
+    k->trim_gain_q = float_to_q27(gain);
+}
+
+void channel_kernel_set_net_gain(channel_kernel *k, float gain) {
+    k->net_gain = gain;
+    k->net_gain_q = float_to_q27(gain);
+}
+
+void channel_kernel_set_output_mix(channel_kernel *k, float mix) {
+    k->comp_mix = clamp(mix, 0.0, 1.0);
+    k->raw_mix = clamp(1.0 - mix, 0.0, 1.0);
+    k->comp_mix_q = float_to_q30(k->comp_mix);
+    k->raw_mix_q = float_to_q30(k->raw_mix);
+    k->comp_mix_alpha = blend_alpha(k->comp_mix);
+    k->mixed = (mix < 1.0);
+}
+
+void channel_kernel_set_balance(channel_kernel *k, float balance) {
+    k->balance_l = 1.0 + balance;
+    k->balance_r = 1.0 - balance;
+    k->balance_l_q = float_to_q27(k->balance_l);
+    k->balance_r_q = float_to_q27(k->balance_r);
+    k->balance_l_alpha = blend_alpha(k->balance_l * 0.5f);
+    k->balance_r_alpha = blend_alpha(k->balance_r * 0.5f);
+}
+
+void channel_kernel_set_sends(channel_kernel *k, float send1_gain, float send2_gain) {
+    k->send1_gain = clamp(send1_gain, 0.0, 1.0);
+    k->send2_gain = clamp(send2_gain, 0.0, 1.0);
+    k->send1_gain_q = float_to_q27(k->send1_gain);
+    k->send2_gain_q = float_to_q27(k->send2_gain);
+}
+
+/* Both variants walk the block a frame at a time so the left and
+ * right peak scans need no per-sample channel test, and fold the
+ * peaks with the branchless meter_abs/meter_max.  The peaks are
+ * published once at the end of the block, the output peaks after the
+ * filters and limiter have run over the block.
+ *
+ * The net gain ramps by a fixed step per frame from net_gain_now to
+ * the target, reaching it (to within the rounding of the step) at the
+ * last frame; the next block starts from the target exactly.
+ */
+
+static inline void output_peaks(const int32_t *output, size_t num_frames, int32_t *peak_l, int32_t *peak_r) {
+    int32_t l = 0;
+    int32_t r = 0;
+    for (size_t i = 0; i < num_frames * 2; i += 2) {
+	l = meter_max(l, meter_abs(output[i]));
+	r = meter_max(r, meter_abs(output[i+1]));
+    }
+    *peak_l = l;
+    *peak_r = r;
+}
+
+void SRAM_ISR_FUNC(channel_process_float)(channel_kernel *k, const int32_t *input, int32_t *output, int32_t *sends, size_t num_frames) {
+    float trim_gain = k->trim_gain;
+    float net_gain = k->net_gain_now;
+    float target_gain = k->net_gain;
+    float gain_step = (target_gain - net_gain) / (float) num_frames;
+    float comp_mix = k->comp_mix;
+    float raw_mix = k->raw_mix;
+    bool mixed = k->mixed;
+    float balance_l = k->balance_l;
+    float balance_r = k->balance_r;
+    float send1_gain = k->send1_gain * 0.5f;  // halved for the mono sum
+    float send2_gain = k->send2_gain * 0.5f;
+    int32_t peak_in_l = 0;
+    int32_t peak_in_r = 0;
+    int32_t peak_out_l = 0;
+    int32_t peak_out_r = 0;
+
+    for (size_t i = 0; i < num_frames * 2; i += 2) {
+	int32_t word_l = input[i];
+	int32_t word_r = input[i+1];
+	peak_in_l = meter_max(peak_in_l, meter_abs(word_l));
+	peak_in_r = meter_max(peak_in_r, meter_abs(word_r));
+
+	net_gain += gain_step;
+	float input_l = int2float(word_l) * trim_gain;
+	float input_r = int2float(word_r) * trim_gain;
+	float wordf_l = input_l * net_gain;
+	float wordf_r = input_r * net_gain;
+	if (mixed) {
+	    wordf_l = (comp_mix * wordf_l) + (raw_mix * input_l);
+	    wordf_r = (comp_mix * wordf_r) + (raw_mix * input_r);
+	}
+	if (sends) {
+	    float mono = wordf_l + wordf_r;
+	    sends[i] = float2int(mono * send1_gain);
+	    sends[i+1] = float2int(mono * send2_gain);
+	}
+	int32_t output_l = float2int(wordf_l * balance_l);
+	int32_t output_r = float2int(wordf_r * balance_r);
+	output[i] = output_l;
+	output[i+1] = output_r;
+    }
+    biquad_process(&k->filter, output, num_frames);
+    limiter_process(&k->limiter, output, num_frames);
+    output_peaks(output, num_frames, &peak_out_l, &peak_out_r);
+    k->net_gain_now = target_gain;
+    meter_publish(&k->meter, peak_in_l, peak_in_r, peak_out_l, peak_out_r);
+}
+
+void SRAM_ISR_FUNC(channel_process_q31)(channel_kernel *k, const int32_t *input, int32_t *output, int32_t *sends, size_t num_frames) {
+    int32_t trim_gain = k->trim_gain_q;
+    int32_t net_gain = k->net_gain_now_q;
+    int32_t target_gain = k->net_gain_q;
+    int32_t gain_step = (target_gain - net_gain) / (int32_t) num_frames;
+    int32_t comp_mix = k->comp_mix_q;
+    int32_t raw_mix = k->raw_mix_q;
+    bool mixed = k->mixed;
+    int32_t balance_l = k->balance_l_q;
+    int32_t balance_r = k->balance_r_q;
+    int32_t send1_gain = k->send1_gain_q;
+    int32_t send2_gain = k->send2_gain_q;
+    int32_t peak_in_l = 0;
+    int32_t peak_in_r = 0;
+    int32_t peak_out_l = 0;
+    int32_t peak_out_r = 0;
+
+    for (size_t i = 0; i < num_frames * 2; i += 2) {
+	int32_t word_l = input[i];
+	int32_t word_r = input[i+1];
+	peak_in_l = meter_max(peak_in_l, meter_abs(word_l));
+	peak_in_r = meter_max(peak_in_r, meter_abs(word_r));
+
+	net_gain += gain_step;
+	int32_t input_l = q31_gain_in(word_l, trim_gain);
+	int32_t input_r = q31_gain_in(word_r, trim_gain);
+	int32_t w_l = q27_mul(input_l, net_gain);
+	int32_t w_r = q27_mul(input_r, net_gain);
+	if (mixed) {
+	    w_l = q30_mac2(w_l, comp_mix, input_l, raw_mix);
+	    w_r = q30_mac2(w_r, comp_mix, input_r, raw_mix);
+	}
+	if (sends) {
+	    int32_t mono = (w_l >> 1) + (w_r >> 1);
+	    sends[i] = q27_gain_out(mono, send1_gain);
+	    sends[i+1] = q27_gain_out(mono, send2_gain);
+	}
+	int32_t output_l = q27_gain_out(w_l, balance_l);
+	int32_t output_r = q27_gain_out(w_r, balance_r);
+	output[i] = output_l;
+	output[i+1] = output_r;
+    }
+    biquad_process(&k->filter, output, num_frames);
+    limiter_process(&k->limiter, output, num_frames);
+    output_peaks(output, num_frames, &peak_out_l, &peak_out_r);
+    k->net_gain_now_q = target_gain;
+    meter_publish(&k->meter, peak_in_l, peak_in_r, peak_out_l, peak_out_r);
+}
+
+#ifdef DSP_INTERP
+
+/* interp0: in blend mode lane 1 (signed) blends BASE0 to BASE1 by the
+ * low 8 bits of its own shift/mask result, so the alpha goes in ACCUM1
+ * with lane 1 masked to bits 0-7; lane 0 is unused.  interp1: lane 0
+ * in clamp mode
+ * clamps ACCUM0 to BASE0 - BASE1, the range that shifts up to a Q31
+ * word.
+ *
+ * The balance blends from 0 to the Q4.27 sample by balance / 2, so
+ * the result is shifted up by one more than the headroom to make the
+ * Q31 word.
+ */
+
+#define INTERP_OUT_SHIFT (Q_HEADROOM + 1)
+#define INTERP_OUT_MAX (INT32_MAX >> INTERP_OUT_SHIFT)
+#define INTERP_OUT_MIN (INT32_MIN >> INTERP_OUT_SHIFT)
+
+void channel_kernel_claim_interp(void) {
+    interp_claim_lane_mask(interp0, 0x3);
+    interp_claim_lane_mask(interp1, 0x3);
+}
+
+static inline void interp_setup(void) {
+    interp_config c = interp_default_config();
+    interp_config_set_blend(&c, true);
+    interp_set_config(interp0, 0, &c);
+    c = interp_default_config();
+    interp_config_set_mask(&c, 0, 7);
+    interp_config_set_signed(&c, true);
+    interp_set_config(interp0, 1, &c);
+
+    c = interp_default_config();
+    interp_config_set_clamp(&c, true);
+    interp_config_set_signed(&c, true);
+    interp_set_config(interp1, 0, &c);
+    interp_set_base(interp1, 0, (uint32_t) INTERP_OUT_MIN);
+    interp_set_base(interp1, 1, (uint32_t) INTERP_OUT_MAX);
+}
+
+// from + (to - from) * alpha / 256, with the alpha already in ACCUM1
+
+static inline int32_t interp_blend(int32_t from, int32_t to) {
+    interp_set_base(interp0, 0, (uint32_t) from);
+    interp_set_base(interp0, 1, (uint32_t) to);
+    return (int32_t) interp_peek_lane_result(interp0, 1);
+}
+
+// balance the Q4.27 samples of one channel of the block in place, to
+// saturated Q31 words
+
+static inline void interp_balance_out(int32_t *buffer, size_t num_frames, uint32_t alpha) {
+    interp_set_accumulator(interp0, 1, alpha);
+    interp_set_base(interp0, 0, 0);
+    for (size_t i = 0; i < num_frames * 2; i += 2) {
+	interp_set_base(interp0, 1, (uint32_t) buffer[i]);
+	interp_set_accumulator(interp1, 0, interp_peek_lane_result(interp0, 1));
+	buffer[i] = (int32_t) (interp_peek_lane_result(interp1, 0) << INTERP_OUT_SHIFT);
+    }
+}
+
+void SRAM_ISR_FUNC(channel_process_interp)(channel_kernel *k, const int32_t *input, int32_t *output, int32_t *sends, size_t num_frames) {
+    int32_t trim_gain = k->trim_gain_q;
+    int32_t net_gain = k->net_gain_now_q;
+    int32_t target_gain = k->net_gain_q;
+    int32_t gain_step = (target_gain - net_gain) / (int32_t) num_frames;
+    bool mixed = k->mixed;
+    int32_t send1_gain = k->send1_gain_q;
+    int32_t send2_gain = k->send2_gain_q;
+    int32_t peak_in_l = 0;
+    int32_t peak_in_r = 0;
+    int32_t peak_out_l = 0;
+    int32_t peak_out_r = 0;
+
+    interp_setup();
+    interp_set_accumulator(interp0, 1, k->comp_mix_alpha);
+
+    // the output block holds the Q4.27 mix until the balance pass
+    for (size_t i = 0; i < num_frames * 2; i += 2) {
+	int32_t word_l = input[i];
+	int32_t word_r = input[i+1];
+	peak_in_l = meter_max(peak_in_l, meter_abs(word_l));
+	peak_in_r = meter_max(peak_in_r, meter_abs(word_r));
+
+	net_gain += gain_step;
+	int32_t input_l = q31_gain_in(word_l, trim_gain);
+	int32_t input_r = q31_gain_in(word_r, trim_gain);
+	int32_t w_l = q27_mul(input_l, net_gain);
+	int32_t w_r = q27_mul(input_r, net_gain);
+	if (mixed) {
+	    w_l = interp_blend(input_l, w_l);
+	    w_r = interp_blend(input_r, w_r);
+	}
+	if (sends) {
+	    int32_t mono = (w_l >> 1) + (w_r >> 1);
+	    sends[i] = q27_gain_out(mono, send1_gain);
+	    sends[i+1] = q27_gain_out(mono, send2_gain);
+	}
+	output[i] = w_l;
+	output[i+1] = w_r;
+    }
+    interp_balance_out(output, num_frames, k->balance_l_alpha);
+    interp_balance_out(output + 1, num_frames, k->balance_r_alpha);
+
+    biquad_process(&k->filter, output, num_frames);
+    limiter_process(&k->limiter, output, num_frames);
+    output_peaks(output, num_frames, &peak_out_l, &peak_out_r);
+    k->net_gain_now_q = target_gain;
+    meter_publish(&k->meter, peak_in_l, peak_in_r, peak_out_l, peak_out_r);
+}
+
+#endif
@@ -0,0 +1,113 @@
+/* Channel Kernel
+   The per-sample audio path run from the DMA interrupt: input trim,
+   net (compression * makeup * gate * mute) gain, output mix and
+   balance, then the high/low pass filters (see biquad.h) and the
+   output limiter (see limiter.h), plus peak metering published once
+   per block (see meter.h).
+
+   The two sends are built in the same pass: the post compression
+   signal (after the output mix, before balance, filters and limiter)
+   summed to mono and scaled by each send's gain, send 1 into the left
+   and send 2 into the right word of an interleaved send block.  That
+   is one more multiply per sample.  Pass a null send block when the
+   sends aren't running.
+
+   Three variants are provided.  The float variant matches the original
+   processing loop.  The Q31 variant does the same work using integer
+   32x32->64 multiplies, which avoids the soft float library calls on
+   the FPU-less Cortex-M0+.  Select the Q31 path by building with
+   DSP_FIXED_POINT defined.
+
+   The interpolator variant (DSP_INTERP) is the Q31 path with the
+   output mix, balance and output saturation done by the core's SIO
+   interpolators instead of 64 bit multiplies: interp0 in blend mode
+   mixes the dry and wet signals and applies balance, interp1 in clamp
+   mode saturates to full scale.  The blend weights are 8 bits (1/256),
+   so the mix steps by 0.4% and balance tops out at 255/128 rather than
+   2.  The interpolators belong to the core that uses them; the audio
+   core claims them with channel_kernel_claim_interp(), and the kernel
+   sets their modes at the start of each block so it can also be
+   benchmarked on the other core.  The host builds emulate them.
+
+   The control side writes the gains through the setters below, which
+   keep the float and fixed point copies in step.  The net gain is a
+   target: each block the kernel interpolates linearly from the gain
+   it ended the previous block on to the target, so gain changes made
+   at the control rate don't step (zipper) at block boundaries.
+*/
+
+#ifndef __CHANNEL_KERNEL__
+#define __CHANNEL_KERNEL__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "meter.h"
+#include "limiter.h"
+#include "biquad.h"
+
+typedef struct channel_kernel {
+    float trim_gain;          // input trim, applied before metering and processing
+    float net_gain;           // target compression * makeup * gate * mute
+    float net_gain_now;       // net gain reached at the end of the last block
+    float comp_mix;           // weight of the processed signal in the output mix
+    float raw_mix;            // weight of the unprocessed (trimmed) input in the output mix
+    float balance_l;          // left balance gain (0 to 2)
+    float balance_r;          // right balance gain (0 to 2)
+    bool mixed;               // true if the raw signal is blended into the output
+    float send1_gain;         // post compression send gains (0 to 1)
+    float send2_gain;
+
+    int32_t trim_gain_q;      // Q4.27 copies of the above for the fixed point path
+    int32_t net_gain_q;
+    int32_t net_gain_now_q;
+    int32_t comp_mix_q;       // Q1.30
+    int32_t raw_mix_q;        // Q1.30
+    int32_t balance_l_q;      // Q4.27
+    int32_t balance_r_q;
+    int32_t send1_gain_q;     // Q4.27
+    int32_t send2_gain_q;
+    uint32_t comp_mix_alpha;  // 8 bit blend weights for the interpolator variant
+    uint32_t balance_l_alpha; // balance / 2
+    uint32_t balance_r_alpha;
+
+    biquad_cascade filter;    // high and low pass filters on the output
+    limiter limiter;          // lookahead limiter on the output
+    block_meter meter;        // input (pre-trim) and output (post limiter) peaks, per block
+} channel_kernel;
+
+void channel_kernel_init(channel_kernel *k, uint32_t sample_rate);
+
+// control side setters
+
+void channel_kernel_set_trim(channel_kernel *k, float gain);
+void channel_kernel_set_net_gain(channel_kernel *k, float gain);
+void channel_kernel_set_output_mix(channel_kernel *k, float mix);
+void channel_kernel_set_balance(channel_kernel *k, float balance);
+void channel_kernel_set_sends(channel_kernel *k, float send1_gain, float send2_gain);
+
+// process num_frames interleaved stereo frames, and the sends if
+// sends isn't null
+
+void channel_process_float(channel_kernel *k, const int32_t *input, int32_t *output, int32_t *sends, size_t num_frames);
+void channel_process_q31(channel_kernel *k, const int32_t *input, int32_t *output, int32_t *sends, size_t num_frames);
+
+#ifdef DSP_INTERP
+// call on the core running the audio interrupt
+void channel_kernel_claim_interp(void);
+
+void channel_process_interp(channel_kernel *k, const int32_t *input, int32_t *output, int32_t *sends, size_t num_frames);
+#endif
+
+#if defined(DSP_INTERP)
+#define channel_process channel_process_interp
+#define CHANNEL_KERNEL_NAME "interpolator"
+#elif defined(DSP_FIXED_POINT)
+#define channel_process channel_process_q31
+#define CHANNEL_KERNEL_NAME "fixed point"
+#else
+#define channel_process channel_process_float
+#define CHANNEL_KERNEL_NAME "float"
+#endif
+
+#endif
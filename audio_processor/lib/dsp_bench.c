@@ -0,0 +1,205 @@
+/* DSP Bench
+   Micro-benchmarks of the channel DSP stages.
+*/
+
+#include <stdio.h>
+#include "dsp_bench.h"
+#include "dsp_platform.h"
+#include "channel_kernel.h"
+#include "dynamics.h"
+#include "moving_average.h"
+#include "fastmath.h"
+
+#define BENCH_SIGNAL_FRAMES 4096
+#define BENCH_SEED 0x2545f491
+
+#define min(X, Y) ((X) < (Y) ? (X) : (Y))
+
+// big enough to be kept off the stack on the device
+static int32_t signal[BENCH_SIGNAL_FRAMES * 2];
+static int32_t scratch[DSP_BENCH_MAX_FRAMES * 2];
+static int32_t send_scratch[DSP_BENCH_MAX_FRAMES * 2];
+static channel_kernel bench_kernel;
+static dynamics bench_dyn;
+
+static volatile float sink;
+
+static const char *stage_names[BENCH_STAGES] = {
+    "process_audio",
+    "process_audio+sends",
+    "process+sends+filters",
+    "biquad x4",
+    "limiter",
+    "dynamics_compress",
+    "dynamics_gate",
+    "moving_average",
+    "fm_amp_to_dB",
+    "fm_dB_to_ratio"
+};
+
+// noise stepping between about -6dBFS and -40dBFS, same every run
+
+static void make_signal() {
+    uint32_t x = BENCH_SEED;
+    for (int i = 0; i < BENCH_SIGNAL_FRAMES * 2; i++) {
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	int shift = ((i / 2048) & 1) ? 7 : 1;
+	signal[i] = ((int32_t) x >> shift) & ~0xff;
+    }
+}
+
+static const int32_t *block_at(uint32_t i, uint32_t frames) {
+    return &signal[((i * frames) % (BENCH_SIGNAL_FRAMES - frames)) * 2];
+}
+
+static void time_kernel(dsp_bench *b, int stage, uint32_t frames, int32_t *sends) {
+    uint64_t start = dsp_time_ns();
+    for (uint32_t i = 0; i < b->iterations; i++) {
+	channel_process(&bench_kernel, block_at(i, frames), scratch, sends, frames);
+    }
+    b->stage[stage].ns = (double) (dsp_time_ns() - start) / b->iterations;
+}
+
+void dsp_bench_run(dsp_bench *b, uint32_t sample_rate, uint32_t block_frames, uint32_t iterations) {
+    uint32_t frames = min(block_frames, DSP_BENCH_MAX_FRAMES);
+    uint64_t start;
+    float f = 0;
+
+    b->sample_rate = sample_rate;
+    b->block_frames = frames;
+    b->iterations = iterations;
+    for (int s = 0; s < BENCH_STAGES; s++) {
+	b->stage[s].name = stage_names[s];
+	b->stage[s].frames = (s <= BENCH_GATE) ? frames : 0;
+	b->stage[s].ns = 0;
+    }
+    make_signal();
+
+    // the audio interrupt
+    channel_kernel_init(&bench_kernel, sample_rate);
+    channel_kernel_set_net_gain(&bench_kernel, 0.5);
+    channel_kernel_set_sends(&bench_kernel, 0.5, 0.5);
+    time_kernel(b, BENCH_PROCESS_AUDIO, frames, 0);
+    time_kernel(b, BENCH_PROCESS_SENDS, frames, send_scratch);
+
+    biquad_set_filters(&bench_kernel.filter, 0.5, 0.5);
+    time_kernel(b, BENCH_PROCESS_FILTERED, frames, send_scratch);
+
+    start = dsp_time_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+	biquad_process(&bench_kernel.filter, scratch, frames);
+    }
+    b->stage[BENCH_BIQUAD].ns = (double) (dsp_time_ns() - start) / iterations;
+
+    start = dsp_time_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+	limiter_process(&bench_kernel.limiter, scratch, frames);
+    }
+    b->stage[BENCH_LIMITER].ns = (double) (dsp_time_ns() - start) / iterations;
+
+    // the control tick
+    dynamics_init(&bench_dyn, (float) sample_rate / frames);
+    dynamics_set_curve(&bench_dyn, -18.0, 4.0, 6.0);
+    dynamics_set_times(&bench_dyn, 5, 100, 1);
+    dynamics_set_gate(&bench_dyn, fm_dB_to_amp(-30), 2, 60, 800);
+
+    start = dsp_time_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+	f += dynamics_compress(&bench_dyn, meter_abs(block_at(i, frames)[0]), 1);
+    }
+    b->stage[BENCH_COMPRESS].ns = (double) (dsp_time_ns() - start) / iterations;
+
+    start = dsp_time_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+	const int32_t *in = block_at(i, frames);
+	f += dynamics_gate(&bench_dyn, meter_abs(in[0]), meter_abs(in[1]), true, 1);
+    }
+    b->stage[BENCH_GATE].ns = (double) (dsp_time_ns() - start) / iterations;
+
+    // helpers
+    average *avg = initialize_average(100);
+    start = dsp_time_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+	f += moving_average(avg, (float) (signal[i % BENCH_SIGNAL_FRAMES] >> 16), false);
+    }
+    b->stage[BENCH_MOVING_AVERAGE].ns = (double) (dsp_time_ns() - start) / iterations;
+    free(avg->arr_numbers);
+    free(avg);
+
+    start = dsp_time_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+	f += fm_amp_to_dB(meter_abs(signal[i % BENCH_SIGNAL_FRAMES]));
+    }
+    b->stage[BENCH_AMP_TO_DB].ns = (double) (dsp_time_ns() - start) / iterations;
+
+    start = dsp_time_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+	f += fm_dB_to_ratio(-(float) (i & 0x3f));
+    }
+    b->stage[BENCH_DB_TO_RATIO].ns = (double) (dsp_time_ns() - start) / iterations;
+
+    sink = f + scratch[0];
+}
+
+void dsp_bench_print(dsp_bench *b, uint32_t cpu_hz) {
+    double period_ns = 1e9 / b->sample_rate;
+    printf("dsp bench: %luHz, %lu frame blocks (%.2fus budget), %s kernel, %lu iterations\n",
+	   (unsigned long) b->sample_rate, (unsigned long) b->block_frames,
+	   period_ns * b->block_frames / 1000, CHANNEL_KERNEL_NAME,
+	   (unsigned long) b->iterations);
+    printf("%-22s %10s %10s %10s %12s %7s%s\n", "stage", "ns/call", "us/block", "ns/sample", "samples/s", "load", cpu_hz ? "  cycles/sample" : "");
+    for (int s = 0; s < BENCH_STAGES; s++) {
+	dsp_bench_stage *st = &b->stage[s];
+	if (st->frames == 0) {
+	    printf("%-22s %10.1f %10s %10s %12s %7s", st->name, st->ns, "-", "-", "-", "-");
+	    if (cpu_hz) printf("  %8.0f/call", st->ns * cpu_hz / 1e9);
+	} else {
+	    double per_sample = st->ns / st->frames;
+	    printf("%-22s %10.1f %10.3f %10.1f %12.0f %6.1f%%", st->name, st->ns,
+		   per_sample * b->block_frames / 1000, per_sample, (per_sample > 0) ? 1e9 / per_sample : 0,
+		   100 * per_sample / period_ns);
+	    if (cpu_hz) printf("  %13.0f", per_sample * cpu_hz / 1e9);
+	}
+	printf("\n");
+    }
+}
+
+void dsp_bench_print_json(dsp_bench *b, uint32_t cpu_hz) {
+    double period_ns = 1e9 / b->sample_rate;
+    printf("{\n  \"sample_rate\": %lu,\n  \"block_frames\": %lu,\n  \"iterations\": %lu,\n",
+	   (unsigned long) b->sample_rate, (unsigned long) b->block_frames, (unsigned long) b->iterations);
+    // the interpolator kernel is the Q31 one with the mix, balance and
+    // saturation moved to the interpolators, so it is fixed point too
+#if defined(DSP_FIXED_POINT) || defined(DSP_INTERP)
+    printf("  \"fixed_point\": true,\n");
+#else
+    printf("  \"fixed_point\": false,\n");
+#endif
+#ifdef DSP_INTERP
+    printf("  \"interp\": true,\n");
+#else
+    printf("  \"interp\": false,\n");
+#endif
+    printf("  \"kernel\": \"%s\",\n", CHANNEL_KERNEL_NAME);
+    printf("  \"budget_ns_per_sample\": %.1f,\n", period_ns);
+    if (cpu_hz) printf("  \"cpu_hz\": %lu,\n", (unsigned long) cpu_hz);
+    printf("  \"stages\": [\n");
+    for (int s = 0; s < BENCH_STAGES; s++) {
+	dsp_bench_stage *st = &b->stage[s];
+	printf("    { \"name\": \"%s\", \"ns_per_call\": %.2f, \"calls_per_sec\": %.0f",
+	       st->name, st->ns, (st->ns > 0) ? 1e9 / st->ns : 0);
+	if (st->frames > 0) {
+	    double per_sample = st->ns / st->frames;
+	    printf(", \"frames_per_call\": %lu, \"ns_per_sample\": %.3f, \"samples_per_sec\": %.0f, \"load_pct\": %.3f",
+		   (unsigned long) st->frames, per_sample, (per_sample > 0) ? 1e9 / per_sample : 0,
+		   100 * per_sample / period_ns);
+	    if (cpu_hz) printf(", \"cycles_per_sample\": %.1f", per_sample * cpu_hz / 1e9);
+	} else if (cpu_hz) {
+	    printf(", \"cycles_per_call\": %.1f", st->ns * cpu_hz / 1e9);
+	}
+	printf(" }%s\n", (s < BENCH_STAGES - 1) ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
@@ -0,0 +1,59 @@
+/* DSP Bench
+   Micro-benchmarks of the channel DSP stages, built into the firmware
+   (the F command) and the host dsp_bench tool, so the two report the
+   same stages the same way.
+
+   Each stage is run for a number of iterations on a fixed-seed test
+   signal: noise whose level steps between loud and quiet every 1024
+   frames, so the compressor and gate move in both directions.  Audio
+   stages process one DMA block per call, the control stages run once
+   per block, the helpers (moving average, dB conversions) are timed
+   per call.
+
+   The cost per sample (stereo frame) is compared against the sample
+   period, which is the whole budget of the audio interrupt.
+*/
+
+#ifndef __DSP_BENCH__
+#define __DSP_BENCH__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define DSP_BENCH_MAX_FRAMES 256
+
+enum dsp_bench_stages {
+    BENCH_PROCESS_AUDIO,      // kernel with the filters and sends off
+    BENCH_PROCESS_SENDS,      // kernel building the sends too
+    BENCH_PROCESS_FILTERED,   // kernel with the sends and the high and low pass on
+    BENCH_BIQUAD,             // the four filter sections alone
+    BENCH_LIMITER,
+    BENCH_COMPRESS,           // one control tick of the compressor
+    BENCH_GATE,
+    BENCH_MOVING_AVERAGE,
+    BENCH_AMP_TO_DB,
+    BENCH_DB_TO_RATIO,
+    BENCH_STAGES
+};
+
+typedef struct dsp_bench_stage {
+    const char *name;
+    uint32_t frames;          // frames covered by one call, 0 if not per sample
+    double ns;                // per call
+} dsp_bench_stage;
+
+typedef struct dsp_bench {
+    uint32_t sample_rate;
+    uint32_t block_frames;
+    uint32_t iterations;
+    dsp_bench_stage stage[BENCH_STAGES];
+} dsp_bench;
+
+void dsp_bench_run(dsp_bench *b, uint32_t sample_rate, uint32_t block_frames, uint32_t iterations);
+
+// cpu_hz, if not 0, adds the cost in cycles at that clock
+
+void dsp_bench_print(dsp_bench *b, uint32_t cpu_hz);
+void dsp_bench_print_json(dsp_bench *b, uint32_t cpu_hz);
+
+#endif
@@ -0,0 +1,129 @@
+/* DSP platform shim
+   Small set of definitions that lets the channel DSP library code
+   build either for the RP2040 (pico SDK) or on a host workstation.
+
+   On the device the pico float helpers are used, since float2int
+   saturates and rounds toward -infinity.  The host versions
+   reproduce that behaviour so results match bit for bit.
+
+   dsp_barrier() orders memory accesses between the audio interrupt
+   and the control loop (a DMB on the device).  dsp_signal() and
+   dsp_wait() let the control loop sleep until the interrupt has
+   something for it (SEV/WFE on the device, no-ops on the host).
+
+   dsp_time_ns() is a monotonic clock for benchmarks, microsecond
+   resolution on the device.
+
+   dsp_cycles() is a free running cycle counter for timing short
+   sections such as the audio interrupt, read with dsp_cycles_since().
+   On the device it is the core's 24 bit SysTick counting system clocks,
+   so it wraps after ~130ms at 125MHz and dsp_cycle_timer_init() must
+   be called on the core doing the timing.  On the host it counts
+   nanoseconds.
+
+   Define DSP_HOST when building off-target.
+*/
+
+#ifndef __DSP_PLATFORM__
+#define __DSP_PLATFORM__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef DSP_HOST
+
+#include <math.h>
+#include <time.h>
+
+static inline float int2float(int32_t i) {
+    return (float) i;
+}
+
+static inline int32_t float2int(float f) {
+    if (f >= 2147483648.0f) return INT32_MAX;
+    if (f <= -2147483648.0f) return INT32_MIN;
+    return (int32_t) floorf(f);
+}
+
+static inline void dsp_barrier(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static inline void dsp_signal(void) {
+}
+
+static inline void dsp_wait(void) {
+}
+
+static inline uint64_t dsp_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline void dsp_cycle_timer_init(void) {
+}
+
+static inline uint32_t dsp_cycles_hz(void) {
+    return 1000000000;
+}
+
+static inline uint32_t dsp_cycles(void) {
+    return (uint32_t) dsp_time_ns();
+}
+
+static inline uint32_t dsp_cycles_since(uint32_t start) {
+    return dsp_cycles() - start;
+}
+
+#else
+
+#include "pico/float.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include "hardware/clocks.h"
+#include "hardware/structs/systick.h"
+
+static inline void dsp_barrier(void) {
+    __dmb();
+}
+
+static inline void dsp_signal(void) {
+    __sev();
+}
+
+static inline void dsp_wait(void) {
+    __wfe();
+}
+
+static inline uint64_t dsp_time_ns(void) {
+    return time_us_64() * 1000;
+}
+
+#define DSP_CYCLES_MASK 0xFFFFFF
+
+// SysTick from the processor clock, free running over the full 24 bits
+static inline void dsp_cycle_timer_init(void) {
+    systick_hw->csr = 0;
+    systick_hw->rvr = DSP_CYCLES_MASK;
+    systick_hw->cvr = 0;
+    systick_hw->csr = 0x5;  // CLKSOURCE | ENABLE
+}
+
+static inline uint32_t dsp_cycles_hz(void) {
+    return clock_get_hz(clk_sys);
+}
+
+// SysTick counts down
+static inline uint32_t dsp_cycles(void) {
+    return DSP_CYCLES_MASK - systick_hw->cvr;
+}
+
+static inline uint32_t dsp_cycles_since(uint32_t start) {
+    return (dsp_cycles() - start) & DSP_CYCLES_MASK;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,166 @@
+/* Dynamics
+   Control-rate noise gate and compressor envelope.
+*/
+
+#include <math.h>
+#include "dynamics.h"
+#include "fastmath.h"
+
+#define min(X, Y) ((X) < (Y) ? (X) : (Y))
+#define max(X, Y) ((X) > (Y) ? (X) : (Y))
+#define clamp(V, X, Y) min(Y,max(X,V))
+
+// one pole coefficient reaching 1 - 1/e of a step in time_ms
+
+static float envelope_coef(float tick_ms, uint16_t time_ms, uint32_t min_steps) {
+    float ticks = time_ms / tick_ms;
+    if (ticks < min_steps) ticks = min_steps;
+    return 1.0f - expf(-1.0f / ticks);
+}
+
+// linear ramp step covering 0 - 1 in time_ms
+
+static float ramp_step(float tick_ms, uint16_t time_ms) {
+    if (time_ms == 0) return 1.0f;
+    return min(1.0f, tick_ms / time_ms);
+}
+
+void dynamics_init(dynamics *d, float control_rate_hz) {
+    d->tick_ms = 1000.0f / control_rate_hz;
+    d->threshold_dB = 1.0;  // forces the first dynamics_set_curve to build
+    d->ratio = 1.0;
+    d->knee_dB = 0;
+    dynamics_set_curve(d, 0, 1.0, 0);
+    d->min_steps = 1;
+    d->attack_ms = 0;
+    d->release_ms = 0;
+    d->attack_coef = envelope_coef(d->tick_ms, 0, 1);
+    d->release_coef = d->attack_coef;
+    d->target_gain = 1.0;
+    d->gain = 1.0;
+    d->gate_threshold = 0;
+    d->gate_attack_step = 1.0;
+    d->gate_release_step = 1.0;
+    d->gate_hold_ticks = 0;
+    d->gate_attack_ms = 0;
+    d->gate_hold_ms = 0;
+    d->gate_release_ms = 0;
+    d->gate_below_ticks = 0;
+    d->gate_gain = 1.0;
+    d->gate_open = false;
+}
+
+void dynamics_set_rate(dynamics *d, float control_rate_hz) {
+    d->tick_ms = 1000.0f / control_rate_hz;
+    d->attack_coef = envelope_coef(d->tick_ms, d->attack_ms, d->min_steps);
+    d->release_coef = envelope_coef(d->tick_ms, d->release_ms, d->min_steps);
+    d->gate_attack_step = ramp_step(d->tick_ms, d->gate_attack_ms);
+    d->gate_release_step = ramp_step(d->tick_ms, d->gate_release_ms);
+    d->gate_hold_ticks = (uint32_t) (d->gate_hold_ms / d->tick_ms);
+}
+
+/* Gain reduction in dB for an input level x, threshold T, ratio R and
+ * knee width W:
+ *   x <= T - W/2         0
+ *   x >= T + W/2         (T + (x - T) / R) - x
+ *   in the knee          (1/R - 1) * (x - T + W/2)^2 / 2W
+ */
+
+static float curve_reduction_dB(float x, float threshold, float ratio, float knee) {
+    float over = x - threshold;
+    if (2 * over <= -knee) return 0;
+    if (2 * over >= knee) return over / ratio - over;
+    float k = over + (knee / 2);
+    return ((1.0f / ratio) - 1.0f) * k * k / (2 * knee);
+}
+
+void dynamics_set_curve(dynamics *d, float threshold_dB, float ratio, float knee_dB) {
+    ratio = max(1.0f, ratio);
+    knee_dB = max(0.0f, knee_dB);
+    if (threshold_dB == d->threshold_dB && ratio == d->ratio && knee_dB == d->knee_dB) return;
+    d->threshold_dB = threshold_dB;
+    d->ratio = ratio;
+    d->knee_dB = knee_dB;
+    for (int i = 0; i < DYN_CURVE_SIZE; i++) {
+	float x = DYN_CURVE_MIN_DB + (i * DYN_CURVE_STEP_DB);
+	d->curve[i] = fm_dB_to_ratio(curve_reduction_dB(x, threshold_dB, ratio, knee_dB));
+    }
+}
+
+float dynamics_curve_gain(dynamics *d, int32_t amp) {
+    float x = (fm_amp_to_dB(amp) - DYN_CURVE_MIN_DB) * (1.0f / DYN_CURVE_STEP_DB);
+    if (x <= 0) return d->curve[0];
+    if (x >= DYN_CURVE_SIZE - 1) return d->curve[DYN_CURVE_SIZE - 1];
+    int i = (int) x;
+    return d->curve[i] + ((x - i) * (d->curve[i+1] - d->curve[i]));
+}
+
+void dynamics_set_times(dynamics *d, uint16_t attack_ms, uint16_t release_ms, uint32_t min_steps) {
+    min_steps = max(1, min_steps);
+    if (attack_ms == d->attack_ms && release_ms == d->release_ms && min_steps == d->min_steps) return;
+    d->attack_ms = attack_ms;
+    d->release_ms = release_ms;
+    d->min_steps = min_steps;
+    d->attack_coef = envelope_coef(d->tick_ms, attack_ms, min_steps);
+    d->release_coef = envelope_coef(d->tick_ms, release_ms, min_steps);
+}
+
+void dynamics_set_gate(dynamics *d, int32_t threshold, uint16_t attack_ms, uint16_t hold_ms, uint16_t release_ms) {
+    d->gate_threshold = threshold;
+    if (attack_ms == d->gate_attack_ms && hold_ms == d->gate_hold_ms && release_ms == d->gate_release_ms) return;
+    d->gate_attack_ms = attack_ms;
+    d->gate_hold_ms = hold_ms;
+    d->gate_release_ms = release_ms;
+    d->gate_attack_step = ramp_step(d->tick_ms, attack_ms);
+    d->gate_release_step = ramp_step(d->tick_ms, release_ms);
+    d->gate_hold_ticks = (uint32_t) (hold_ms / d->tick_ms);
+}
+
+float dynamics_gate(dynamics *d, int32_t amp_l, int32_t amp_r, bool active, uint32_t ticks) {
+    if (!active) {
+	d->gate_gain = 1.0;
+	return d->gate_gain;
+    }
+    if ((amp_l >= d->gate_threshold) || (amp_r >= d->gate_threshold)) {
+	d->gate_below_ticks = 0;  // reset our timer for when we fall below
+	d->gate_gain = min(1.0f, d->gate_gain + (ticks * d->gate_attack_step));
+	d->gate_open = true;
+    } else {
+	// only close once we are past the hold time
+	d->gate_below_ticks += ticks;
+	if ((d->gate_below_ticks > d->gate_hold_ticks) && (d->gate_gain > 0)) {
+	    d->gate_open = false;
+	    d->gate_gain = max(0.0f, d->gate_gain - (ticks * d->gate_release_step));
+	}
+    }
+    return d->gate_gain;
+}
+
+// x^n by squaring, a multiply or two per bit of n
+
+static float power(float x, uint32_t n) {
+    float r = 1.0f;
+    while (n) {
+	if (n & 1) r *= x;
+	x *= x;
+	n >>= 1;
+    }
+    return r;
+}
+
+/* The target gain comes from the static curve.  The gain follows it
+ * with the attack coefficient when it has to come down and the release
+ * coefficient when it can go back up.  Over several ticks (the loop
+ * fell behind) each leaves (1 - coef) of the distance to the target,
+ * so the steps are taken at once in closed form rather than a tick at
+ * a time.
+ */
+
+float dynamics_compress(dynamics *d, int32_t amp, uint32_t ticks) {
+    d->target_gain = dynamics_curve_gain(d, amp);
+
+    float coef = (d->target_gain < d->gain) ? d->attack_coef : d->release_coef;
+    float gain = d->target_gain + (d->gain - d->target_gain) * power(1.0f - coef, ticks);
+    d->gain = clamp(gain, 0.0f, 1.0f);
+    return d->gain;
+}
@@ -0,0 +1,86 @@
+/* Dynamics
+   Control-rate noise gate and compressor envelope.
+
+   One control tick is one DMA block, so the tick period is fixed by
+   the sample rate and block size instead of by how long the control
+   loop happens to take.  Time constants are converted to per-tick
+   coefficients when they change:
+
+     compressor  gain += coef * (target - gain), with
+                 coef = 1 - exp(-tick / time_constant), using the
+                 attack coefficient while the gain is falling and
+                 the release coefficient while it is rising
+     gate        linear ramp of tick / time per tick, so the gate
+                 fully opens in gate_attack_ms and closes in
+                 gate_release_ms after the hold time.
+
+   The compressor's static curve (threshold, ratio and soft knee) is
+   computed in the dB domain into a table of linear gains over input
+   level, rebuilt only when one of the three changes.  Each tick the
+   target gain is then one table lookup on the input level in dB.
+
+   All amplitudes are absolute sample values (Q31 codec words).
+*/
+
+#ifndef __DYNAMICS__
+#define __DYNAMICS__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// the gain table covers input levels from DYN_CURVE_MIN_DB to 0dBFS
+#define DYN_CURVE_MIN_DB -96.0f
+#define DYN_CURVE_STEP_DB 0.25f
+#define DYN_CURVE_SIZE 385
+
+typedef struct dynamics {
+    float tick_ms;            // control period in milliseconds
+
+    // compressor
+    float threshold_dB;       // the settings the curve was built from
+    float ratio;              // input dB over the threshold per output dB
+    float knee_dB;            // width of the soft knee around the threshold
+    float curve[DYN_CURVE_SIZE];  // linear gain by input level
+    float attack_coef;        // per-tick envelope coefficients
+    float release_coef;
+    uint16_t attack_ms;       // the settings the coefficients were computed from
+    uint16_t release_ms;
+    uint32_t min_steps;       // minimum ticks for a time constant of 0ms
+    float target_gain;        // instantaneous gain demanded by the input level
+    float gain;               // smoothed compressor gain (0 - 1)
+
+    // gate
+    int32_t gate_threshold;   // sample value at which the gate opens
+    float gate_attack_step;   // per-tick gain change when opening/closing
+    float gate_release_step;
+    uint32_t gate_hold_ticks; // ticks to hold open once below the threshold
+    uint16_t gate_attack_ms;  // the settings the steps and hold were computed from
+    uint16_t gate_hold_ms;
+    uint16_t gate_release_ms;
+    uint32_t gate_below_ticks;
+    float gate_gain;          // current gate gain (0 - 1)
+    bool gate_open;
+} dynamics;
+
+void dynamics_init(dynamics *d, float control_rate_hz);
+
+// a new control rate, keeping the settings and the current gains
+void dynamics_set_rate(dynamics *d, float control_rate_hz);
+
+// settings, cheap to call repeatedly - coefficients are only
+// recomputed when a value changes
+
+void dynamics_set_curve(dynamics *d, float threshold_dB, float ratio, float knee_dB);
+void dynamics_set_times(dynamics *d, uint16_t attack_ms, uint16_t release_ms, uint32_t min_steps);
+void dynamics_set_gate(dynamics *d, int32_t threshold, uint16_t attack_ms, uint16_t hold_ms, uint16_t release_ms);
+
+// static curve gain for an input level, no smoothing
+float dynamics_curve_gain(dynamics *d, int32_t amp);
+
+// advance by ticks control periods (normally 1; more if the control
+// loop fell behind the audio interrupt)
+
+float dynamics_gate(dynamics *d, int32_t amp_l, int32_t amp_r, bool active, uint32_t ticks);
+float dynamics_compress(dynamics *d, int32_t amp, uint32_t ticks);
+
+#endif
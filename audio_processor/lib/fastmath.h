@@ -0,0 +1,45 @@
+/* Fast Math
+   Table driven log2/exp2 for the control paths (dB conversions,
+   gain computation) in place of the soft float log10f/powf.
+
+   Both functions split the float into exponent and mantissa with
+   integer operations and look the mantissa up in a 65 entry table
+   with linear interpolation, so the cost is a few integer multiplies
+   and one int/float conversion.
+
+   Accuracy over the full float range (checked by host/fastmath_bench):
+     fm_log2  within 6e-5 of log2(x)    (0.0004dB)
+     fm_exp2  within 2e-5 relative     (0.0002dB)
+   The dB helpers are therefore good to well under 0.05dB.
+
+   This file is shared by the audio_processor and controller firmware;
+   keep the two copies the same.
+*/
+
+#ifndef __FASTMATH__
+#define __FASTMATH__
+
+#include <stdint.h>
+
+#define FM_DB_PER_LOG2 6.0205999f     // 20 * log10(2)
+#define FM_LOG2_PER_DB 0.16609640f    // 1 / FM_DB_PER_LOG2
+#define FM_LOG10_PER_LOG2 0.30103000f // log10(2)
+#define FM_LOG2_FLOOR -32.0f          // returned for x <= 0 or NaN (about -192dB)
+#define FM_LOG2_CEILING 128.0f        // returned for +inf
+#define FM_DB_FLOOR -192.0f           // returned for an amplitude <= 0
+
+float fm_log2(float x);
+float fm_exp2(float x);       // 0 below 2^-126 and for NaN, 2^127 at most
+
+// decibels from a ratio where 1 is 0dB, and back
+
+float fm_ratio_to_dB(float ratio);
+float fm_dB_to_ratio(float dB);
+
+// decibels relative to full scale (INT32_MAX) of an absolute sample
+// value, and back
+
+float fm_amp_to_dB(int32_t amp);
+int32_t fm_dB_to_amp(float dB);
+
+#endif
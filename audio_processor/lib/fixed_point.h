@@ -0,0 +1,94 @@
+/* Fixed point helpers for the audio path
+
+   Codec words are Q31 (the 24-bit sample left justified in an int32,
+   so the bottom 8 bits are always zero).  Inside the kernel a sample
+   is carried as Q4.27: shifting the codec word down by Q_HEADROOM
+   bits costs nothing in resolution (4 guard bits remain below the
+   24-bit LSB) and gives +24dB of headroom between stages, so trim and
+   makeup gain don't clip until the final conversion back to Q31.
+
+   Gains that need headroom (input trim up to 3x, makeup up to +24dB,
+   balance up to 2x) are Q4.27.  Coefficients bounded by unity (the
+   output mix weights) are Q1.30.
+
+   All multiplies are 32x32->64 followed by an arithmetic shift, which
+   like float2int rounds toward -infinity, then saturate to 32 bits.
+*/
+
+#ifndef __FIXED_POINT__
+#define __FIXED_POINT__
+
+#include <stdint.h>
+
+#define Q30_SHIFT 30
+#define Q27_SHIFT 27
+#define Q_HEADROOM 4
+
+#define Q30_ONE (1 << Q30_SHIFT)
+#define Q27_ONE (1 << Q27_SHIFT)
+
+// largest gain representable as Q4.27
+#define Q27_MAX_GAIN 15.999f
+
+// saturate a 64 bit intermediate to 32 bits
+
+static inline int32_t q_sat32(int64_t v) {
+    if (v > INT32_MAX) return INT32_MAX;
+    if (v < INT32_MIN) return INT32_MIN;
+    return (int32_t) v;
+}
+
+// Q31 codec word * Q4.27 gain -> Q4.27 sample
+
+static inline int32_t q31_gain_in(int32_t word, int32_t gain) {
+    return q_sat32(((int64_t) word * gain) >> (Q27_SHIFT + Q_HEADROOM));
+}
+
+// Q4.27 sample * Q4.27 gain -> Q4.27 sample
+
+static inline int32_t q27_mul(int32_t sample, int32_t gain) {
+    return q_sat32(((int64_t) sample * gain) >> Q27_SHIFT);
+}
+
+// Q4.27 sample * Q4.27 gain -> Q31 codec word, saturated to full scale
+
+static inline int32_t q27_gain_out(int32_t sample, int32_t gain) {
+    return q_sat32(((int64_t) sample * gain) >> (Q27_SHIFT - Q_HEADROOM));
+}
+
+// a*ca + b*cb with Q1.30 coefficients, single rounding
+
+static inline int32_t q30_mac2(int32_t a, int32_t ca, int32_t b, int32_t cb) {
+    return q_sat32((((int64_t) a * ca) + ((int64_t) b * cb)) >> Q30_SHIFT);
+}
+
+// num / den in Q1.30, for 0 <= num <= den.  Two 32 bit divides (the
+// SIO divider on the device) rather than a software 64 bit one: den
+// is normalised to bit 30, a first quotient is taken to 16 bits
+// against its top 16 bits, and the remainder divided out the same way
+// refines it.  Within 2^-27 of the exact ratio.
+
+static inline int32_t q30_ratio(int32_t num, int32_t den) {
+    int n = __builtin_clz((uint32_t) den) - 1;
+    uint32_t d = (uint32_t) den << n;          // 2^30 to 2^31 - 1
+    uint32_t a = (uint32_t) num << n;          // a <= d
+    uint32_t q = (a << 1) / ((d >> 15) + 1);   // Q16, low by at most 5
+    uint32_t r = a - (uint32_t) (((uint64_t) q * d) >> 16);
+    return (int32_t) ((q << 14) + (r << 13) / ((d >> 17) + 1));
+}
+
+// conversions from the control side floats (not for use per sample)
+
+static inline int32_t float_to_q27(float f) {
+    if (f > Q27_MAX_GAIN) f = Q27_MAX_GAIN;
+    if (f < -Q27_MAX_GAIN) f = -Q27_MAX_GAIN;
+    return (int32_t) (f * (float) Q27_ONE);
+}
+
+static inline int32_t float_to_q30(float f) {
+    if (f >= 1.99999f) return INT32_MAX;
+    if (f <= -2.0f) return INT32_MIN;
+    return (int32_t) (f * (float) Q30_ONE);
+}
+
+#endif
@@ -0,0 +1,114 @@
+/* Input Monitor
+   Block totals of the DMA sniffer readings, and the reports made from
+   them.
+*/
+
+#include "input_monitor.h"
+#include "dsp_platform.h"
+#include "sram_banks.h"
+
+#define SUM_LIMIT 2147483648LL      // a block sum must stay under 2^31
+
+static const char *mode_names[] = {
+    "sum",
+    "crc"
+};
+
+void input_monitor_init(input_monitor *m, uint8_t mode) {
+    m->request = mode;
+    m->mode = mode;
+    m->settle = INPUT_MONITOR_SETTLE;
+    m->last_sniff = 0;
+    m->last_check = 0;
+    m->seq = 0;
+    m->blocks = 0;
+    m->summed = 0;
+    m->words = 0;
+    m->total = 0;
+    m->repeats = 0;
+    m->report_blocks = 0;
+    m->report_summed = 0;
+    m->report_words = 0;
+    m->report_total = 0;
+    m->dc = 0;
+}
+
+void input_monitor_set_mode(input_monitor *m, uint8_t mode) {
+    m->request = mode;
+}
+
+const char *input_monitor_mode_name(uint8_t mode) {
+    return (mode <= INPUT_MONITOR_CRC) ? mode_names[mode] : "?";
+}
+
+void SRAM_ISR_FUNC(input_monitor_block)(input_monitor *m, uint32_t sniff, int32_t block_in, size_t num_frames) {
+    uint32_t words = num_frames * 2;
+    uint32_t seq = m->seq;
+    uint32_t check;
+    bool crc;
+
+    if (m->request != m->mode) {
+	m->mode = m->request;
+	m->settle = INPUT_MONITOR_SETTLE;
+    }
+    crc = (m->mode == INPUT_MONITOR_CRC);
+    check = crc ? sniff : sniff - m->last_sniff;
+    m->last_sniff = sniff;
+
+    m->seq = seq + 1;
+    dsp_barrier();
+    m->blocks++;
+    if (m->settle > 0) {
+	m->settle--;
+	m->repeats = 0;
+    } else {
+	m->repeats = (block_in != 0 && check == m->last_check) ? m->repeats + 1 : 0;
+	if (!crc && ((int64_t) block_in + 1) * words < SUM_LIMIT) {
+	    m->total += (int32_t) check;
+	    m->summed++;
+	    m->words += words;
+	}
+    }
+    dsp_barrier();
+    m->seq = seq + 2;
+
+    m->last_check = check;
+}
+
+void input_monitor_report(input_monitor *m, input_report *r, uint32_t stuck_blocks, float drift_limit) {
+    uint32_t seq;
+    uint32_t blocks, summed, words, repeats;
+    int64_t total;
+    uint8_t mode;
+
+    do {
+	seq = m->seq;
+	if (seq & 1) continue;  // update in progress
+	dsp_barrier();
+	mode = m->mode;
+	blocks = m->blocks;
+	summed = m->summed;
+	words = m->words;
+	total = m->total;
+	repeats = m->repeats;
+	dsp_barrier();
+    } while ((seq & 1) || (m->seq != seq));
+
+    uint32_t new_blocks = blocks - m->report_blocks;
+    uint32_t new_summed = summed - m->report_summed;
+    uint32_t new_words = words - m->report_words;
+    if (new_words > 0) {
+	m->dc = (float) ((double) (total - m->report_total) / new_words / SUM_LIMIT);
+    }
+    m->report_blocks = blocks;
+    m->report_summed = summed;
+    m->report_words = words;
+    m->report_total = total;
+
+    r->mode = mode;
+    r->dc = m->dc;
+    r->coverage = new_blocks ? (float) new_summed / new_blocks : 0;
+    r->repeats = repeats;
+    r->stuck = (repeats >= stuck_blocks);
+    r->drift = (r->dc >= drift_limit) || (r->dc <= -drift_limit);
+}
@@ -0,0 +1,104 @@
+/* Input Monitor
+   DC offset and stuck data checks on the codec input.  The DMA sniffer
+   does the arithmetic as the input DMA moves the samples, so the audio
+   interrupt's per-sample loop is unchanged; the interrupt only hands
+   over one sniffer reading per block.
+
+   In sum mode the sniffer adds up every word the input channel moves,
+   modulo 2^32.  The difference between one block's reading and the
+   last is the sum of the block, both channels together (the sniffer
+   sees them interleaved), and is added to a 64 bit total.  A block's
+   sum only fits in 32 bits if the block is quiet enough: 2n words no
+   louder than p sum to at most 2n(p + 1), so blocks whose input peak
+   (block_in, from the block meter) could take the sum past 2^31 are
+   left out.  That is anything over -18dBFS with 4 frame blocks, -42dBFS
+   with 64, well above any offset worth reporting.  The coverage says
+   how many blocks the offset was measured on.
+
+   In CRC mode the sniffer runs a CRC-32 over each block instead, and
+   the interrupt reseeds it as it takes the reading.
+
+   In either mode a block whose sum or CRC matches the last block's is
+   a repeat.  A run of repeats on an input that isn't silent (a zero
+   peak isn't counted) is data stuck in the codec or the DMA ring: live
+   input, even the noise floor, never sums the same twice in a row for
+   long.  The CRC also catches a ring replaying the same block, which
+   a constant sum can't tell from a stuck word.
+
+   The reading is taken as the interrupt starts, a little after the
+   block completes, so a word of the next block may land on either
+   side.  The total still counts every word once.
+
+   As with the interrupt profile, the interrupt is the only writer.  A
+   mode change from the control side is a request the interrupt picks
+   up at its next block; it then leaves out the next two blocks while
+   the sniffer settles into the new mode.
+*/
+
+#ifndef __INPUT_MONITOR__
+#define __INPUT_MONITOR__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+enum {
+    INPUT_MONITOR_SUM,
+    INPUT_MONITOR_CRC
+};
+
+#define INPUT_MONITOR_SETTLE 2      // blocks left out after a mode change
+
+typedef struct input_monitor {
+    volatile uint8_t request;       // mode requested by the control side
+    uint8_t mode;                   // mode in use by the interrupt
+    uint8_t settle;                 // blocks still to leave out
+    uint32_t last_sniff;            // reading at the last block
+    uint32_t last_check;            // sum or CRC of the last block
+
+    volatile uint32_t seq;          // odd while the interrupt is writing
+    volatile uint32_t blocks;       // blocks seen
+    volatile uint32_t summed;       // blocks in the total
+    volatile uint32_t words;        // words in the total
+    volatile int64_t total;         // sum of the summed blocks
+    volatile uint32_t repeats;      // current run of repeated blocks
+
+    // control side, the totals at the last report
+    uint32_t report_blocks;
+    uint32_t report_summed;
+    uint32_t report_words;
+    int64_t report_total;
+    float dc;                       // last offset measured
+} input_monitor;
+
+typedef struct input_report {
+    uint8_t mode;
+    float dc;                       // offset as a fraction of full scale
+    float coverage;                 // fraction of the blocks it was measured on
+    uint32_t repeats;               // current run of repeated blocks
+    bool stuck;                     // repeats over the stuck limit
+    bool drift;                     // offset over the drift limit
+} input_report;
+
+void input_monitor_init(input_monitor *m, uint8_t mode);
+
+// control side: the interrupt switches at its next block.  Change the
+// sniffer's own mode to match (i2s_sniff_input) first.
+void input_monitor_set_mode(input_monitor *m, uint8_t mode);
+
+/* interrupt side, once per block after the kernel has published its
+ * peaks: sniff is the sniffer reading taken as the interrupt started
+ * (reseeding it in CRC mode), block_in the block's input peak.
+ */
+void input_monitor_block(input_monitor *m, uint32_t sniff, int32_t block_in, size_t num_frames);
+
+/* control side: the offset and flags since the last report.  The
+ * offset is kept from the last report if no block since was quiet
+ * enough to sum.  stuck_blocks is the run of repeats taken as stuck,
+ * drift_limit the offset (fraction of full scale) taken as drift.
+ */
+void input_monitor_report(input_monitor *m, input_report *r, uint32_t stuck_blocks, float drift_limit);
+
+const char *input_monitor_mode_name(uint8_t mode);
+
+#endif
@@ -0,0 +1,95 @@
+/* IRQ Profile
+   Timing and overrun (xrun) counts for the audio interrupt.
+*/
+
+#include <stdio.h>
+#include "irq_profile.h"
+#include "sram_banks.h"
+
+static void clear(irq_profile *p) {
+    p->count = 0;
+    p->min = UINT32_MAX;
+    p->max = 0;
+    p->total = 0;
+    for (int i = 0; i < IRQ_PROFILE_BINS; i++) {
+	p->hist[i] = 0;
+    }
+    p->in_xruns = 0;
+    p->out_xruns = 0;
+}
+
+void irq_profile_init(irq_profile *p, uint32_t cycles_hz, uint32_t block_frames, uint32_t sample_rate) {
+    p->cycles_hz = cycles_hz;
+    p->last_block = 0;
+    clear(p);
+    irq_profile_set_period(p, block_frames, sample_rate);
+}
+
+void irq_profile_set_period(irq_profile *p, uint32_t block_frames, uint32_t sample_rate) {
+    p->period = (uint32_t) (((uint64_t) p->cycles_hz * block_frames) / sample_rate);
+    p->reset = true;
+}
+
+void irq_profile_reset(irq_profile *p) {
+    p->reset = true;
+}
+
+void SRAM_ISR_FUNC(irq_profile_record)(irq_profile *p, uint8_t block, uint8_t done_block, uint8_t ring_blocks, uint32_t busy) {
+    uint8_t mask = ring_blocks - 1;
+    if (p->reset) {
+	clear(p);
+	p->last_block = (block - 1) & mask;
+	p->reset = false;
+    }
+
+    // blocks the ring moved on since the last interrupt, a whole lap
+    // looks like none
+    uint8_t advanced = (block - p->last_block) & mask;
+    if (advanced == 0) advanced = ring_blocks;
+    p->in_xruns += advanced - 1;
+    if (((done_block - block) & mask) >= ring_blocks - 1) {
+	p->out_xruns++;
+    }
+    p->last_block = block;
+
+    p->count++;
+    p->total += busy;
+    if (busy < p->min) p->min = busy;
+    if (busy > p->max) p->max = busy;
+    uint32_t bin = (busy * 10) / p->period;
+    if (bin >= IRQ_PROFILE_BINS) bin = IRQ_PROFILE_BINS - 1;
+    p->hist[bin]++;
+}
+
+void irq_profile_print(irq_profile *p) {
+    float us = 1000000.0f / p->cycles_hz;
+    uint32_t count = p->count;
+    uint32_t min = p->min;
+    uint32_t max = p->max;
+    float avg = count ? (float) p->total / count : 0;
+    uint32_t peak = 1;
+
+    printf("block period: %.2fus (%lu cycles)\n", p->period * us, (unsigned long) p->period);
+    if (count == 0) {
+	printf("no blocks recorded\n");
+	return;
+    }
+    printf("blocks: %lu   busy min %.2fus  avg %.2fus  max %.2fus  (%.0f%% / %.0f%% / %.0f%% of the period)\n",
+	   (unsigned long) count, min * us, avg * us, max * us,
+	   (100.0f * min) / p->period, (100.0f * avg) / p->period, (100.0f * max) / p->period);
+    printf("input xruns: %lu   output xruns: %lu\n", (unsigned long) p->in_xruns, (unsigned long) p->out_xruns);
+    for (int i = 0; i < IRQ_PROFILE_BINS; i++) {
+	if (p->hist[i] > peak) peak = p->hist[i];
+    }
+    for (int i = 0; i < IRQ_PROFILE_BINS; i++) {
+	uint32_t n = p->hist[i];
+	if (i < IRQ_PROFILE_BINS - 1) {
+	    printf("  %3d-%3d%%  ", i * 10, (i + 1) * 10);
+	} else {
+	    printf("     >100%%  ");
+	}
+	int bar = (int) ((40ULL * n + peak - 1) / peak);
+	for (int b = 0; b < bar; b++) putchar('#');
+	printf("%*s %lu\n", 41 - bar, "", (unsigned long) n);
+    }
+}
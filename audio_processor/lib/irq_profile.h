@@ -0,0 +1,58 @@
+/* IRQ Profile
+   Timing and overrun (xrun) counts for the audio interrupt.
+
+   The interrupt records how long each block took, in cycles of the
+   timer from dsp_cycles(), against the block period: min, max and
+   average, and a histogram in tenths of the block period with a last
+   bin for blocks that ran over.
+
+   It also records where the DMA ring was when it started and finished:
+
+     input xrun   the interrupt started more than one block after the
+                  last one, so a block of input was never processed
+                  (and its output slot went out stale)
+     output xrun  by the time the block was finished the input had
+                  completed ring_blocks - 1 more blocks, so the output
+                  DMA had already started sending it
+
+   Only the interrupt writes the counters.  The control side asks for
+   a reset, which the interrupt carries out on its next block.
+*/
+
+#ifndef __IRQ_PROFILE__
+#define __IRQ_PROFILE__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define IRQ_PROFILE_BINS 11   // 0-10% ... 90-100%, over 100%
+
+typedef struct irq_profile {
+    uint32_t period;             // block period in timer cycles
+    uint32_t cycles_hz;          // timer rate
+    volatile bool reset;         // requested by the control side
+    volatile uint32_t count;     // blocks recorded since the reset
+    volatile uint32_t min;
+    volatile uint32_t max;
+    volatile uint64_t total;
+    volatile uint32_t hist[IRQ_PROFILE_BINS];
+    volatile uint32_t in_xruns;
+    volatile uint32_t out_xruns;
+    uint8_t last_block;          // ring block of the last interrupt
+} irq_profile;
+
+void irq_profile_init(irq_profile *p, uint32_t cycles_hz, uint32_t block_frames, uint32_t sample_rate);
+
+// control side: a new block size, which also starts over
+void irq_profile_set_period(irq_profile *p, uint32_t block_frames, uint32_t sample_rate);
+
+// control side: start over, e.g. after a settings change
+void irq_profile_reset(irq_profile *p);
+
+// interrupt side: block was the ring block processed, done_block the
+// last completed block once it was finished, busy the cycles it took
+void irq_profile_record(irq_profile *p, uint8_t block, uint8_t done_block, uint8_t ring_blocks, uint32_t busy);
+
+void irq_profile_print(irq_profile *p);
+
+#endif
@@ -0,0 +1,145 @@
+/* Limiter
+   Lookahead brickwall limiter with a sliding window peak detector.
+*/
+
+#include <math.h>
+#include "limiter.h"
+#include "meter.h"
+#include "fixed_point.h"
+#include "sram_banks.h"
+
+#define LIMITER_RELEASE_MS 50.0
+
+#define min(X, Y) ((X) < (Y) ? (X) : (Y))
+#define max(X, Y) ((X) > (Y) ? (X) : (Y))
+#define clamp(V, X, Y) min(Y,max(X,V))
+
+// start over with a new lookahead: empty delay line, unity gain
+
+static void limiter_reset(limiter *lim, uint16_t frames) {
+    lim->frames = frames;
+    lim->pos = 0;
+    lim->clock = 0;
+    lim->dq_head = 0;
+    lim->dq_count = 0;
+    lim->peak = 0;
+    lim->peak_ceiling = lim->ceiling;
+    lim->peak_gain = Q30_ONE;
+    lim->release_gain = Q30_ONE;
+    lim->limiting = false;
+    for (uint16_t i = 0; i < frames; i++) {
+	lim->avg[i] = Q30_ONE >> 8;
+	lim->delay[i*2] = 0;
+	lim->delay[i*2+1] = 0;
+    }
+    lim->avg_sum = frames * (Q30_ONE >> 8);
+    lim->avg_recip = (uint32_t) ((1ULL << 32) / frames);
+}
+
+void limiter_init(limiter *lim, uint32_t sample_rate) {
+    lim->sample_rate = sample_rate;
+    lim->clip_events = 0;
+    lim->ceiling = INT32_MAX;
+    lim->release_coef = float_to_q30(1.0 - expf(-1000.0 / (LIMITER_RELEASE_MS * sample_rate)));
+    limiter_set_lookahead(lim, 1.0);
+    limiter_reset(lim, lim->request_frames);
+}
+
+void limiter_set_lookahead(limiter *lim, float ms) {
+    ms = clamp(ms, LIMITER_MIN_MS, LIMITER_MAX_MS);
+    uint32_t frames = (uint32_t) roundf(ms * lim->sample_rate / 1000.0);
+    lim->request_frames = clamp(frames, 2, LIMITER_MAX_FRAMES);
+}
+
+void limiter_set_ceiling(limiter *lim, int32_t ceiling) {
+    lim->ceiling = max(1, ceiling);
+}
+
+float limiter_lookahead_ms(limiter *lim) {
+    return (lim->request_frames * 1000.0) / lim->sample_rate;
+}
+
+void SRAM_ISR_FUNC(limiter_process)(limiter *lim, int32_t *buffer, size_t num_frames) {
+    // lookahead changes are picked up here, between blocks
+    if (lim->request_frames != lim->frames) {
+	limiter_reset(lim, lim->request_frames);
+    }
+    int32_t ceiling = lim->ceiling;
+    // a new ceiling applies from here, so the gain for the window peak
+    // is worked out afresh against it
+    if (ceiling != lim->peak_ceiling) {
+	lim->peak_ceiling = ceiling;
+	lim->peak = 0;
+    }
+    uint16_t frames = lim->frames;
+    uint16_t pos = lim->pos;
+    uint32_t clock = lim->clock;
+    uint16_t head = lim->dq_head;
+    uint16_t count = lim->dq_count;
+    int32_t release_gain = lim->release_gain;
+    uint32_t avg_sum = lim->avg_sum;
+
+    for (size_t i = 0; i < num_frames * 2; i += 2) {
+	int32_t in_l = buffer[i];
+	int32_t in_r = buffer[i+1];
+	int32_t level = meter_max(meter_abs(in_l), meter_abs(in_r));
+
+	// push onto the back of the deque, dropping smaller peaks that
+	// can no longer be the window maximum, then retire the front
+	// once it has left the delay line
+	clock++;
+	while (count > 0 && lim->dq_peak[(head + count - 1) & (LIMITER_DEQUE_SIZE - 1)] <= level) {
+	    count--;
+	}
+	uint16_t back = (head + count) & (LIMITER_DEQUE_SIZE - 1);
+	lim->dq_peak[back] = level;
+	lim->dq_clock[back] = clock;
+	count++;
+	if (clock - lim->dq_clock[head] > frames) {
+	    head = (head + 1) & (LIMITER_DEQUE_SIZE - 1);
+	    count--;
+	}
+	int32_t peak = lim->dq_peak[head];
+
+	// gain to hold the window peak at the ceiling, only divided out
+	// when the peak (or the ceiling) changes
+	if (peak <= ceiling) {
+	    lim->peak_gain = Q30_ONE;
+	    lim->limiting = false;
+	} else if (peak != lim->peak) {
+	    lim->peak_gain = q30_ratio(ceiling, peak);
+	    if (!lim->limiting) {
+		lim->clip_events++;
+		lim->limiting = true;
+	    }
+	}
+	lim->peak = peak;
+
+	// instant attack, slow release, then average over the lookahead
+	if (lim->peak_gain < release_gain) {
+	    release_gain = lim->peak_gain;
+	} else {
+	    release_gain += (int32_t) (((int64_t) lim->release_coef * (lim->peak_gain - release_gain)) >> Q30_SHIFT);
+	}
+	uint32_t g = (uint32_t) release_gain >> 8;
+	avg_sum += g - lim->avg[pos];
+	lim->avg[pos] = g;
+	int32_t gain = (int32_t) (((uint64_t) avg_sum * lim->avg_recip) >> 24);
+
+	// out of the delay line with the gain applied
+	int32_t out_l = lim->delay[pos*2];
+	int32_t out_r = lim->delay[pos*2+1];
+	lim->delay[pos*2] = in_l;
+	lim->delay[pos*2+1] = in_r;
+	buffer[i] = (int32_t) (((int64_t) out_l * gain) >> Q30_SHIFT);
+	buffer[i+1] = (int32_t) (((int64_t) out_r * gain) >> Q30_SHIFT);
+
+	if (++pos == frames) pos = 0;
+    }
+    lim->pos = pos;
+    lim->clock = clock;
+    lim->dq_head = head;
+    lim->dq_count = count;
+    lim->release_gain = release_gain;
+    lim->avg_sum = avg_sum;
+}
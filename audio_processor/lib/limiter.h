@@ -0,0 +1,71 @@
+/* Limiter
+   Lookahead brickwall limiter for the channel output, run from the
+   audio interrupt on the integer codec words (both kernel variants).
+
+   The output is delayed by the lookahead (0.5 - 2ms).  The peak of
+   the samples in the delay line is tracked with a monotonic deque, so
+   detection is O(1) per frame whatever the lookahead.  The gain needed
+   to hold that peak at the ceiling is released slowly, then averaged
+   over the lookahead, which ramps the reduction in linearly while the
+   peak travels down the delay line and reaches the full reduction as
+   the peak leaves it.
+
+   Each time the peak goes over the ceiling a clip event is counted;
+   the control side reads clip_events for reporting.
+*/
+
+#ifndef __LIMITER__
+#define __LIMITER__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define LIMITER_MAX_FRAMES 192    // 2ms at 96kHz
+#define LIMITER_DEQUE_SIZE 256    // power of 2 above LIMITER_MAX_FRAMES
+#define LIMITER_MIN_MS 0.5
+#define LIMITER_MAX_MS 2.0
+
+typedef struct limiter {
+    uint32_t sample_rate;
+    volatile uint16_t request_frames;  // lookahead set by the control side
+    volatile int32_t ceiling;          // absolute sample value not to exceed
+    volatile uint32_t clip_events;     // times the peak has gone over the ceiling
+    int32_t release_coef;              // Q1.30 one pole release coefficient
+
+    uint16_t frames;                   // lookahead in use
+    uint16_t pos;                      // delay line and average position
+    uint32_t clock;                    // frame counter for the deque
+
+    // monotonic deque: decreasing peaks and the frame they entered on
+    int32_t dq_peak[LIMITER_DEQUE_SIZE];
+    uint32_t dq_clock[LIMITER_DEQUE_SIZE];
+    uint16_t dq_head;
+    uint16_t dq_count;
+
+    int32_t peak;                      // window peak the peak_gain was computed for
+    int32_t peak_ceiling;              // and the ceiling
+    int32_t peak_gain;                 // Q1.30
+    int32_t release_gain;              // Q1.30
+    bool limiting;
+
+    uint32_t avg[LIMITER_MAX_FRAMES];  // Q1.22 release gains over the lookahead
+    uint32_t avg_sum;
+    uint32_t avg_recip;                // 2^32 / frames
+
+    int32_t delay[LIMITER_MAX_FRAMES * 2];
+} limiter;
+
+void limiter_init(limiter *lim, uint32_t sample_rate);
+
+// control side settings
+
+void limiter_set_lookahead(limiter *lim, float ms);
+void limiter_set_ceiling(limiter *lim, int32_t ceiling);
+float limiter_lookahead_ms(limiter *lim);
+
+// interrupt side: limit num_frames interleaved stereo frames in place
+
+void limiter_process(limiter *lim, int32_t *buffer, size_t num_frames);
+
+#endif
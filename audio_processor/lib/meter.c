@@ -0,0 +1,110 @@
+/* Block Meter
+   Sequence counter publication of per-block peaks.
+*/
+
+#include "meter.h"
+#include "dsp_platform.h"
+#include "sram_banks.h"
+
+void meter_init(block_meter *m) {
+    m->seq = 0;
+    m->taken = 0;
+    m->blocks = 0;
+    m->in_l = 0;
+    m->in_r = 0;
+    m->out_l = 0;
+    m->out_r = 0;
+    m->block_in = 0;
+}
+
+void SRAM_ISR_FUNC(meter_publish)(block_meter *m, int32_t in_l, int32_t in_r, int32_t out_l, int32_t out_r) {
+    uint32_t seq = m->seq;
+    bool consumed = (m->taken == seq);
+
+    m->seq = seq + 1;
+    dsp_barrier();
+    if (consumed) {
+	m->in_l = in_l;
+	m->in_r = in_r;
+	m->out_l = out_l;
+	m->out_r = out_r;
+    } else {
+	m->in_l = meter_max(m->in_l, in_l);
+	m->in_r = meter_max(m->in_r, in_r);
+	m->out_l = meter_max(m->out_l, out_l);
+	m->out_r = meter_max(m->out_r, out_r);
+    }
+    m->block_in = meter_max(in_l, in_r);
+    m->blocks++;
+    dsp_barrier();
+    m->seq = seq + 2;
+}
+
+bool meter_read(block_meter *m, meter_snapshot *snap) {
+    uint32_t seq;
+    do {
+	seq = m->seq;
+	if (seq & 1) continue;  // publication in progress
+	dsp_barrier();
+	snap->blocks = m->blocks;
+	snap->in_l = m->in_l;
+	snap->in_r = m->in_r;
+	snap->out_l = m->out_l;
+	snap->out_r = m->out_r;
+	dsp_barrier();
+    } while ((seq & 1) || (m->seq != seq));
+
+    snap->seq = seq;
+    if (m->taken == seq) return false;
+    m->taken = seq;
+    return true;
+}
+
+static void report_clear(meter_report *r) {
+    r->in_l = 0;
+    r->in_r = 0;
+    r->out_l = 0;
+    r->out_r = 0;
+    r->gain = 1;
+}
+
+void meter_stream_init(meter_stream *s, uint32_t period_us) {
+    s->head = 0;
+    s->tail = 0;
+    s->skipped = 0;
+    s->acc_us = 0;
+    s->period_us = period_us;
+    report_clear(&s->acc);
+}
+
+void meter_stream_add(meter_stream *s, const meter_snapshot *snap, float gain, uint32_t us) {
+    s->acc.in_l = meter_max(s->acc.in_l, snap->in_l);
+    s->acc.in_r = meter_max(s->acc.in_r, snap->in_r);
+    s->acc.out_l = meter_max(s->acc.out_l, snap->out_l);
+    s->acc.out_r = meter_max(s->acc.out_r, snap->out_r);
+    if (gain < s->acc.gain) s->acc.gain = gain;
+    s->acc_us += us;
+    if (s->acc_us < s->period_us) return;
+
+    // a read covering more than a period (the loop was held up) still
+    // makes one report
+    s->acc_us = (s->acc_us < 2 * s->period_us) ? s->acc_us - s->period_us : 0;
+    s->ring[s->head & (METER_STREAM_SIZE - 1)] = s->acc;
+    dsp_barrier();
+    s->head++;
+    report_clear(&s->acc);
+}
+
+bool meter_stream_take(meter_stream *s, meter_report *r) {
+    uint32_t head = s->head;
+    if (head - s->tail > METER_STREAM_SIZE - 2) {
+	// the oldest are about to be written over
+	s->skipped += head - s->tail - METER_STREAM_SIZE / 2;
+	s->tail = head - METER_STREAM_SIZE / 2;
+    }
+    if (head == s->tail) return false;
+    dsp_barrier();
+    *r = s->ring[s->tail & (METER_STREAM_SIZE - 1)];
+    s->tail++;
+    return true;
+}
@@ -0,0 +1,104 @@
+/* Block Meter
+   Peak amplitudes measured by the audio interrupt, published once per
+   DMA block and consumed by the control loop.
+
+   The interrupt is the only writer of the peaks and the sequence
+   counter (odd while a publication is in progress).  The reader copies
+   the peaks and retries if the sequence moved underneath it, then
+   acknowledges the sequence it consumed.  Until a publication has been
+   acknowledged the interrupt keeps folding new block peaks into it
+   with max(), so a peak is never overwritten before it is seen.
+
+   Meter stream: the control loop folds what it reads into reports of
+   a fixed period (5ms for the controller's meters), each the peaks
+   since the report before, and queues them in a ring for the sending
+   core.  The control loop is the only writer of the ring and head, the
+   sender the only reader of them, and a report is written before head
+   moves past it.  A sender that falls nearly a ring behind skips to
+   the newest half, counting what it skipped.
+*/
+
+#ifndef __METER__
+#define __METER__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct block_meter {
+    volatile uint32_t seq;      // publication sequence, odd while being written
+    volatile uint32_t taken;    // last sequence consumed by the reader
+    volatile uint32_t blocks;   // total blocks published
+    volatile int32_t in_l;      // peak absolute input amplitude (pre-trim)
+    volatile int32_t in_r;
+    volatile int32_t out_l;     // peak absolute output amplitude
+    volatile int32_t out_r;
+    volatile int32_t block_in;  // louder input peak of the last block alone
+} block_meter;
+
+typedef struct meter_snapshot {
+    uint32_t seq;
+    uint32_t blocks;
+    int32_t in_l;
+    int32_t in_r;
+    int32_t out_l;
+    int32_t out_r;
+} meter_snapshot;
+
+// branchless helpers for the per-sample peak scan
+
+// ones' complement absolute value, never overflows (|x| - 1 for x < 0,
+// which is below the resolution of a 24-bit word)
+static inline int32_t meter_abs(int32_t x) {
+    return x ^ (x >> 31);
+}
+
+// max of two non-negative values
+static inline int32_t meter_max(int32_t a, int32_t b) {
+    int32_t d = a - b;
+    return b + (d & ~(d >> 31));
+}
+
+#define METER_STREAM_SIZE 32      // reports queued, a power of 2
+
+typedef struct meter_report {
+    int32_t in_l;               // peak absolute input amplitude over the report
+    int32_t in_r;
+    int32_t out_l;              // and output
+    int32_t out_r;
+    float gain;                 // least compressor gain over the report
+} meter_report;
+
+typedef struct meter_stream {
+    meter_report ring[METER_STREAM_SIZE];
+    volatile uint32_t head;     // reports queued
+    uint32_t tail;              // reports taken
+    uint32_t skipped;           // reports the sender was too far behind for
+    meter_report acc;           // the report being gathered
+    uint32_t acc_us;            // the time it covers so far
+    uint32_t period_us;
+} meter_stream;
+
+void meter_init(block_meter *m);
+
+// interrupt side: publish the peaks of the block just processed
+void meter_publish(block_meter *m, int32_t in_l, int32_t in_r, int32_t out_l, int32_t out_r);
+
+// control side: take the peaks since the last read.  Returns false if
+// nothing has been published since then.
+bool meter_read(block_meter *m, meter_snapshot *snap);
+
+void meter_stream_init(meter_stream *s, uint32_t period_us);
+
+// control side: fold in a read covering us microseconds and the
+// compressor gain, queueing a report each time the period is covered
+void meter_stream_add(meter_stream *s, const meter_snapshot *snap, float gain, uint32_t us);
+
+// sender side: reports queued and not yet taken
+static inline uint32_t meter_stream_waiting(meter_stream *s) {
+    return s->head - s->tail;
+}
+
+// sender side: take the oldest report, false if there's none
+bool meter_stream_take(meter_stream *s, meter_report *r);
+
+#endif
@@ -0,0 +1,172 @@
+/* Proto
+   COBS framing and the CRC-16 for the binary DSP/controller protocol.
+*/
+
+#include <string.h>
+#include <math.h>
+#include "proto.h"
+
+static const uint8_t payload_sizes[PROTO_TYPES] = {
+    0,
+    sizeof(proto_meter),
+    sizeof(proto_param),
+    sizeof(proto_sync),
+    sizeof(proto_diagnostics),
+    sizeof(proto_ack),
+    sizeof(proto_set),
+    0                         // a sync request has no payload
+};
+
+// CRC-16/CCITT-FALSE, a nibble at a time from a 16 entry table
+
+static const uint16_t crc_nibble[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+    0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef
+};
+
+uint16_t proto_crc16(const uint8_t *data, size_t len) {
+    uint16_t crc = 0xffff;
+    for (size_t i = 0; i < len; i++) {
+	crc = (crc << 4) ^ crc_nibble[(crc >> 12) ^ (data[i] >> 4)];
+	crc = (crc << 4) ^ crc_nibble[(crc >> 12) ^ (data[i] & 0x0f)];
+    }
+    return crc;
+}
+
+size_t proto_payload_size(uint8_t type) {
+    return (type < PROTO_TYPES) ? payload_sizes[type] : 0;
+}
+
+static bool known_type(uint8_t type) {
+    return (type > 0) && (type < PROTO_TYPES);
+}
+
+size_t proto_encode(uint8_t type, const void *payload, uint8_t *frame) {
+    uint8_t message[PROTO_MAX_MESSAGE];
+    size_t len;
+
+    if (!known_type(type)) return 0;
+    len = payload_sizes[type];
+    message[0] = type;
+    if (len > 0) memcpy(&message[1], payload, len);
+    len++;
+    uint16_t crc = proto_crc16(message, len);
+    message[len++] = crc & 0xff;
+    message[len++] = crc >> 8;
+
+    // COBS: each zero becomes the distance to the next, the first
+    // distance going ahead of the data
+
+    size_t code_at = 0;
+    size_t out = 1;
+    uint8_t code = 1;
+    for (size_t i = 0; i < len; i++) {
+	if (message[i] != 0) {
+	    frame[out++] = message[i];
+	    code++;
+	}
+	if (message[i] == 0 || code == 0xff) {
+	    frame[code_at] = code;
+	    code = 1;
+	    code_at = out++;
+	}
+    }
+    frame[code_at] = code;
+    frame[out++] = 0;
+    return out;
+}
+
+// meter codes, PROTO_METER_STEP_DB apart
+
+static uint8_t steps_code(float steps) {
+    if (!(steps > 0.5f)) return 0;  // also NaN
+    if (steps > 254.5f) return 255;
+    return (uint8_t) lroundf(steps);
+}
+
+uint8_t proto_level_code(float ratio) {
+    if (!(ratio > 0)) return 0;
+    return steps_code(255 + 20 * log10f(ratio) / PROTO_METER_STEP_DB);
+}
+
+float proto_level_ratio(uint8_t code) {
+    if (code == 0) return 0;
+    return powf(10, (code - 255) * PROTO_METER_STEP_DB / 20);
+}
+
+uint8_t proto_reduction_code(float gain) {
+    if (gain >= 1) return 0;
+    if (!(gain > 0)) return 255;
+    return steps_code(-20 * log10f(gain) / PROTO_METER_STEP_DB);
+}
+
+float proto_reduction_gain(uint8_t code) {
+    return powf(10, -code * PROTO_METER_STEP_DB / 20);
+}
+
+void proto_rx_init(proto_rx *rx) {
+    memset(rx, 0, sizeof(proto_rx));
+}
+
+// decode the COBS frame in rx->buf into rx->msg
+
+static bool decode_frame(proto_rx *rx) {
+    uint8_t message[PROTO_MAX_MESSAGE];
+    size_t len = 0;
+    size_t i = 0;
+
+    while (i < rx->len) {
+	uint8_t code = rx->buf[i++];
+	if (code == 0 || i + code - 1 > rx->len) return false;
+	for (uint8_t j = 1; j < code; j++) {
+	    if (len >= PROTO_MAX_MESSAGE) return false;
+	    message[len++] = rx->buf[i++];
+	}
+	if (code < 0xff && i < rx->len) {
+	    if (len >= PROTO_MAX_MESSAGE) return false;
+	    message[len++] = 0;
+	}
+    }
+
+    if (len < 3 || !known_type(message[0])) return false;
+    if (len != payload_sizes[message[0]] + 3) return false;
+    uint16_t crc = message[len-2] | (message[len-1] << 8);
+    if (proto_crc16(message, len - 2) != crc) return false;
+
+    rx->msg.type = message[0];
+    memcpy(rx->msg.u.bytes, &message[1], len - 3);
+    return true;
+}
+
+bool proto_rx_byte(proto_rx *rx, uint8_t byte) {
+    bool good = false;
+
+    if (byte != 0) {
+	if (rx->len < PROTO_MAX_FRAME) {
+	    rx->buf[rx->len++] = byte;
+	} else {
+	    rx->overflow = true;
+	}
+	return false;
+    }
+
+    if (rx->len > 0 || rx->overflow) {    // empty frames are idle fill
+	good = !rx->overflow && decode_frame(rx);
+	if (good) {
+	    rx->frames++;
+	} else {
+	    rx->errors++;
+	}
+    }
+    rx->len = 0;
+    rx->overflow = false;
+    return good;
+}
+
+void proto_rx_idle(proto_rx *rx) {
+    if (rx->len > 0 || rx->overflow) {
+	rx->errors++;
+    }
+    rx->len = 0;
+    rx->overflow = false;
+}
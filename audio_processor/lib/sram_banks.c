@@ -0,0 +1,92 @@
+/* SRAM Banks
+   Clearing the bank regions at boot, and the bus load for measuring
+   contention.
+*/
+
+#include <string.h>
+#include "sram_banks.h"
+#include "dsp_platform.h"
+
+#define LOAD_WORDS 1024   // 4k read per pass, the size of a scratch bank
+
+static const char *load_names[SRAM_LOADS] = {
+    "none",
+    "main RAM",
+    "scratch X",
+    "scratch Y",
+    "bank 0",
+    "bank 1",
+    "bank 2",
+    "bank 3"
+};
+
+const char *sram_load_name(int load) {
+    return (load >= 0 && load < SRAM_LOADS) ? load_names[load] : "?";
+}
+
+#ifdef DSP_HOST
+
+void sram_banks_clear(void) {
+}
+
+// nothing shares a bus with the audio on the host
+void sram_bus_load(int load, uint32_t ms) {
+}
+
+#else
+
+#include "hardware/regs/addressmap.h"
+#include "pico/time.h"
+
+extern char __sram_bank0_start__[], __sram_bank0_end__[];
+extern char __sram_bank1_start__[], __sram_bank1_end__[];
+extern char __sram_bank2_start__[], __sram_bank2_end__[];
+extern char __sram_bank3_start__[], __sram_bank3_end__[];
+
+// striped over all four banks, like anything else in main RAM
+static uint32_t main_load[LOAD_WORDS];
+static volatile uint32_t load_sink;
+
+void sram_banks_clear(void) {
+    memset(__sram_bank0_start__, 0, __sram_bank0_end__ - __sram_bank0_start__);
+    memset(__sram_bank1_start__, 0, __sram_bank1_end__ - __sram_bank1_start__);
+    memset(__sram_bank2_start__, 0, __sram_bank2_end__ - __sram_bank2_start__);
+    memset(__sram_bank3_start__, 0, __sram_bank3_end__ - __sram_bank3_start__);
+}
+
+static const volatile uint32_t *load_base(int load) {
+    switch (load) {
+    case SRAM_LOAD_MAIN:      return main_load;
+    case SRAM_LOAD_SCRATCH_X: return (const volatile uint32_t *) SRAM4_BASE;
+    case SRAM_LOAD_SCRATCH_Y: return (const volatile uint32_t *) SRAM5_BASE;
+    case SRAM_LOAD_BANK0:     return (const volatile uint32_t *) (SRAM0_BASE + SRAM_BANK_OFFSET);
+    case SRAM_LOAD_BANK1:     return (const volatile uint32_t *) (SRAM1_BASE + SRAM_BANK_OFFSET);
+    case SRAM_LOAD_BANK2:     return (const volatile uint32_t *) (SRAM2_BASE + SRAM_BANK_OFFSET);
+    case SRAM_LOAD_BANK3:     return (const volatile uint32_t *) (SRAM3_BASE + SRAM_BANK_OFFSET);
+    }
+    return 0;
+}
+
+/* Reads only, so any region is safe to load, the stacks and the
+ * interrupt's own state included.  A pass takes some tens of
+ * microseconds.
+ */
+
+void sram_bus_load(int load, uint32_t ms) {
+    const volatile uint32_t *p = load_base(load);
+    uint64_t until = dsp_time_ns() + (uint64_t) ms * 1000000;
+    uint32_t sum = 0;
+
+    if (!p) {
+	sleep_ms(ms);
+	return;
+    }
+    while (dsp_time_ns() < until) {
+	for (int i = 0; i < LOAD_WORDS; i++) {
+	    sum += p[i];
+	}
+    }
+    load_sink = sum;
+}
+
+#endif
@@ -0,0 +1,75 @@
+/* SRAM Banks
+   Placement of the audio path in the RP2040's SRAM banks, so that the
+   audio interrupt on core 0 and the DMA don't wait on core 1 (or on
+   each other) for the bus.
+
+   Main RAM is four 64k banks striped word by word, so everything in
+   it is spread over all four, and core 1 running the console and the
+   controller link out of main RAM can stall the interrupt on any
+   access.  memmap_audio.ld
+   keeps main RAM to the low 48k of each bank (still striped, 192k)
+   and gives the top 16k of each bank to the audio path, through the
+   bank's unstriped alias:
+
+     bank 0     input ring        DMA writes, the interrupt reads
+     bank 1     output ring       the interrupt writes, DMA reads
+     bank 2     send ring         the interrupt writes, DMA reads
+     bank 3     kernel state      the interrupt, and its profile
+     scratch X  interrupt code    core 0 fetches
+     scratch Y  core 0 stack
+     main RAM   everything else, including the core 1 stack
+
+   The library helpers the interrupt calls (soft float, 64 bit
+   multiply) stay in main RAM.
+
+   SRAM_BANK(n) places a variable in bank n and SRAM_ISR_FUNC(f) a
+   function in scratch X; each function gets a section of its own so
+   unused ones are still dropped at link time.  The banks are NOLOAD,
+   since the bootrom only loads a RAM binary into the striped range,
+   so sram_banks_clear() zeroes them at boot before anything in them
+   is used.  On the host the macros are empty and the banks are plain
+   memory.
+
+   sram_bus_load() measures what the placement buys: it reads one of
+   the regions in a tight loop from the calling core for a while, so
+   the audio interrupt's profile (irq_profile.h) shows the cost of
+   sharing that region with the other core.
+*/
+
+#ifndef __SRAM_BANKS__
+#define __SRAM_BANKS__
+
+#include <stdint.h>
+
+#ifdef DSP_HOST
+#define SRAM_BANK(n)
+#define SRAM_ISR_FUNC(f) f
+#else
+#include "pico.h"
+#define SRAM_BANK(n) __attribute__((section(".sram_bank" #n)))
+#define SRAM_ISR_FUNC(f) __scratch_x(#f) f
+#endif
+
+#define SRAM_BANK_OFFSET 0xc000   // the top 16k of each bank, see memmap_audio.ld
+
+// regions sram_bus_load() can read
+enum {
+    SRAM_LOAD_NONE,        // the core sleeps, for the baseline
+    SRAM_LOAD_MAIN,
+    SRAM_LOAD_SCRATCH_X,
+    SRAM_LOAD_SCRATCH_Y,
+    SRAM_LOAD_BANK0,
+    SRAM_LOAD_BANK1,
+    SRAM_LOAD_BANK2,
+    SRAM_LOAD_BANK3,
+    SRAM_LOADS
+};
+
+void sram_banks_clear(void);
+
+const char *sram_load_name(int load);
+
+// read the region for ms milliseconds
+void sram_bus_load(int load, uint32_t ms);
+
+#endif
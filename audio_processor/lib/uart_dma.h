@@ -0,0 +1,94 @@
+/* UART DMA
+   A uart transport with both directions run by DMA, for the link
+   between the DSP and the controller.  The same files are built on
+   both boards.
+
+   Receive: a DMA channel paced by the uart's RX DREQ moves every byte
+   from the data register into a ring, with the write address wrapping
+   on the ring's size, so no byte waits on the CPU and nothing is read
+   a byte at a time from the uart.  The channel's transfer count says
+   how many bytes have arrived since it started; the reader keeps its
+   own count, and the difference is what's waiting.  If the reader
+   falls more than a ring behind, the oldest bytes have been written
+   over: they are skipped and counted in rx_lost.  At 1Mbaud the ring
+   holds 10ms of back to back bytes.
+
+   The line is idle once no byte has arrived for UART_DMA_IDLE_US.  As
+   the DMA empties the FIFO as it fills, the uart's own receive timeout
+   never fires; the idle time is taken from the byte count instead, at
+   each uart_dma_poll().  A frame is always sent in one piece, so a
+   frame left half received over an idle line has lost its end.
+
+   Transmit: uart_dma_send() copies a frame into a ring, or refuses it
+   whole (counted in tx_dropped) if it doesn't fit; it never waits on
+   the uart.  uart_dma_poll() starts a DMA transfer of everything
+   queued whenever the channel is free, so transfers end on frame
+   boundaries.
+
+   Nothing here runs from an interrupt: both directions are serviced
+   by calling uart_dma_poll() from the main loop.
+*/
+
+#ifndef __UART_DMA__
+#define __UART_DMA__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "hardware/uart.h"
+
+#define UART_DMA_RX_BITS 10               // 1024 byte receive ring
+#define UART_DMA_TX_BITS 9                // 512 byte transmit ring
+#define UART_DMA_RX_SIZE (1 << UART_DMA_RX_BITS)
+#define UART_DMA_TX_SIZE (1 << UART_DMA_TX_BITS)
+#define UART_DMA_IDLE_US 1000
+
+typedef struct uart_dma {
+    // the rings are aligned to their size for the DMA's address wrap
+    uint8_t rx_ring[UART_DMA_RX_SIZE] __attribute__((aligned(UART_DMA_RX_SIZE)));
+    uint8_t tx_ring[UART_DMA_TX_SIZE] __attribute__((aligned(UART_DMA_TX_SIZE)));
+    uart_inst_t *uart;
+    uint baud;                  // the rate attained
+    int rx_chan;
+    int tx_chan;
+
+    uint32_t rx_base;           // bytes received before the channel's last start
+    uint32_t rx_read;           // bytes taken by the reader
+    uint32_t rx_seen;           // bytes received at the last poll
+    uint64_t rx_last_us;        // when the count last moved
+    bool idle;
+
+    uint32_t tx_head;           // bytes queued
+    uint32_t tx_tail;           // bytes handed to the DMA
+    uint32_t tx_sending;        // bytes in the transfer under way
+
+    uint32_t rx_bytes;          // counters, for the console
+    uint32_t rx_lost;
+    uint32_t tx_bytes;
+    uint32_t tx_dropped;
+} uart_dma;
+
+// set up the uart at baud and claim two DMA channels.  The pins are
+// the caller's (gpio_set_function).
+void uart_dma_init(uart_dma *t, uart_inst_t *uart, uint baud);
+
+// start queued transmits, note the receive count for the idle check
+void uart_dma_poll(uart_dma *t);
+
+// queue a frame, false if there's no room for all of it
+bool uart_dma_send(uart_dma *t, const uint8_t *data, size_t len);
+
+// bytes uart_dma_send() has room for
+static inline size_t uart_dma_tx_free(uart_dma *t) {
+    return UART_DMA_TX_SIZE - (t->tx_head - t->tx_tail);
+}
+
+// the next received byte, -1 if there's none
+int uart_dma_getc(uart_dma *t);
+
+// true while no byte has arrived for UART_DMA_IDLE_US (as of the last poll)
+static inline bool uart_dma_idle(uart_dma *t) {
+    return t->idle;
+}
+
+#endif
@@ -36,6 +36,9 @@
 #include "pico/stdlib.h"
 #include "pico/float.h"
 #include "common.h"
+#include "proto.h"
+#include "uart_dma.h"
+#include "param_queue.h"
 #include "ui.h"
 #include "moving_average.h"
 #include "bits8.h"
@@ -131,9 +134,6 @@ SSD_i2c_display *display;
 
 
 
-// the common denominator used in receiving levels from the dsp
-#define COMMON_RANGE 8192;
-
 // two 32-bit arrays to use as modulators of the LED brightness
 
 // the current level of the leds 
@@ -191,19 +191,16 @@ void check_dsp();
 
 char *cmd_buffer;
 
-// and from the DSP card on uart1.
-char *recv_buffer;
+// the DSP card on uart1, run by DMA (lib/uart_dma.h), and the binary
+// messages from it (lib/proto.h)
+uart_dma dsp_link;
+proto_rx dsp_rx;
 
 // text buffer for display of text
 char *text_buffer = 0;
 
-typedef struct dsp_xmit_queue {
-    char *message;
-    struct dsp_xmit_queue *next;
-    struct dsp_xmit_queue *prior;
-} dsp_xmit_queue;
-
-dsp_xmit_queue *dsp_queue;
+// messages waiting for the DSP (lib/param_queue.h)
+param_queue dsp_queue;
 
 struct machine_state_structure machine_state = { .ready = false,      
 		      .compressor_on = true,
@@ -257,25 +254,36 @@ struct machine_state_structure machine_state = { .ready = false,
 		      .core_1_cycle_time_us = 0,
 		      .channel_name = "Channel",
 		      .channel_number = 0,
-		      .last_external_update_ms = 0,
+		      .external_updates = 0,
 		      .slider_update_ms = 0 };
 
 
 void mark_state_updated() {
-    current_state->last_external_update_ms = to_ms_since_boot(get_absolute_time());
+    current_state->external_updates++;
 }
 
 void mark_slider_state_updated() {
     current_state->slider_update_ms = to_ms_since_boot(get_absolute_time());
 }
 
+// the LEDs lit for a level (a ratio of full scale), METER_FLOOR_DB to
+// full scale over each half of the strip
+
+#define METER_FLOOR_DB -48.0
+
+uint8_t meter_pixels(float level) {
+    if (level <= 0) return 0;
+    float px = map_range(ratio_to_dB(level),METER_FLOOR_DB,0,0,AMPLITUDE_PIXEL_COUNT/2);
+    return (uint8_t) clamp(px,0,AMPLITUDE_PIXEL_COUNT/2);
+}
+
 void process_led_levels() {
 
-    uint8_t total_amp_l = (uint8_t) map_range(current_state->current_input_amp_l,0,1,0,AMPLITUDE_PIXEL_COUNT/2);
-    uint8_t total_amp_r = (uint8_t) map_range(current_state->current_input_amp_r,0,1,0,AMPLITUDE_PIXEL_COUNT/2);
+    uint8_t total_amp_l = meter_pixels(current_state->current_input_amp_l);
+    uint8_t total_amp_r = meter_pixels(current_state->current_input_amp_r);
     
-    uint8_t peak_amp_l = (uint8_t) map_range(current_state->peak_amp_l,0,1,0,AMPLITUDE_PIXEL_COUNT/2);
-    uint8_t peak_amp_r = (uint8_t) map_range(current_state->peak_amp_r,0,1,0,AMPLITUDE_PIXEL_COUNT/2);
+    uint8_t peak_amp_l = meter_pixels(current_state->peak_amp_l);
+    uint8_t peak_amp_r = meter_pixels(current_state->peak_amp_r);
 
     uint8_t no_amplitude_color = 0;  // this is assigned to the blue element of the pixel
 
@@ -446,120 +454,112 @@ void refresh_display() {
     current_state->display_refresh_time_us = time_us_64() - stime;
 }
 
-void send_to_dsp(char *text) {
-
-    if (text==NULL) return; // no empty messages - this would be an error
+// queue a message for the DSP: a PROTO_SET, or a type with no payload
 
-    // if empty queue    
-    if (dsp_queue == NULL) {
-	dsp_queue = (dsp_xmit_queue *) calloc(1,sizeof(dsp_xmit_queue));	
-	dsp_queue->next = 0;
-	dsp_queue->prior = 0;
-    } else {
-	dsp_queue->next = (dsp_xmit_queue *) calloc(1,sizeof(dsp_xmit_queue));
-	dsp_queue->next->prior=dsp_queue;
-	dsp_queue=dsp_queue->next;
-	dsp_queue->next = 0;
-	
+void send_to_dsp(uint8_t type, const void *payload) {
+    if (type == PROTO_SET) {
+	const proto_set *set = (const proto_set *) payload;
+	if (!param_queue_set(&dsp_queue, set->param, set->value)) {
+	    printf("error: dsp queue full, %c dropped\n", set->param);
+	}
+    } else if (proto_payload_size(type) == 0) {
+	param_queue_request(&dsp_queue, type);
     }
-    dsp_queue->message = str_alloc(strlen(text));
-    strcpy(dsp_queue->message,text);
 }
 
+// set one DSP parameter, by its console command letter
+
+void send_param(char param, float value) {
+    proto_set set;
+    set.param = param;
+    set.seq = 0;              // numbered as it's sent
+    set.value = value;
+    send_to_dsp(PROTO_SET, &set);
+}
+
+// the last sequence number sent for each parameter, so that only the
+// ack for the latest setting is applied
+
+uint8_t param_seq[128];
+
+// send what's waiting for the DSP, the urgent settings at once and the
+// rest every 10ms, so that settings made in between coalesce
+
 void send_dsp_queue() {
     static uint64_t last_send = 0;
-    if (dsp_queue == 0) return;  // nothing in the queue, so return
-    
-    if (uart_is_writable(uart1) && to_ms_since_boot(get_absolute_time()) > last_send+10) {
-	uint16_t num_updates = 1;
-	uint16_t update_count = 1;
-	dsp_xmit_queue *sent = NULL;          // for the element we just transferred
-	dsp_xmit_queue *current = dsp_queue;  // grab the list...
-	dsp_queue = NULL;                        // and snip off the old list in current
-	// record when we last sent
-	last_send = to_ms_since_boot(get_absolute_time());
-	while(current->prior != NULL) {
-	    current = current->prior;
-	    num_updates++;
-	}
-	// we have current at the first element queued for transmision..
-	// loop through and send throuth the uart
-	while(current != NULL && update_count <= num_updates) {
-	    current->prior = NULL;
-	    uart_puts(uart1,current->message);
-	    sent = current;
-	    current=current->next;
-	    current->prior = NULL;
-	    free(sent->message);
-	    free(sent);
-	    update_count++;
+    static uint8_t seq = 0;
+    uint8_t frame[PROTO_MAX_FRAME];
+    uint8_t type;
+    proto_set set;
+
+    if (!param_queue_urgent(&dsp_queue) && to_ms_since_boot(get_absolute_time()) <= last_send+10) return;
+    last_send = to_ms_since_boot(get_absolute_time());
+
+    // while a whole frame fits, so nothing taken is dropped
+    while (uart_dma_tx_free(&dsp_link) >= PROTO_MAX_FRAME &&
+	   param_queue_take(&dsp_queue, &type, (char *) &set.param, &set.value)) {
+	if (type == PROTO_SET) {
+	    set.seq = seq++;
+	    param_seq[set.param & 0x7f] = set.seq;
 	}
-	
+	size_t len = proto_encode(type, &set, frame);
+	uart_dma_send(&dsp_link, frame, len);
     }
 }
 
+void print_dsp_queue() {
+    printf("dsp queue:   %lu queued   %lu coalesced   %lu sent   %lu dropped\n",
+	   dsp_queue.queued, dsp_queue.coalesced, dsp_queue.sent, dsp_queue.dropped);
+}
+
 void set_gate_on(float state) {
     if (state != 0) state = 1;
     else state = 0;
     current_state->gate_active = (uint8_t) state;
-    char buf[20];
     printf("%s: %.0f->%d\n",__FUNCTION__, state, current_state->gate_active);
-    sprintf(buf,"G%d\n",current_state->gate_active);
-    send_to_dsp(buf);
+    send_param('G',current_state->gate_active);
 }
 
 void set_gate_threshold(float db) {
     current_state->gate_threshold_dB = clamp(db,-100,0);
-    char buf[20];
     printf("%s: %0.4fn->%0.4f\n",__FUNCTION__, db, current_state->gate_threshold_dB);
-    sprintf(buf,"N%.4f\n",current_state->gate_threshold_dB);
-    send_to_dsp(buf);
+    send_param('N',current_state->gate_threshold_dB);
 }
 
 
 void set_gate_attack(float ms) {
     float attack_rate = ms;
     current_state->gate_attack_ms = clamp(attack_rate,0,3000);
-    char buf[20];
-    sprintf(buf,"A%d\n",(int) current_state->gate_attack_ms);
-    send_to_dsp(buf);
+    send_param('A',current_state->gate_attack_ms);
 }
 
 
 void set_gate_hold(float ms) {
     float hold_rate = ms;
     current_state->gate_hold_ms = clamp(hold_rate,0,3000);
-    char buf[20];
-    sprintf(buf,"H%d\n",(int) current_state->gate_hold_ms);
-    send_to_dsp(buf);
+    send_param('H',current_state->gate_hold_ms);
 }
 
 
 void set_gate_release(float ms) {
     float release_rate = ms;
     current_state->gate_release_ms = clamp(release_rate,0,3000);
-    char buf[20];
-    sprintf(buf,"E%d\n",(int) current_state->gate_release_ms);
-    send_to_dsp(buf);
+    send_param('E',current_state->gate_release_ms);
 }
 
 void set_compressor_on(float state) {
     if (state != 0) state = 1;
     else state = 0;
     current_state->compressor_on = (bool) state;
-    char buf[20];
     printf("%s: %.0f->%d\n",__FUNCTION__, state, current_state->compressor_on);
-    sprintf(buf,"c%d\n",current_state->compressor_on);
-    send_to_dsp(buf);
+    send_param('c',current_state->compressor_on);
 }
 
 
 void set_compressor_threshold(float db) {    
     current_state->threshold_dB = clamp(db,-40,0);
-    char buf[20];
     printf("%s: %0.4fn->%0.4f\n",__FUNCTION__, db, current_state->threshold_dB);
-    sprintf(buf,"t%.4f\n",current_state->threshold_dB);
-    send_to_dsp(buf);
+    send_param('t',current_state->threshold_dB);
 }
 
 
@@ -567,27 +567,21 @@ void set_compressor_makeup(float db) {
 
     current_state->makeup_db = clamp(db,0,18);
     printf("%s: %0.4fdB\n",__FUNCTION__, current_state->makeup_db);
-    char buf[20];
-    sprintf(buf,"m%.4f\n",current_state->makeup_db);
-    send_to_dsp(buf);
+    send_param('m',current_state->makeup_db);
 }
 
 
 void set_compressor_attack(float ms) {
     float attack_rate = ms;
     current_state->attack_rate_ms = clamp(attack_rate,0,250);
-    char buf[20];
-    sprintf(buf,"a%d\n",(int) current_state->attack_rate_ms);
-    send_to_dsp(buf);
+    send_param('a',current_state->attack_rate_ms);
 }
 
 
 void set_compressor_release(float ms) {
     float rate = (uint16_t) ms;
     current_state->release_rate_ms = clamp(rate,0,1000);
-    char buf[20];
-    sprintf(buf,"r%d\n",(int) current_state->release_rate_ms);
-    send_to_dsp(buf);
+    send_param('r',current_state->release_rate_ms);
 }
 
 float slider_velocity = 0;
@@ -603,19 +597,14 @@ void calc_slider_db() {
 
 }
 
+// every movement is queued: the queue keeps only the latest slider
+// value until it goes out, so a sweep doesn't flood the link and the
+// final position is always sent
+
 void on_slider_movement() {
-    char buf[20];
-    static uint64_t last_send = 0;
     calc_slider_db();
-    
-    // throttle so we aren't overwhelming with changes...    
-    if (uart_is_writable(uart1) && to_ms_since_boot(get_absolute_time()) > last_send+20) {	
-	last_send = now_ms();
-	sprintf(buf,"g%.3f\n",current_state->slider_percent);	
-	send_to_dsp(buf);
-	mark_slider_state_updated();
-	//mark_state_updated();
-    }
+    send_param('g',current_state->slider_percent);
+    mark_slider_state_updated();
 }
 
 
@@ -1156,118 +1145,243 @@ void rotary_down() {
     pio_interrupt_clear(re->pio, 1);
 }
 
-int int_arg(char *str) {
-    return atoi(strtok(str, " "));
-}
-
-float float_arg(char *str) {
-    return atof(strtok(str, " "));
-}
-
-
-void update_dsp_settings(char *args) {
-    current_state->compressor_on = int_arg(args);
-    current_state->attack_rate_ms = int_arg(NULL);
-    current_state->release_rate_ms = int_arg(NULL);
-    current_state->threshold_dB = float_arg(NULL);
-    current_state->makeup_db = float_arg(NULL);
-    current_state->ratio = float_arg(NULL);
-    current_state->output_mix = float_arg(NULL);
-
-    current_state->input_trim_gain = float_arg(NULL);
-    current_state->balance = float_arg(NULL);
-    current_state->channel_gain = float_arg(NULL);
-    current_state->send1_gain = float_arg(NULL);
-    current_state->send2_gain = float_arg(NULL);
-    mark_state_updated();
-    //set_ui_needs_update();
-}
-
-void process_activity(char *args) {
-    char *amp_l;
-    char *amp_r;
-    char *output_amp_l;
-    char *output_amp_r;
-    char *peak_l;
-    char *peak_r;
-    char *output_peak_amp_l;
-    char *output_peak_amp_r;
-    char *comp_gain;
-    char *gate_open;
-    char *muted;
-    char *start = args;
-    uint16_t i = 0;
-    for (i = 0; i <= 100;i++) { // only go the first 100, if we pass it, ignore this packet
-	if (args[i]=='A') {
-	    start=args+i;
-	    break;
-	}
+/* Parameter sync (lib/proto.h).  The DSP's changes come one parameter
+ * at a time, each a version on from the last; while they follow on,
+ * they are applied as they come.  A gap, an activity report at another
+ * version or a silent link means something was missed, and a snapshot
+ * is asked for (again every DSP_SYNC_RETRY_MS until one arrives whole).
+ */
+
+#define DSP_LINK_TIMEOUT_MS 250   // no frames for this long: the link is down
+#define DSP_SYNC_RETRY_MS 500
+
+typedef struct dsp_sync_state {
+    bool synced;
+    uint16_t version;           // the DSP version applied, once synced
+    uint8_t snapshot_count;     // snapshot parameters since the request
+    uint64_t last_rx_ms;        // the last frame from the DSP
+    uint64_t requested_ms;      // the last snapshot request
+    uint32_t updates;           // counters, for the console
+    uint32_t snapshots;
+    uint32_t resyncs;
+} dsp_sync_state;
+
+dsp_sync_state dsp_sync;
+
+void dsp_resync() {
+    dsp_sync.synced = false;
+    dsp_sync.snapshot_count = 0;
+    dsp_sync.requested_ms = now_ms();
+    dsp_sync.resyncs++;
+    request_channel_status();
+}
+
+void print_dsp_sync() {
+    printf("dsp sync:    %s at version %u\n", dsp_sync.synced ? "in step" : "resyncing", dsp_sync.version);
+    printf("updates:     %lu   snapshots: %lu   resyncs: %lu\n", dsp_sync.updates, dsp_sync.snapshots, dsp_sync.resyncs);
+}
+
+// one DSP setting into the machine state, true if it changed
+
+#define APPLY(field, v) if (current_state->field != (v)) { current_state->field = (v); changed = true; }
+
+bool apply_param(char param, float value) {
+    bool changed = false;
+    switch (param) {
+    case 'a': APPLY(attack_rate_ms, value); break;
+    case 'r': APPLY(release_rate_ms, value); break;
+    case 't': APPLY(threshold_dB, value); break;
+    case 'c': APPLY(compressor_on, value != 0); break;
+    case 'b': APPLY(balance, value); break;
+    case 'R': APPLY(ratio, value); break;
+    case 'S': APPLY(min_steps, (uint32_t) value); break;
+    case 'm': APPLY(makeup_db, value); break;
+    case 'g': APPLY(channel_gain, value); break;
+    case '1': APPLY(send1_gain, value); break;
+    case '2': APPLY(send2_gain, value); break;
+    case 'G': APPLY(gate_active, (uint8_t) value); break;
+    case 'A': APPLY(gate_attack_ms, value); break;
+    case 'E': APPLY(gate_release_ms, value); break;
+    case 'H': APPLY(gate_hold_ms, value); break;
+    case 'N': APPLY(gate_threshold_dB, value); break;
+    case 'O': APPLY(output_mix, value); break;
+    case 'M': APPLY(muted, value != 0); break;
+    case 'T': APPLY(input_trim_gain, value); break;
     }
-    if (i== 100) {
-	printf("NOPE\n");
+    return changed;
+}
+
+// a change the DSP published at version; false if it doesn't follow on
+
+bool sync_version(uint16_t version) {
+    if (dsp_sync.synced && version != (uint16_t) (dsp_sync.version + 1)) {
+	dsp_resync();
+	return false;
+    }
+    dsp_sync.version = version;
+    return true;
+}
+
+void process_param(const proto_param *p) {
+    if (p->flags & PROTO_SNAPSHOT) {
+	dsp_sync.snapshot_count++;
+    } else {
+	sync_version(p->version);
+	dsp_sync.updates++;
+    }
+    // applied even out of step: it's the newest value there is
+    if (apply_param(p->param, p->value)) {
+	mark_state_updated();
+    }
+}
+
+void process_sync(const proto_sync *y) {
+    if (y->count != dsp_sync.snapshot_count) {
+	dsp_resync();        // some of it was lost
 	return;
     }
-    strncpy(text_buffer,start,ENTRY_SIZE-1);
-    amp_l = strtok(text_buffer, " ");
-    amp_r = strtok(NULL, " ");	    
-    peak_l = strtok(NULL, " ");
-    peak_r = strtok(NULL, " ");
-    output_amp_l = strtok(NULL, " ");
-    output_amp_r = strtok(NULL, " ");
-    output_peak_amp_l = strtok(NULL, " ");
-    output_peak_amp_r = strtok(NULL, " ");
-    comp_gain = strtok(NULL, " ");
-    muted = strtok(NULL, " ");
-    gate_open = strtok(NULL, " ");
-    current_state->current_input_amp_l = (float) atof(amp_l)/COMMON_RANGE;
-    current_state->current_input_amp_r = (float) atof(amp_r)/COMMON_RANGE;
-    current_state->peak_amp_l = (float) atof(peak_l)/COMMON_RANGE;
-    current_state->peak_amp_r = (float) atof(peak_r)/COMMON_RANGE;
-    current_state->output_amp_l = (float) atof(output_amp_l)/COMMON_RANGE;
-    current_state->output_amp_r = (float) atof(output_amp_r)/COMMON_RANGE;
-    current_state->output_peak_amp_l = (float) atof(output_peak_amp_l)/COMMON_RANGE;
-    current_state->output_peak_amp_r = (float) atof(output_peak_amp_r)/COMMON_RANGE;
-    current_state->compression_gain = atof(comp_gain) / 65535.0;
-    current_state->muted = (bool) atoi(muted);
+    dsp_sync.snapshot_count = 0;
+    dsp_sync.version = y->version;
+    dsp_sync.synced = true;
+    dsp_sync.snapshots++;
+}
+
+// the answer to a PROTO_SET: the setting as applied, published like
+// any other change.  The page that set it has drawn it already, so
+// this doesn't ask for a redraw; and an answer to a setting since
+// overtaken is left for the later one.
+
+void process_ack(const proto_ack *k) {
+    if (!k->ok) {
+	printf("error: dsp rejected parameter %c\n",k->param);
+	return;
+    }
+    sync_version(k->version);
+    dsp_sync.updates++;
+    if (param_seq[k->param & 0x7f] == k->seq) {
+	apply_param(k->param, k->value);
+    }
+}
+
+/* Meters.  The DSP sends the peaks of every 5ms as log codes (see
+ * lib/proto.h); the fall back and the peak hold are done here, a
+ * report at a time, in the codes' 0.5dB steps.
+ */
+
+#define METER_FALL_STEPS 1          // fall per report, 100dB/s
+#define METER_HOLD_REPORTS 150      // peak hold, 750ms
+#define METER_PEAK_FALL_REPORTS 5   // reports to a step of peak fall, 20dB/s
+
+typedef struct meter_ballistics {
+    uint8_t level;
+    uint8_t peak;
+    uint16_t held;                  // reports since the peak was set
+} meter_ballistics;
+
+meter_ballistics input_l_meter, input_r_meter, output_l_meter, output_r_meter;
+
+void meter_step(meter_ballistics *b, uint8_t code) {
+    b->level = max(code, (b->level > METER_FALL_STEPS) ? b->level - METER_FALL_STEPS : 0);
+    if (code >= b->peak) {
+	b->peak = code;
+	b->held = 0;
+    } else if (b->held < METER_HOLD_REPORTS) {
+	b->held++;
+    } else if (++b->held >= METER_HOLD_REPORTS + METER_PEAK_FALL_REPORTS) {
+	b->held = METER_HOLD_REPORTS;
+	b->peak--;
+    }
+}
+
+void process_meter(const proto_meter *m) {
+    if (dsp_sync.synced && m->version != dsp_sync.version) {
+	dsp_resync();        // the last change was lost
+    }
+    for (int i = 0; i < PROTO_METER_REPORTS; i++) {
+	meter_step(&input_l_meter, m->input_l[i]);
+	meter_step(&input_r_meter, m->input_r[i]);
+	meter_step(&output_l_meter, m->output_l);  // one output peak for the frame
+	meter_step(&output_r_meter, m->output_r);
+    }
+    current_state->current_input_amp_l = proto_level_ratio(input_l_meter.level);
+    current_state->current_input_amp_r = proto_level_ratio(input_r_meter.level);
+    current_state->peak_amp_l = proto_level_ratio(input_l_meter.peak);
+    current_state->peak_amp_r = proto_level_ratio(input_r_meter.peak);
+    current_state->output_amp_l = proto_level_ratio(output_l_meter.level);
+    current_state->output_amp_r = proto_level_ratio(output_r_meter.level);
+    current_state->output_peak_amp_l = proto_level_ratio(output_l_meter.peak);
+    current_state->output_peak_amp_r = proto_level_ratio(output_r_meter.peak);
+    current_state->compression_gain = proto_reduction_gain(m->reduction);
+    current_state->muted = (m->flags & PROTO_MUTED) != 0;
     if (current_state->muted == true) {
 	gpio_put(LED_GPIO,1);
-	printf("??: %s\n",args);
     } else {
 	gpio_put(LED_GPIO,0);
     }
-    current_state->gate_open = atoi(gate_open);
+    current_state->gate_open = (m->flags & PROTO_GATE_OPEN) != 0;
 }
 
 
+// input diagnostics from the DSP: DC offset in ppm, coverage percent,
+// stuck and drift flags
+
+void process_diagnostics(const proto_diagnostics *d) {
+    bool was_stuck = current_state->input_stuck;
+    bool was_drift = current_state->input_drift;
+
+    current_state->input_dc_ppm = d->dc_ppm;
+    current_state->input_coverage = d->coverage;
+    current_state->input_stuck = (d->flags & PROTO_INPUT_STUCK) != 0;
+    current_state->input_drift = (d->flags & PROTO_INPUT_DRIFT) != 0;
+    if (current_state->input_stuck && !was_stuck) {
+	printf("dsp input data is stuck\n");
+    }
+    if (current_state->input_drift && !was_drift) {
+	printf("dsp input DC offset: %ldppm\n", current_state->input_dc_ppm);
+    }
+}
+
 void check_dsp() {
     // any updates queued?
     send_dsp_queue();
-    static uint8_t idx = 0;
-    char *args = recv_buffer+1;
-    char command;
-    while (uart_is_readable(uart1)) {
-	char c = uart_getc(uart1);
-	if (c=='\n') {
-	    // process received data	    
-	    recv_buffer[idx]=0;	    
-	    idx = 0;
-	    command = recv_buffer[0];
-	    switch (command) {
-	    case 'A':
-		process_activity(args);
-		break;		
-	    case 'E':
-		printf("error: %s\n",args);
-		break;
-	    case 'C':  // channel settings
-		update_dsp_settings(args);
-		break;
-	    }
-	} else {
-	    recv_buffer[idx]=c;
-	    idx=(idx+1)%256;    
+    uart_dma_poll(&dsp_link);
+    if (uart_dma_idle(&dsp_link)) {
+	proto_rx_idle(&dsp_rx);
+    }
+    int b;
+    while ((b = uart_dma_getc(&dsp_link)) >= 0) {
+	if (!proto_rx_byte(&dsp_rx, b)) continue;
+	proto_message *msg = &dsp_rx.msg;
+	dsp_sync.last_rx_ms = now_ms();
+	switch (msg->type) {
+	case PROTO_METER:
+	    process_meter(&msg->u.meter);
+	    break;
+	case PROTO_PARAM:  // a channel setting
+	    process_param(&msg->u.param);
+	    break;
+	case PROTO_SYNC:   // end of a snapshot
+	    process_sync(&msg->u.sync);
+	    break;
+	case PROTO_ACK:
+	    process_ack(&msg->u.ack);
+	    break;
+	case PROTO_DIAGNOSTICS:  // input diagnostics
+	    process_diagnostics(&msg->u.diagnostics);
+	    break;
 	}
     }
+
+    // a silent link may have lost anything, or the DSP restarted
+    uint64_t now = now_ms();
+    bool link_up = dsp_sync.last_rx_ms != 0 && (now - dsp_sync.last_rx_ms) < DSP_LINK_TIMEOUT_MS;
+    if (dsp_sync.synced && !link_up) {
+	dsp_sync.synced = false;
+	dsp_sync.snapshot_count = 0;
+    }
+    if (!dsp_sync.synced && link_up && (now - dsp_sync.requested_ms) > DSP_SYNC_RETRY_MS) {
+	dsp_resync();
+    }
 }
 
 
@@ -1401,6 +1515,8 @@ void handle_command(char cmd, char* args) {
 	break;
     case 's':
 	request_channel_status();
+	print_dsp_sync();
+	print_dsp_queue();
 	break;
     case 'X':
 	i = atoi(args);
@@ -1668,7 +1784,7 @@ void core1_init() {
 	// setup inter-system serial communication
 	gpio_set_function(TX_TO_DSP, UART_FUNCSEL_NUM(uart1, TX_TO_DSP));
 	gpio_set_function(RX_FROM_DSP, UART_FUNCSEL_NUM(uart1, RX_FROM_DSP));
-	uart_init(uart1,115200);
+	uart_dma_init(&dsp_link, uart1, PROTO_BAUD);
 	// wait for the LED testing
 	while(current_state->ready==false) {
 	    sleep_us(1000);
@@ -1696,12 +1812,12 @@ int setup() {
     
     // allocations for globals...
     text_buffer = (char *) calloc(1024,sizeof(char));
-    recv_buffer = (char *) calloc(ENTRY_SIZE,sizeof(char));    
+    proto_rx_init(&dsp_rx);
     led_levels = (float *) calloc(AMPLITUDE_PIXEL_COUNT*3, sizeof(float));
     comp_gain = (float *) calloc(AMPLITUDE_PIXEL_COUNT*3, sizeof(float));
     cmd_buffer = (char *) calloc(ENTRY_SIZE,sizeof(char));
 
-    dsp_queue = 0;
+    param_queue_init(&dsp_queue);
     
     build_initial_movement_table();
     //show_movement_list();
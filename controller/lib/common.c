@@ -24,6 +24,8 @@
 #include "pico/float.h"
 
 #include "common.h"
+#include "fastmath.h"
+#include "proto.h"
 
 machine *current_state;
 
@@ -48,13 +50,13 @@ char *str_alloc(int len) {
 // return the signal strength in negative gain from 0dB (pressure)
 
 float signal_dB(int32_t amp) {
-    return 0-(20*log10f(MAX_AMPLITUDE/amp));
+    return fm_amp_to_dB(amp);
 }
 
 // converts to a decibel relative to 1, where 1 is 0db
 
 float ratio_to_dB(float relative_amplitude) {
-    return (20*log10f(relative_amplitude));
+    return fm_ratio_to_dB(relative_amplitude);
 }
 
 // return the sample value for a provided dB in pressure
@@ -65,18 +67,14 @@ int32_t dB_to_sample(float dB) {
     if (dB < 0) {
 	abs_dB = abs_dB * -1;
     }
-    return (int32_t) (MAX_AMPLITUDE / powf(10.0, (float) (abs_dB / 20.0)));
+    return fm_dB_to_amp(0 - abs_dB);
 }
 
 
 
 float dB_to_ratio(float dB) {
 
-    if (dB >= 0) {
-	 return powf(10,(float) (dB / 20));
-    }
-    return -1.0 * ((float) 0.0 - ( powf(10.0, (float) (dB / 20.0))));
-    
+    return fm_dB_to_ratio(dB);
 }
 
 uint64_t now_ms() {
@@ -84,11 +82,7 @@ uint64_t now_ms() {
 }
 
 void request_channel_status() {
-    char buf[20];
-    if (uart_is_writable(uart1)) {
-	sprintf(buf,"s\n");
-	uart_puts(uart1,buf);
-    }
+    send_to_dsp(PROTO_SYNC_REQUEST,NULL);
 }
 
 const char *on_off(uint32_t value) {
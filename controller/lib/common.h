@@ -93,9 +93,9 @@ struct machine_state_structure {
     float attack_rate_ms; // how quickly in milliseconds to engage the compressin 
     float release_rate_ms; // how quickly to release the compression
     uint32_t min_steps;    // when attack is set to 0, the minimum number of cycles (steps) to take to reach the target gain (can't be 0 to avoid div/0)
-    float peak_amp_l;      // the last peak amplitude for display purposes (as a sample value)
+    float peak_amp_l;      // the held peak input level, as a ratio of full scale (see process_meter)
     float peak_amp_r;
-    float current_input_amp_l; // current input amplitude left as a 1-255 (reporting purposes only) (not in dB)
+    float current_input_amp_l; // current input level, as a ratio of full scale (not in dB)
     float current_input_amp_r; // right side 
     float output_amp_l;    // the computed output value at the cycle instance 1-255 (not in dB)
     float output_amp_r;    // right side
@@ -121,7 +121,11 @@ struct machine_state_structure {
     char *channel_name;    // the name of the channel
     uint8_t channel_number;  // the assigned number of the channel
     uint64_t slider_update_ms;
-    uint64_t last_external_update_ms; // the ms since boot when the structure was updated from a remote source, such as the DSP, or the system controller
+    uint32_t external_updates; // count of changes to the structure from a remote source, such as the DSP, or the system controller
+    int32_t input_dc_ppm;  // DSP input DC offset in parts per million of full scale
+    uint8_t input_coverage; // percent of DSP blocks the offset was measured on
+    bool input_stuck;      // the DSP input data is stuck (codec or DMA fault)
+    bool input_drift;      // the DSP input DC offset is over its limit
 };
 
 typedef struct machine_state_structure machine;
@@ -136,6 +140,10 @@ extern machine *current_state;
 
 char *str_alloc(int len);
 
+// queue a message (lib/proto.h) for the DSP, sent from core 0
+void send_to_dsp(uint8_t type, const void *payload);
+
+// ask the DSP for a snapshot of its settings
 void request_channel_status();
 
 void set_logging(bool on);
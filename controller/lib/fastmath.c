@@ -0,0 +1,111 @@
+/* Fast Math
+   Table driven log2/exp2 with linear interpolation.
+*/
+
+#include "fastmath.h"
+
+// log2(1 + i/64) as Q1.30
+
+static const int32_t log2_table[65] = {
+    0x00000000, 0x016e7968, 0x02d75a6f, 0x043ace28,
+    0x0598fdbf, 0x06f21090, 0x08462c46, 0x099574f1,
+    0x0ae00d1d, 0x0c2615e8, 0x0d67af17, 0x0ea4f726,
+    0x0fde0b5d, 0x111307db, 0x124407ab, 0x137124cf,
+    0x149a784c, 0x15c01a3a, 0x16e221ce, 0x1800a563,
+    0x191bba89, 0x1a33760a, 0x1b47ebf7, 0x1c592fad,
+    0x1d6753e0, 0x1e726aa2, 0x1f7a8569, 0x207fb517,
+    0x21820a02, 0x228193f5, 0x237e623d, 0x247883a8,
+    0x2570068e, 0x2664f8d5, 0x275767f5, 0x284760fd,
+    0x2934f098, 0x2a20230e, 0x2b09044d, 0x2bef9fe8,
+    0x2cd4011d, 0x2db632d5, 0x2e963fad, 0x2f7431f2,
+    0x305013ab, 0x3129ee96, 0x3201cc2c, 0x32d7b5a5,
+    0x33abb3fb, 0x347dcfe7, 0x354e11eb, 0x361c824d,
+    0x36e9291f, 0x37b40e3a, 0x387d3946, 0x3944b1b9,
+    0x3a0a7eda, 0x3acea7c0, 0x3b913356, 0x3c52285c,
+    0x3d118d67, 0x3dcf68e3, 0x3e8bc118, 0x3f469c23,
+    0x40000000
+};
+
+// 2^(i/64) as Q2.30
+
+static const uint32_t exp2_table[65] = {
+    0x40000000u, 0x40b268fau, 0x4166c34cu, 0x421d1462u,
+    0x42d561b4u, 0x438fb0cbu, 0x444c0740u, 0x450a6abbu,
+    0x45cae0f2u, 0x468d6faeu, 0x47521cc6u, 0x4818ee22u,
+    0x48e1e9bau, 0x49ad1598u, 0x4a7a77d4u, 0x4b4a169cu,
+    0x4c1bf829u, 0x4cf022cau, 0x4dc69cddu, 0x4e9f6cd4u,
+    0x4f7a9930u, 0x50582888u, 0x51382182u, 0x521a8ad7u,
+    0x52ff6b55u, 0x53e6c9dau, 0x54d0ad5au, 0x55bd1cdbu,
+    0x56ac1f75u, 0x579dbc57u, 0x5891fac1u, 0x5988e209u,
+    0x5a82799au, 0x5b7ec8f2u, 0x5c7dd7a4u, 0x5d7fad59u,
+    0x5e8451d0u, 0x5f8bccdbu, 0x60962665u, 0x61a3666du,
+    0x62b39509u, 0x63c6ba64u, 0x64dcdec3u, 0x65f60a7fu,
+    0x6712460bu, 0x683199edu, 0x69540ec9u, 0x6a79ad56u,
+    0x6ba27e65u, 0x6cce8ae1u, 0x6dfddbccu, 0x6f307a41u,
+    0x70666f76u, 0x719fc4b9u, 0x72dc8374u, 0x741cb528u,
+    0x75606374u, 0x76a7980fu, 0x77f25cceu, 0x7940bb9eu,
+    0x7a92be8bu, 0x7be86fbau, 0x7d41d96eu, 0x7e9f0606u,
+    0x80000000u
+};
+
+typedef union {
+    float f;
+    uint32_t u;
+} float_bits;
+
+/* x = 2^e * (1 + m), the top 6 bits of the 23 bit mantissa m index
+ * the table and the remaining 17 bits interpolate.  The result is
+ * built as Q8.24 and converted once.
+ */
+
+float fm_log2(float x) {
+    if (!(x > 0)) return FM_LOG2_FLOOR;       // and NaN
+    float_bits v = { .f = x };
+    if ((v.u >> 23) >= 0xff) return FM_LOG2_CEILING;  // +inf
+    int32_t e = (int32_t) (v.u >> 23) - 127;
+    uint32_t idx = (v.u >> 17) & 63;
+    uint32_t rem = v.u & 0x1ffff;
+    int32_t lo = log2_table[idx];
+    int32_t step = log2_table[idx + 1] - lo;
+    int32_t t = (lo >> 6) + ((((uint32_t) step >> 6) * (rem >> 5)) >> 12);
+    return (float) (e * (1 << 24) + t) * (1.0f / (1 << 24));
+}
+
+/* x is taken as Q8.24: the integer part becomes the float exponent,
+ * the top 6 bits of the fraction index the table and the remaining 18
+ * bits interpolate.  The table value is the mantissa.
+ */
+
+float fm_exp2(float x) {
+    if (!(x >= -126.0f)) return 0;            // and NaN
+    if (x > 127.0f) x = 127.0f;
+    int32_t q = (int32_t) (x * (float) (1 << 24));
+    int32_t n = q >> 24;
+    uint32_t f = q & 0xffffff;
+    uint32_t idx = f >> 18;
+    uint32_t rem = f & 0x3ffff;
+    uint32_t lo = exp2_table[idx];
+    uint32_t step = exp2_table[idx + 1] - lo;
+    uint32_t t = lo + ((((step >> 6) * (rem >> 6))) >> 6);
+    float_bits v = { .u = ((uint32_t) (n + 127) << 23) | ((t - (1u << 30)) >> 7) };
+    return v.f;
+}
+
+float fm_ratio_to_dB(float ratio) {
+    return FM_DB_PER_LOG2 * fm_log2(ratio);
+}
+
+float fm_dB_to_ratio(float dB) {
+    return fm_exp2(dB * FM_LOG2_PER_DB);
+}
+
+float fm_amp_to_dB(int32_t amp) {
+    if (amp <= 0) return FM_DB_FLOOR;
+    return FM_DB_PER_LOG2 * (fm_log2((float) amp) - 31.0f);
+}
+
+int32_t fm_dB_to_amp(float dB) {
+    float ratio = fm_dB_to_ratio(dB);
+    if (ratio >= 1.0f) return INT32_MAX;
+    return (int32_t) (ratio * 2147483648.0f);
+}
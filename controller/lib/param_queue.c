@@ -0,0 +1,81 @@
+/* Param Queue
+   Coalescing outbound queue for the DSP settings.
+*/
+
+#include <string.h>
+#include "param_queue.h"
+#include "proto.h"
+
+static bool is_urgent(char param) {
+    return param != 0 && strchr(PARAM_QUEUE_URGENT, param) != NULL;
+}
+
+void param_queue_init(param_queue *q) {
+    critical_section_init(&q->lock);
+    q->count = 0;
+    q->urgent = 0;
+    q->requests = 0;
+    q->queued = 0;
+    q->coalesced = 0;
+    q->sent = 0;
+    q->dropped = 0;
+}
+
+bool param_queue_set(param_queue *q, char param, float value) {
+    bool ok = true;
+
+    critical_section_enter_blocking(&q->lock);
+    q->queued++;
+    uint8_t i = 0;
+    while (i < q->count && q->entries[i].param != param) i++;
+    if (i < q->count) {
+	q->entries[i].value = value;
+	q->coalesced++;
+    } else if (q->count < PARAM_QUEUE_SIZE) {
+	q->entries[q->count].param = param;
+	q->entries[q->count].value = value;
+	q->count++;
+	if (is_urgent(param)) q->urgent++;
+    } else {
+	q->dropped++;
+	ok = false;
+    }
+    critical_section_exit(&q->lock);
+    return ok;
+}
+
+void param_queue_request(param_queue *q, uint8_t type) {
+    critical_section_enter_blocking(&q->lock);
+    q->queued++;
+    if (q->requests & (1u << type)) {
+	q->coalesced++;
+    }
+    q->requests |= 1u << type;
+    critical_section_exit(&q->lock);
+}
+
+bool param_queue_take(param_queue *q, uint8_t *type, char *param, float *value) {
+    bool got = true;
+
+    critical_section_enter_blocking(&q->lock);
+    if (q->count > 0) {
+	uint8_t i = 0;
+	if (q->urgent > 0) {
+	    while (!is_urgent(q->entries[i].param)) i++;
+	    q->urgent--;
+	}
+	*type = PROTO_SET;
+	*param = q->entries[i].param;
+	*value = q->entries[i].value;
+	q->count--;
+	memmove(&q->entries[i], &q->entries[i+1], (q->count - i) * sizeof(param_entry));
+    } else if (q->requests != 0) {
+	*type = __builtin_ctz(q->requests);
+	q->requests &= ~(1u << *type);
+    } else {
+	got = false;
+    }
+    if (got) q->sent++;
+    critical_section_exit(&q->lock);
+    return got;
+}
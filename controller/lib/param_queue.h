@@ -0,0 +1,67 @@
+/* Param Queue
+   The messages waiting to go to the DSP, in a fixed table: nothing is
+   allocated to queue or send one.
+
+   A setting (PROTO_SET) has one entry per parameter, keyed by its
+   console command letter.  Setting it again before it has gone out
+   replaces the value (the last writer wins) and is counted as
+   coalesced, so a slider sweep sends only the latest position each
+   time the queue is drained.  A message with no payload (a sync
+   request) is a bit for its type, so it coalesces as well.
+
+   The urgent settings (PARAM_QUEUE_URGENT: mute and the compressor and
+   gate on/off) are taken before everything else; the other settings
+   in the order they were first queued; requests last, so a snapshot
+   asked for after a setting includes it.
+
+   Either core may queue, one takes.  The table is guarded by a
+   critical section, held for a short scan of the entries.
+*/
+
+#ifndef __PARAM_QUEUE__
+#define __PARAM_QUEUE__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/sync.h"
+
+#define PARAM_QUEUE_SIZE 32       // parameters waiting at once
+#define PARAM_QUEUE_URGENT "McG"
+
+typedef struct param_entry {
+    char param;
+    float value;
+} param_entry;
+
+typedef struct param_queue {
+    critical_section_t lock;
+    param_entry entries[PARAM_QUEUE_SIZE];  // in the order first queued
+    uint8_t count;
+    uint8_t urgent;             // urgent entries waiting
+    uint32_t requests;          // a bit per message type
+
+    uint32_t queued;            // counters, for the console
+    uint32_t coalesced;
+    uint32_t sent;
+    uint32_t dropped;           // the table was full
+} param_queue;
+
+void param_queue_init(param_queue *q);
+
+// queue a setting, replacing the value of one waiting for the same
+// parameter.  False if the table is full.
+bool param_queue_set(param_queue *q, char param, float value);
+
+// queue a message type that has no payload
+void param_queue_request(param_queue *q, uint8_t type);
+
+// true if an urgent setting is waiting
+static inline bool param_queue_urgent(param_queue *q) {
+    return q->urgent > 0;
+}
+
+// take the next message: its type, and for PROTO_SET the parameter
+// and value.  False if nothing is waiting.
+bool param_queue_take(param_queue *q, uint8_t *type, char *param, float *value);
+
+#endif
@@ -0,0 +1,180 @@
+/* Proto
+   The binary protocol between the DSP and the controller on uart1.
+   The same files are built on both boards.
+
+   Each message is a type byte and a packed struct of fixed size for
+   that type, followed by a CRC-16 (CCITT, 0x1021, initial 0xFFFF, low
+   byte first) over the type and the payload.  The whole is COBS
+   encoded, so it holds no zero bytes, and ended with a zero: a
+   receiver that joins in mid stream, or loses a byte, is back in step
+   at the next zero.  A frame whose CRC, length or type is wrong is
+   dropped and counted.
+
+   Both boards are little endian, so the structs go out as they are
+   laid out in memory.  Meter levels are log codes and the settings
+   are the floats the boards hold, so neither side formats or parses
+   text.
+
+   Meters: the DSP takes the peaks since the last report every 5ms
+   (200Hz) and sends the input's PROTO_METER_REPORTS at a time, every
+   50ms, with the output peak and the most gain reduction over those.
+   Each level is one byte in 0.5dB steps: 255 is full scale, each step
+   down is 0.5dB less, to 1 at -127dBFS, and 0 is silence.  Gain
+   reduction is the same steps counted up from 0 (no reduction).  The
+   controller does the meter ballistics (fall back, peak hold) itself.
+
+   Parameters are set with PROTO_SET, one at a time.  The parameter is
+   the DSP console letter for the setting (t for the threshold, and so
+   on, see ? on the DSP console) and the value the number the console
+   command would take.  The DSP answers each with a PROTO_ACK carrying
+   the same sequence number.
+
+   Parameter sync: the DSP numbers every change it publishes from one
+   version counter, and keeps the version each parameter was last
+   published at.  An accepted PROTO_SET is published by its ack, which
+   carries the version and the value as applied (clamped); a change
+   from the DSP console is published as a PROTO_PARAM.  Each version
+   is one more than the last, so the controller can tell a lost update
+   from the gap, and the meter report carries the current version
+   so a lost last update shows too.  On a gap, a silent link or at
+   start up the controller sends PROTO_SYNC_REQUEST; the DSP answers
+   with a snapshot, every parameter as a PROTO_PARAM flagged
+   PROTO_SNAPSHOT at its own version, closed by a PROTO_SYNC with the
+   current version and the count sent.
+*/
+
+#ifndef __PROTO__
+#define __PROTO__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+enum proto_types {
+    PROTO_METER = 1,          // DSP: levels, every 50ms
+    PROTO_PARAM,              // DSP: one parameter changed, or in a snapshot
+    PROTO_SYNC,               // DSP: end of a snapshot
+    PROTO_DIAGNOSTICS,        // DSP: input monitor report, every 500ms
+    PROTO_ACK,                // DSP: answer to a PROTO_SET
+    PROTO_SET,                // controller: set one parameter
+    PROTO_SYNC_REQUEST,       // controller: ask for a snapshot
+    PROTO_TYPES
+};
+
+#define PROTO_BAUD 1000000        // the uart1 link, both boards
+
+#define PROTO_METER_PERIOD_US 5000  // a meter report, 200Hz
+#define PROTO_METER_REPORTS 10    // reports to a meter frame
+#define PROTO_METER_STEP_DB 0.5f
+
+// meter flags
+#define PROTO_MUTED 0x01
+#define PROTO_GATE_OPEN 0x02
+
+// parameter flags
+#define PROTO_SNAPSHOT 0x01
+
+// diagnostics flags
+#define PROTO_INPUT_STUCK 0x01
+#define PROTO_INPUT_DRIFT 0x02
+
+typedef struct __attribute__((packed)) proto_meter {
+    uint8_t input_l[PROTO_METER_REPORTS];   // peak since the report before, oldest first
+    uint8_t input_r[PROTO_METER_REPORTS];
+    uint8_t output_l;         // output peak over the frame
+    uint8_t output_r;
+    uint8_t reduction;        // most gain reduction over the frame
+    uint8_t flags;
+    uint16_t version;         // parameter version, last published
+} proto_meter;
+
+typedef struct __attribute__((packed)) proto_param {
+    uint8_t param;            // console command letter
+    uint8_t flags;
+    uint16_t version;
+    float value;
+} proto_param;
+
+typedef struct __attribute__((packed)) proto_sync {
+    uint16_t version;         // current version
+    uint8_t count;            // parameters in the snapshot
+} proto_sync;
+
+typedef struct __attribute__((packed)) proto_diagnostics {
+    uint8_t mode;             // input monitor mode, sum or CRC
+    int32_t dc_ppm;           // input DC offset, parts per million of full scale
+    uint8_t coverage;         // percent of blocks it was measured on
+    uint8_t flags;
+} proto_diagnostics;
+
+typedef struct __attribute__((packed)) proto_set {
+    uint8_t param;            // console command letter
+    uint8_t seq;
+    float value;
+} proto_set;
+
+typedef struct __attribute__((packed)) proto_ack {
+    uint8_t param;
+    uint8_t seq;
+    uint8_t ok;               // 0 if the parameter is unknown
+    uint16_t version;         // the version it was published at, if ok
+    float value;              // and the value applied
+} proto_ack;
+
+#define PROTO_MAX_PAYLOAD 40
+#define PROTO_MAX_MESSAGE (1 + PROTO_MAX_PAYLOAD + 2)                 // type, payload, CRC
+#define PROTO_MAX_FRAME (PROTO_MAX_MESSAGE + (PROTO_MAX_MESSAGE / 254) + 2)  // COBS, delimiter
+
+typedef struct proto_message {
+    uint8_t type;
+    union {
+	proto_meter meter;
+	proto_param param;
+	proto_sync sync;
+	proto_diagnostics diagnostics;
+	proto_set set;
+	proto_ack ack;
+	uint8_t bytes[PROTO_MAX_PAYLOAD];
+    } u;
+} proto_message;
+
+// stream decoder state, one per receiving uart
+
+typedef struct proto_rx {
+    uint8_t buf[PROTO_MAX_FRAME];
+    uint16_t len;
+    bool overflow;            // dropping bytes until the next delimiter
+    proto_message msg;        // the last message decoded
+    uint32_t frames;          // good frames
+    uint32_t errors;          // frames dropped
+} proto_rx;
+
+uint16_t proto_crc16(const uint8_t *data, size_t len);
+
+// payload size of a message type, 0 if the type is unknown
+size_t proto_payload_size(uint8_t type);
+
+// encode a message of the given type into frame (PROTO_MAX_FRAME
+// bytes), with its delimiter.  Returns the frame length, 0 if the type
+// is unknown.
+size_t proto_encode(uint8_t type, const void *payload, uint8_t *frame);
+
+// a level, as a ratio to full scale, to its meter code and back
+uint8_t proto_level_code(float ratio);
+float proto_level_ratio(uint8_t code);
+
+// a gain (1 is none) to its reduction code and back
+uint8_t proto_reduction_code(float gain);
+float proto_reduction_gain(uint8_t code);
+
+void proto_rx_init(proto_rx *rx);
+
+// feed one received byte, true when it completes a good message,
+// which is then in rx->msg
+bool proto_rx_byte(proto_rx *rx, uint8_t byte);
+
+// the line went idle: a frame still half received has lost its end
+// and is dropped
+void proto_rx_idle(proto_rx *rx);
+
+#endif
@@ -0,0 +1,118 @@
+/* UART DMA
+   Receive and transmit rings for a uart, filled and emptied by DMA.
+*/
+
+#include "uart_dma.h"
+#include "hardware/dma.h"
+#include "pico/time.h"
+
+#define RX_COUNT 0xffffffffu      // the receive channel's run, restarted when it ends
+#define RX_MASK (UART_DMA_RX_SIZE - 1)
+#define TX_MASK (UART_DMA_TX_SIZE - 1)
+
+void uart_dma_init(uart_dma *t, uart_inst_t *uart, uint baud) {
+    t->uart = 0;
+    t->baud = uart_init(uart, baud);  // also enables the uart's DREQs
+    t->rx_base = 0;
+    t->rx_read = 0;
+    t->rx_seen = 0;
+    t->rx_last_us = time_us_64();
+    t->idle = false;
+    t->tx_head = 0;
+    t->tx_tail = 0;
+    t->tx_sending = 0;
+    t->rx_bytes = 0;
+    t->rx_lost = 0;
+    t->tx_bytes = 0;
+    t->tx_dropped = 0;
+
+    t->rx_chan = dma_claim_unused_channel(true);
+    t->tx_chan = dma_claim_unused_channel(true);
+
+    dma_channel_config c = dma_channel_get_default_config(t->rx_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, UART_DMA_RX_BITS);
+    channel_config_set_dreq(&c, uart_get_dreq(uart, false));
+    dma_channel_configure(t->rx_chan, &c, t->rx_ring, &uart_get_hw(uart)->dr, RX_COUNT, true);
+
+    c = dma_channel_get_default_config(t->tx_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_ring(&c, false, UART_DMA_TX_BITS);
+    channel_config_set_dreq(&c, uart_get_dreq(uart, true));
+    dma_channel_configure(t->tx_chan, &c, &uart_get_hw(uart)->dr, t->tx_ring, 0, false);
+
+    __compiler_memory_barrier();
+    t->uart = uart;           // ready; until now the poll does nothing
+}
+
+// bytes the receive channel has written since it was first started
+
+static uint32_t rx_received(uart_dma *t) {
+    return t->rx_base + (RX_COUNT - dma_channel_hw_addr(t->rx_chan)->transfer_count);
+}
+
+// hand everything queued to the transmit channel, if it's free
+
+static void tx_start(uart_dma *t) {
+    if (dma_channel_is_busy(t->tx_chan)) return;
+    t->tx_tail += t->tx_sending;
+    t->tx_sending = t->tx_head - t->tx_tail;
+    if (t->tx_sending > 0) {
+	t->tx_bytes += t->tx_sending;
+	__compiler_memory_barrier();
+	dma_channel_set_read_addr(t->tx_chan, &t->tx_ring[t->tx_tail & TX_MASK], false);
+	dma_channel_set_trans_count(t->tx_chan, t->tx_sending, true);
+    }
+}
+
+void uart_dma_poll(uart_dma *t) {
+    if (t->uart == 0) return;
+
+    if (!dma_channel_is_busy(t->rx_chan)) {
+	// ran out its count, carry on from the same place in the ring
+	t->rx_base += RX_COUNT;
+	dma_channel_set_trans_count(t->rx_chan, RX_COUNT, true);
+    }
+    uint32_t received = rx_received(t);
+    uint64_t now = time_us_64();
+    if (received != t->rx_seen) {
+	t->rx_bytes += received - t->rx_seen;
+	t->rx_seen = received;
+	t->rx_last_us = now;
+	t->idle = false;
+    } else if (now - t->rx_last_us >= UART_DMA_IDLE_US) {
+	t->idle = true;
+    }
+
+    tx_start(t);
+}
+
+bool uart_dma_send(uart_dma *t, const uint8_t *data, size_t len) {
+    if (t->uart == 0 || len > UART_DMA_TX_SIZE - (t->tx_head - t->tx_tail)) {
+	t->tx_dropped++;
+	return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+	t->tx_ring[(t->tx_head + i) & TX_MASK] = data[i];
+    }
+    t->tx_head += len;
+    tx_start(t);
+    return true;
+}
+
+int uart_dma_getc(uart_dma *t) {
+    if (t->uart == 0) return -1;
+
+    uint32_t waiting = rx_received(t) - t->rx_read;
+    if (waiting == 0) return -1;
+    if (waiting > UART_DMA_RX_SIZE) {
+	// written over before we got to it
+	t->rx_lost += waiting - UART_DMA_RX_SIZE;
+	t->rx_read += waiting - UART_DMA_RX_SIZE;
+    }
+    return t->rx_ring[t->rx_read++ & RX_MASK];
+}
@@ -23,6 +23,7 @@ PAGE_STATE p_state = REFRESH_ALL;
 uint16_t button_offset = 0;
 
 uint64_t last_update_time = 0;
+uint32_t seen_updates = 0;    // external_updates as of the last full refresh
 uint64_t last_press_time = 0;
 bool in_display_update = false;
 
@@ -34,9 +35,10 @@ uint16_t buttons_to_pages[11];
 
 
 bool check_if_need_full_refresh() {
-    if (current_state->last_external_update_ms+10 > last_update_time) {
+    if (current_state->external_updates != seen_updates) {
 	//printf("%s: p_state is now REFRESH_ALL.\n",__FUNCTION__);
 	p_state = REFRESH_ALL;
+	seen_updates = current_state->external_updates;
 	last_update_time=now_ms();
 	return true;
     }